@@ -0,0 +1,75 @@
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <optional>
+#include "bench_utils.hpp"
+#include "parser.hpp"
+#include "utils.h"
+
+// Heap allocations made while parsing a large generated program into the C AST, and frees made
+// tearing it down again. Every global operator new and delete is counted.
+// Usage: ast_alloc_bench [functions]   8000 functions by default, about 1KB of source each
+
+static size_t gAllocations = 0;
+static size_t gAllocatedBytes = 0;
+static size_t gFrees = 0;
+
+static void* countedAllocation(size_t size, size_t alignment) {
+    ++gAllocations;
+    gAllocatedBytes += size;
+    void* memory = alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__
+        ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+        : std::malloc(size ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+static void countedFree(void* memory) {
+    if (!memory)
+        return;
+    ++gFrees;
+    std::free(memory);
+}
+
+void* operator new(size_t size) { return countedAllocation(size, 0); }
+void* operator new[](size_t size) { return countedAllocation(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) { return countedAllocation(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return countedAllocation(size, static_cast<size_t>(alignment)); }
+void operator delete(void* memory) noexcept { countedFree(memory); }
+void operator delete[](void* memory) noexcept { countedFree(memory); }
+void operator delete(void* memory, size_t) noexcept { countedFree(memory); }
+void operator delete[](void* memory, size_t) noexcept { countedFree(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { countedFree(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { countedFree(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { countedFree(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { countedFree(memory); }
+
+int main(int argc, char* argv[]) {
+    size_t functions = argc > 1 ? std::stoul(argv[1]) : 8000;
+    Utils::SourceBuffer source(bench::generate_program(functions));
+    compiler::ast::InternerScope interner;
+
+    size_t allocations = 0, bytes = 0, frees = 0;
+    double parseSeconds = 0, teardownSeconds = 0;
+    {
+        compiler::lexer::TokenStream tokens(source);
+        std::optional<compiler::ast::c::Program> program;
+
+        gAllocations = gAllocatedBytes = 0;
+        parseSeconds = bench::best_of(1, [&] { program.emplace(compiler::parser::parseProgram(tokens)); });
+        allocations = gAllocations;
+        bytes = gAllocatedBytes;
+
+        gFrees = 0;
+        teardownSeconds = bench::best_of(1, [&] { program.reset(); });
+        frees = gFrees;
+    }
+
+    std::cout << std::format("{:.1f} MB of source, {} functions\n",
+                             static_cast<double>(source.view().size()) / (1024 * 1024), functions);
+    std::cout << std::format("parse:    {:10} allocations, {:8.1f} MB, {:.3f}s\n",
+                             allocations, static_cast<double>(bytes) / (1024 * 1024), parseSeconds);
+    std::cout << std::format("teardown: {:10} frees, {:.3f}s\n", frees, teardownSeconds);
+    return 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <string>
+
+// Shared by the benchmark targets, which are only built on request (see CMakeLists.txt).
+
+namespace bench {
+
+/// @brief Seconds taken by the fastest of repeats runs of f
+template<typename F>
+double best_of(int repeats, F&& f) {
+    double best = 1e300;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+/// @brief A valid program of functions full of expressions, branches and loops, roughly 1KB per function
+inline std::string generate_program(size_t functions) {
+    std::string source;
+    for (size_t f = 0; f < functions; ++f) {
+        source += std::format(
+            "int function_{}(int first, int second) {{\n"
+            "    int accumulator = first * {} + second;\n"
+            "    for (int index = 0; index < {}; index = index + 1) {{\n"
+            "        if (accumulator > 1000000 && index != second) {{\n"
+            "            accumulator = accumulator / 7 - (index << 2);\n"
+            "        }} else {{\n"
+            "            accumulator = accumulator + (first ^ index) % 13;\n"
+            "        }}\n"
+            "        while (accumulator >= 4096 || accumulator <= -4096) accumulator = accumulator >> 1;\n"
+            "    }}\n"
+            "    switch (accumulator & 3) {{\n"
+            "        case 0: return accumulator + {};\n"
+            "        case 1: return ~accumulator;\n"
+            "        default: break;\n"
+            "    }}\n"
+            "    return accumulator ? -accumulator : !second;\n"
+            "}}\n\n",
+            f, f % 97 + 3, f % 31 + 1, f);
+    }
+    source += "int main(void) {\n    return function_0(1, 2) & 0;\n}\n";
+    return source;
+}
+
+/// @brief main with blocks nested depth deep, each declaring width variables that read ones from
+/// the enclosing block. Every other block shadows the outer declarations instead of adding new names.
+inline std::string generate_nested_scopes(size_t depth, size_t width) {
+    std::string source = "int main(void) {\n";
+    for (size_t w = 0; w < width; ++w)
+        source += std::format("int v{} = {};\n", w, w);
+    for (size_t d = 1; d <= depth; ++d) {
+        source += "{\n";
+        for (size_t w = 0; w < width; ++w) {
+            if (d % 2)
+                source += std::format("int v{} = v{} + 1;\n", w, (w + 1) % width);
+            else
+                source += std::format("int s{}_{} = v{};\n", d, w, w);
+        }
+    }
+    source.append(depth, '}');
+    source += "\nreturn v0;\n}\n";
+    return source;
+}
+
+/// @brief main declaring locals variables, then statements of the form `a = b + c` over them. Without
+/// register allocation every operand is a stack slot, so each statement needs fixing up.
+inline std::string generate_straight_line(size_t statements, size_t locals = 400) {
+    std::string source = "int main(void) {\n";
+    for (size_t l = 0; l < locals; ++l)
+        source += std::format("int v{} = {};\n", l, l);
+    for (size_t s = 0; s < statements; ++s)
+        source += std::format("v{} = v{} + v{};\n", s % locals, (s * 7 + 1) % locals, (s * 13 + 2) % locals);
+    source += "return v0 & 0;\n}\n";
+    return source;
+}
+
+}
@@ -0,0 +1,49 @@
+#include <iostream>
+#include "bench_utils.hpp"
+#include "parser.hpp"
+#include "utils.h"
+#include "visitors/c_visitors/semantic_analysis.hpp"
+#include "visitors/c_to_tacky.hpp"
+#include "visitors/tacky_to_asmb.hpp"
+#include "visitors/asmb_visitors/asmb_to_file.hpp"
+
+// FixUpAsmbInstructions on ever larger functions without register allocation, where inserting the
+// fix-up movs into the middle of the instruction vector used to make it quadratic. Linear scaling
+// shows up as a flat time per instruction.
+// Usage: fixup_bench [statements...]   10000, 20000, 40000 and 80000 statements by default
+
+static void run(size_t statements) {
+    Utils::SourceBuffer source(bench::generate_straight_line(statements));
+    compiler::ast::InternerScope interner;
+
+    // The driver's pipeline up to the fix-up pass, as with --regalloc=none
+    compiler::lexer::TokenStream tokens(source);
+    compiler::ast::c::Program program = compiler::parser::parseProgram(tokens);
+    compiler::ast::SymbolMapType symbolMap;
+    compiler::ast::NameGenerator names;
+    (compiler::ast::c::IdentifierResolution(names))(program);
+    (compiler::ast::c::TypeChecking(symbolMap))(program);
+    (compiler::ast::c::ControlFlowLabelling(names))(program);
+    (compiler::ast::c::LabelResolution(names))(program);
+    auto tackyProgram = compiler::codegen::CToTacky(names)(program);
+    compiler::ast::asmb::Program asmb = compiler::codegen::TackyToAsmb()(tackyProgram);
+    compiler::codegen::ReplacePseudoRegisters()(asmb, symbolMap);
+
+    size_t before = asmb.mFunctions.front().mInstructions.size();
+    double seconds = bench::best_of(1, [&] { compiler::codegen::FixUpAsmbInstructions()(asmb, symbolMap); });
+    size_t after = asmb.mFunctions.front().mInstructions.size();
+
+    std::cout << std::format("{:7} statements: {:8} instructions, {:8} after fixing, {:.3f}s, {:.1f} ns per instruction\n",
+                             statements, before, after, seconds, seconds * 1e9 / static_cast<double>(before));
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i)
+            run(std::stoul(argv[i]));
+        return 0;
+    }
+    for (size_t statements : {10000, 20000, 40000, 80000})
+        run(statements);
+    return 0;
+}
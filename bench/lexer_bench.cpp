@@ -0,0 +1,102 @@
+#include <ctre.hpp>
+#include <cctype>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "bench_utils.hpp"
+#include "lexer.hpp"
+#include "utils.h"
+
+// Lexer throughput in MB/s, the table-driven scanner against the regex lexer it replaced.
+// Usage: lexer_bench [preprocessed.i]   lexes a generated multi-megabyte program when no file is given
+
+namespace legacy {
+
+using compiler::lexer::LexType;
+
+// ------------------------------> checkForKeyword <------------------------------
+
+static LexType checkForKeyword(std::string_view sv) {
+    for (const auto& [str, lexType] : compiler::lexer::KEYWORD_MAP) {
+        if (sv == str)
+            return lexType;
+    }
+    return LexType::Identifier;
+}
+
+// ------------------------------> checkForType <------------------------------
+
+static std::pair<LexType, std::string_view> checkForType(std::string_view sv) {
+    static constexpr auto pattern = ctll::fixed_string{ R"((?<Identifier>[a-zA-Z_]\w*\b)|(?<Constant>[0-9]+\b))" };
+    auto m = ctre::starts_with<pattern>(sv);
+    if (m) {
+        if (m.get<"Identifier">())
+            return std::make_pair(LexType::Identifier, m);
+        return std::make_pair(LexType::Constant, m);
+    }
+    for (const auto& string_symbol : compiler::lexer::SORTED_SYMBOL_MAPPING) {
+        if (sv.starts_with(string_symbol.first))
+            return std::make_pair(string_symbol.second, string_symbol.first);
+    }
+    return std::make_pair(LexType::Undefined, std::string_view());
+}
+
+// ------------------------------> lexer <------------------------------
+
+/// The regex lexer as it was before the table-driven scanner, appending to a plain token vector
+static std::vector<std::pair<LexType, std::string_view>> lexer(std::string_view input) {
+    std::vector<std::pair<LexType, std::string_view>> tokens;
+    size_t pos = 0;
+    size_t len = input.size();
+    while (pos < len) {
+        if (std::isspace(input[pos])) {
+            ++pos;
+            continue;
+        }
+        auto [lexType, token_sv] = checkForType(input.substr(pos, len - pos));
+        if (lexType == LexType::Undefined)
+            throw std::runtime_error("Could not parse token at position " + std::to_string(pos));
+        if (lexType == LexType::Identifier)
+            lexType = checkForKeyword(token_sv);
+        tokens.emplace_back(lexType, token_sv);
+        pos += token_sv.size();
+    }
+    return tokens;
+}
+
+}
+
+int main(int argc, char* argv[]) try {
+    std::optional<Utils::SourceBuffer> source;
+    if (argc > 1)
+        source.emplace(fs::path(argv[1]));
+    else
+        source.emplace(bench::generate_program(8000));
+    double megabytes = static_cast<double>(source->view().size()) / (1024 * 1024);
+
+    size_t tokens = 0;
+    double scanner = bench::best_of(5, [&] { tokens = compiler::lexer::lexer(*source).size(); });
+    double stream = bench::best_of(5, [&] {
+        compiler::lexer::TokenStream stream(*source);
+        while (stream.hasCurrent())
+            stream.consume();
+    });
+    size_t legacyTokens = 0;
+    double regex = bench::best_of(3, [&] { legacyTokens = legacy::lexer(source->view()).size(); });
+
+    if (tokens != legacyTokens) {
+        std::cerr << std::format("Token counts differ: {} against {} from the regex lexer\n", tokens, legacyTokens);
+        return 1;
+    }
+
+    std::cout << std::format("{:.1f} MB, {} tokens\n", megabytes, tokens);
+    std::cout << std::format("regex lexer:          {:8.1f} MB/s\n", megabytes / regex);
+    std::cout << std::format("table-driven lexer:   {:8.1f} MB/s ({:.1f}x)\n", megabytes / scanner, regex / scanner);
+    std::cout << std::format("TokenStream drained:  {:8.1f} MB/s ({:.1f}x)\n", megabytes / stream, regex / stream);
+    return 0;
+} catch (const std::exception& e) {
+    std::cerr << "Lexing failed: " << e.what() << std::endl;
+    return 1;
+}
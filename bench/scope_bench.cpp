@@ -0,0 +1,38 @@
+#include <iostream>
+#include <optional>
+#include "bench_utils.hpp"
+#include "parser.hpp"
+#include "utils.h"
+#include "visitors/c_visitors/semantic_analysis.hpp"
+
+// Identifier resolution over deeply nested and wide scopes, where copying the visible names into
+// every new scope used to be quadratic.
+// Usage: scope_bench [depth width]   10000 levels of 4 declarations and 300 levels of 3000 by default
+
+static void run(size_t depth, size_t width) {
+    Utils::SourceBuffer source(bench::generate_nested_scopes(depth, width));
+    compiler::ast::InternerScope interner;
+
+    compiler::lexer::TokenStream tokens(source);
+    std::optional<compiler::ast::c::Program> program;
+    double parseSeconds = bench::best_of(1, [&] { program.emplace(compiler::parser::parseProgram(tokens)); });
+
+    compiler::ast::NameGenerator names;
+    double resolveSeconds = bench::best_of(1, [&] { (compiler::ast::c::IdentifierResolution(names))(*program); });
+
+    std::cout << std::format("depth {:6} width {:5}: parse {:.3f}s, identifier resolution {:.3f}s\n",
+                             depth, width, parseSeconds, resolveSeconds);
+}
+
+int main(int argc, char* argv[]) {
+    // Every nesting level is a few recursive calls in the parser and the resolver
+    return Utils::runWithStack(256 * 1024 * 1024, [&] {
+        if (argc > 2) {
+            run(std::stoul(argv[1]), std::stoul(argv[2]));
+            return 0;
+        }
+        run(10000, 4);
+        run(300, 3000);
+        return 0;
+    });
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <algorithm>
+
+namespace compiler::ast {
+
+// ------------------------------> Arena <------------------------------
+
+/// Bump-pointer allocator for AST nodes. Nodes are never freed one by one, every block is
+/// released together when the arena is destroyed.
+class Arena {
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Destructor {
+        void* mObject;
+        void (*mDestroy)(void*);
+    };
+
+    std::vector<std::unique_ptr<std::byte[]>> mBlocks;
+    std::byte* mCursor = nullptr;
+    std::byte* mEnd = nullptr;
+
+    // Only objects which aren't trivially destructible are recorded, trivially destructible
+    // nodes cost nothing to release.
+    std::vector<Destructor> mDestructors;
+
+    static uintptr_t alignUp(uintptr_t address, size_t alignment) {
+        return (address + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+    }
+
+    void* allocate(size_t size, size_t alignment) {
+        uintptr_t aligned = alignUp(reinterpret_cast<uintptr_t>(mCursor), alignment);
+        if (!mCursor || aligned + size > reinterpret_cast<uintptr_t>(mEnd)) {
+            size_t blockSize = std::max(BLOCK_SIZE, size + alignment);
+            mBlocks.emplace_back(std::make_unique_for_overwrite<std::byte[]>(blockSize));
+            mCursor = mBlocks.back().get();
+            mEnd = mCursor + blockSize;
+            aligned = alignUp(reinterpret_cast<uintptr_t>(mCursor), alignment);
+        }
+        mCursor = reinterpret_cast<std::byte*>(aligned + size);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() {
+        for (auto it = mDestructors.rbegin(); it != mDestructors.rend(); ++it)
+            it->mDestroy(it->mObject);
+    }
+
+    /// @brief Construct a T inside the arena, it lives as long as the arena does
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>)
+            mDestructors.push_back(Destructor{object, [](void* p) { static_cast<T*>(p)->~T(); }});
+        return object;
+    }
+
+    /// @brief Copy a list of trivially copyable values into the arena
+    template<typename T>
+    requires std::is_trivially_copyable_v<T>
+    std::span<T> makeArray(const std::vector<T>& values) {
+        if (values.empty())
+            return std::span<T>();
+        T* array = static_cast<T*>(allocate(sizeof(T) * values.size(), alignof(T)));
+        std::uninitialized_copy(values.begin(), values.end(), array);
+        return std::span<T>(array, values.size());
+    }
+};
+
+}
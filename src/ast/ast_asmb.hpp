@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <cstdint>
 #include <string>
 #include <iostream>
@@ -6,6 +7,7 @@
 #include <vector>
 #include <optional>
 #include <variant>
+#include "interner.hpp"
 
 namespace compiler::ast::asmb {
 
@@ -13,13 +15,17 @@ namespace compiler::ast::asmb {
 
 enum class UnaryOperator {
     Complement,
-    Negate
+    Negate,
+    Increment,
+    Decrement
 };
 
 constexpr std::string_view unary_op_to_string(UnaryOperator op) {
     switch (op) {
         case UnaryOperator::Complement: return "Complement";
         case UnaryOperator::Negate:     return "Negate";
+        case UnaryOperator::Increment:  return "Increment";
+        case UnaryOperator::Decrement:  return "Decrement";
     }
     throw std::invalid_argument("Unhandled UnaryOperator in ast::asmb::unary_op_to_string");
 }
@@ -28,6 +34,8 @@ constexpr std::string_view unary_op_to_instruction(UnaryOperator op) {
     switch (op) {
         case UnaryOperator::Complement: return "notl";
         case UnaryOperator::Negate:     return "negl";
+        case UnaryOperator::Increment:  return "incl";
+        case UnaryOperator::Decrement:  return "decl";
     }
     throw std::invalid_argument("Unhandled UnaryOperator in ast::asmb::unary_op_to_instruction");
 }
@@ -84,7 +92,13 @@ enum class RegisterName {
     R8,
     R9,
     R10,
-    R11
+    R11,
+    // Callee-saved, a function using them saves and restores them itself
+    BX,
+    R12,
+    R13,
+    R14,
+    R15
 };
 
 enum class RegisterSize {
@@ -158,6 +172,41 @@ constexpr std::string_view reg_name_to_string(RegisterName op, RegisterSize size
                 case RegisterSize::BYTE: return "\%r11b";
             }
             break;
+        case RegisterName::BX:
+            switch (size) {
+                case RegisterSize::QWORD: return "\%rbx";
+                case RegisterSize::DWORD: return "\%ebx";
+                case RegisterSize::BYTE: return "\%bl";
+            }
+            break;
+        case RegisterName::R12:
+            switch (size) {
+                case RegisterSize::QWORD: return "\%r12";
+                case RegisterSize::DWORD: return "\%r12d";
+                case RegisterSize::BYTE: return "\%r12b";
+            }
+            break;
+        case RegisterName::R13:
+            switch (size) {
+                case RegisterSize::QWORD: return "\%r13";
+                case RegisterSize::DWORD: return "\%r13d";
+                case RegisterSize::BYTE: return "\%r13b";
+            }
+            break;
+        case RegisterName::R14:
+            switch (size) {
+                case RegisterSize::QWORD: return "\%r14";
+                case RegisterSize::DWORD: return "\%r14d";
+                case RegisterSize::BYTE: return "\%r14b";
+            }
+            break;
+        case RegisterName::R15:
+            switch (size) {
+                case RegisterSize::QWORD: return "\%r15";
+                case RegisterSize::DWORD: return "\%r15d";
+                case RegisterSize::BYTE: return "\%r15b";
+            }
+            break;
     }
     throw std::invalid_argument("Unhandled RegisterName or RegisterSize in reg_name_to_string");
 }
@@ -171,6 +220,28 @@ constexpr std::array<asmb::RegisterName, 6> ARG_REGISTERS = {
     asmb::RegisterName::R9,
 };
 
+// Registers handed out by the register allocator, caller-saved ones first as they cost nothing to
+// use. R10 and R11 are left out as FixUpAsmbInstructions needs them as scratch registers.
+constexpr std::array<asmb::RegisterName, 12> ALLOCATABLE_REGISTERS = {
+    asmb::RegisterName::AX,
+    asmb::RegisterName::CX,
+    asmb::RegisterName::DX,
+    asmb::RegisterName::DI,
+    asmb::RegisterName::SI,
+    asmb::RegisterName::R8,
+    asmb::RegisterName::R9,
+    asmb::RegisterName::BX,
+    asmb::RegisterName::R12,
+    asmb::RegisterName::R13,
+    asmb::RegisterName::R14,
+    asmb::RegisterName::R15,
+};
+
+constexpr bool is_callee_saved(RegisterName reg) {
+    return reg == RegisterName::BX || reg == RegisterName::R12 || reg == RegisterName::R13
+        || reg == RegisterName::R14 || reg == RegisterName::R15;
+}
+
 // ------------------------------> ConditionCode <------------------------------
 
 enum class ConditionCode {
@@ -179,7 +250,8 @@ enum class ConditionCode {
     G,
     GE,
     L,
-    LE
+    LE,
+    A       // unsigned above, for bounds checks
 };
 
 constexpr std::string_view condition_code_to_string(ConditionCode code) {
@@ -190,6 +262,7 @@ constexpr std::string_view condition_code_to_string(ConditionCode code) {
         case ConditionCode::GE: return "ge";
         case ConditionCode::L:  return "l";
         case ConditionCode::LE: return "le";
+        case ConditionCode::A:  return "a";
     }
     throw std::invalid_argument("Unhandled ConditionCode in condition_code_to_string");
 }
@@ -207,8 +280,8 @@ struct Reg {
 };
 
 struct Pseudo {
-    std::string mName;
-    Pseudo(std::string name) : mName(std::move(name)) {}
+    SymbolId mName;
+    Pseudo(SymbolId name) : mName(name) {}
 };
 
 struct Stack {
@@ -247,6 +320,12 @@ struct Idiv {
     Idiv(Operand operand) : mOperand(std::move(operand)) {}
 };
 
+// One operand signed multiply, EDX:EAX = EAX * mOperand
+struct Imul {
+    Operand mOperand;
+    Imul(Operand operand) : mOperand(std::move(operand)) {}
+};
+
 struct Cdq {};
 
 struct AllocateStack {
@@ -266,16 +345,28 @@ struct Cmp {
 };
 
 struct Jmp {
-    std::string mIdentifier;
-    Jmp(std::string identifier) : mIdentifier(std::move(identifier)) {}
+    SymbolId mIdentifier;
+    Jmp(SymbolId identifier) : mIdentifier(identifier) {}
 };
 
 struct JmpCC {
     ConditionCode mCondCode;
-    std::string mIdentifier;
-    JmpCC(ConditionCode condCode, std::string identifier)
+    SymbolId mIdentifier;
+    JmpCC(ConditionCode condCode, SymbolId identifier)
     :   mCondCode(condCode),
-        mIdentifier(std::move(identifier)) {}
+        mIdentifier(identifier) {}
+};
+
+/// Indirect jump through a table of targets, mIndex must be a register already checked to be
+/// in range. The table itself is written to .rodata after the function.
+struct JmpTable {
+    Operand mIndex;
+    SymbolId mTable;
+    std::vector<SymbolId> mTargets;
+    JmpTable(Operand index, SymbolId table, std::vector<SymbolId> targets)
+    :   mIndex(std::move(index)),
+        mTable(table),
+        mTargets(std::move(targets)) {}
 };
 
 struct SetCC {
@@ -287,8 +378,8 @@ struct SetCC {
 };
 
 struct Label {
-    std::string mIdentifier;
-    Label(std::string identifier) : mIdentifier(std::move(identifier)) {}
+    SymbolId mIdentifier;
+    Label(SymbolId identifier) : mIdentifier(identifier) {}
 };
 
 struct Push {
@@ -296,9 +387,14 @@ struct Push {
     Push(Operand operand) : mOperand(operand) {}
 };
 
+struct Pop {
+    RegisterName mReg;
+    Pop(RegisterName reg) : mReg(reg) {}
+};
+
 struct Call {
-    std::string mFuncName;
-    Call(std::string funcName) : mFuncName(std::move(funcName)) {}
+    SymbolId mFuncName;
+    Call(SymbolId funcName) : mFuncName(funcName) {}
 };
 
 struct Ret {
@@ -306,18 +402,18 @@ struct Ret {
 };
 
 
-using Instruction = std::variant<Mov, Unary, Binary, Idiv, Cdq, 
+using Instruction = std::variant<Mov, Unary, Binary, Idiv, Imul, Cdq, 
                                  AllocateStack, DeallocateStack, Cmp, Jmp,
-                                 JmpCC, SetCC, Label, Push, Call, Ret >;
+                                 JmpCC, JmpTable, SetCC, Label, Push, Pop, Call, Ret >;
 
 // ------------------------------> Function Definition <------------------------------
 
 struct Function {
-    std::string mIdentifier;
+    SymbolId mIdentifier;
     std::vector<Instruction> mInstructions;
     
-    Function(std::string identifier, std::vector<Instruction> instructions)
-        : mIdentifier(std::move(identifier)), mInstructions(std::move(instructions)) {}
+    Function(SymbolId identifier, std::vector<Instruction> instructions)
+        : mIdentifier(identifier), mInstructions(std::move(instructions)) {}
 };
 
 // ------------------------------> Program <------------------------------
@@ -7,6 +7,9 @@
 #include <optional>
 #include <variant>
 #include <cassert>
+#include <span>
+#include "arena.hpp"
+#include "interner.hpp"
 
 namespace compiler::ast::c {
 
@@ -86,6 +89,8 @@ struct Conditional;
 struct FunctionCall;
 using Expression = std::variant<Constant, Unary, Binary, Variable, Assignment, Crement, Conditional, FunctionCall>;
 
+// Sub-expressions are allocated in the Program's arena and are never owned by their parent.
+
 struct Constant {
     int mValue;
     Constant(int constant) : mValue(constant) {}
@@ -93,95 +98,98 @@ struct Constant {
 
 struct Unary {
     UnaryOperator mOp;
-    std::unique_ptr<Expression> mExpr;
-    Unary(UnaryOperator op, std::unique_ptr<Expression> expr) : mOp(op), mExpr(std::move(expr)) {}
+    Expression* mExpr;
+    Unary(UnaryOperator op, Expression* expr) : mOp(op), mExpr(expr) {}
 };
 
 struct Binary {
     BinaryOperator mOp;
-    std::unique_ptr<Expression> mLeft;
-    std::unique_ptr<Expression> mRight;
-    Binary(BinaryOperator op, std::unique_ptr<Expression> left, std::unique_ptr<Expression> right)
-        : mOp(op), mLeft(std::move(left)), mRight(std::move(right)) {}
+    Expression* mLeft;
+    Expression* mRight;
+    Binary(BinaryOperator op, Expression* left, Expression* right)
+        : mOp(op), mLeft(left), mRight(right) {}
 };
 
 struct Variable {
-    std::string mIdentifier;
-    Variable(std::string identifier) : mIdentifier(std::move(identifier)) {}
+    SymbolId mIdentifier;
+    Variable(SymbolId identifier) : mIdentifier(identifier) {}
 };
 
 struct Assignment {
-    std::unique_ptr<Expression> mLeft;
-    std::unique_ptr<Expression> mRight;
-    Assignment(std::unique_ptr<Expression> left, std::unique_ptr<Expression> right)
-    :   mLeft(std::move(left)),
-        mRight(std::move(right)) {}
+    Expression* mLeft;
+    Expression* mRight;
+    Assignment(Expression* left, Expression* right)
+    :   mLeft(left),
+        mRight(right) {}
 };
 
 struct Crement {
-    std::unique_ptr<Expression> mVar;
+    Expression* mVar;
     bool mIncrement;
     bool mPost;
-    Crement(std::unique_ptr<Expression> var, bool increment, bool post)
-    :   mVar(std::move(var)),
+    Crement(Expression* var, bool increment, bool post)
+    :   mVar(var),
         mIncrement(increment),
         mPost(post) {}
 };
 
 struct Conditional {
-    std::unique_ptr<Expression> mCondition;
-    std::unique_ptr<Expression> mThen;
-    std::unique_ptr<Expression> mElse;
-    Conditional(std::unique_ptr<Expression> conditionExpr,
-                std::unique_ptr<Expression> thenExpr,
-                std::unique_ptr<Expression> elseExpr)
-    :   mCondition(std::move(conditionExpr)),
-        mThen(std::move(thenExpr)),
-        mElse(std::move(elseExpr)) {}
+    Expression* mCondition;
+    Expression* mThen;
+    Expression* mElse;
+    Conditional(Expression* conditionExpr,
+                Expression* thenExpr,
+                Expression* elseExpr)
+    :   mCondition(conditionExpr),
+        mThen(thenExpr),
+        mElse(elseExpr) {}
 };
 
 struct FunctionCall {
-    std::string mIdentifier;
-    std::vector<std::unique_ptr<Expression>> mArgs;
+    SymbolId mIdentifier;
+    std::span<Expression*> mArgs;
 
-    FunctionCall(std::string identifier, std::vector<std::unique_ptr<Expression>> args)
-    :   mIdentifier(std::move(identifier)), mArgs(std::move(args)) {}
+    FunctionCall(SymbolId identifier, std::span<Expression*> args)
+    :   mIdentifier(identifier), mArgs(args) {}
 };
 
+// With interned identifiers the arena never has to run an expression destructor.
+static_assert(std::is_trivially_destructible_v<Expression>);
+
 // ------------------------------> Declaration <------------------------------
 
 // Forward declaration
 struct Block;
 
 struct VarDecl {
-    std::string mIdentifier;
+    SymbolId mIdentifier;
     std::optional<Expression> mExpr;
 
-    VarDecl(std::string identifier, Expression expression)
-    :   mIdentifier(std::move(identifier)),
+    VarDecl(SymbolId identifier, Expression expression)
+    :   mIdentifier(identifier),
         mExpr(std::move(expression)) {}
 
-    VarDecl(std::string identifier) 
-    :   mIdentifier(std::move(identifier)), 
+    VarDecl(SymbolId identifier) 
+    :   mIdentifier(identifier), 
         mExpr(std::nullopt) {}
 };
 
 struct FuncDecl {
-    std::string mIdentifier;
-    std::vector<std::string> mParams;
+    SymbolId mIdentifier;
+    std::vector<SymbolId> mParams;
     std::unique_ptr<Block> mBody = nullptr;
 
-    FuncDecl(std::string identifier) 
-    :   mIdentifier(std::move(identifier)) {}
+    FuncDecl(SymbolId identifier) 
+    :   mIdentifier(identifier) {}
 
-    FuncDecl(std::string identifier, std::vector<std::string> params)
-    :   mIdentifier(std::move(identifier)), mParams(std::move(params)) {}
+    FuncDecl(SymbolId identifier, std::vector<SymbolId> params)
+    :   mIdentifier(identifier), mParams(std::move(params)) {}
 
-    FuncDecl(std::string identifier, std::unique_ptr<Block> body)
-    :   mIdentifier(std::move(identifier)), mBody(std::move(body)) {}
+    FuncDecl(SymbolId identifier, std::unique_ptr<Block> body)
+    :   mIdentifier(identifier), mBody(std::move(body)) {}
 
-    FuncDecl(std::string identifier, std::vector<std::string> params, std::unique_ptr<Block> body)
-    :   mIdentifier(std::move(identifier)), mParams(std::move(params)), mBody(std::move(body)) {}
+    FuncDecl(SymbolId identifier, std::vector<SymbolId> params, std::unique_ptr<Block> body)
+    :   mIdentifier(identifier), mParams(std::move(params)), mBody(std::move(body)) {}
 
 };
 
@@ -234,15 +242,15 @@ struct If {
 };
 
 struct GoTo {
-    std::string mTarget;
-    GoTo(std::string target) : mTarget(std::move(target)) {}
+    SymbolId mTarget;
+    GoTo(SymbolId target) : mTarget(target) {}
 };
 
 struct LabelledStatement {
-    std::string mIdentifier;
+    SymbolId mIdentifier;
     std::unique_ptr<Statement> mStatement;
-    LabelledStatement(std::string identifier, std::unique_ptr<Statement> statement)
-    :   mIdentifier(std::move(identifier)),
+    LabelledStatement(SymbolId identifier, std::unique_ptr<Statement> statement)
+    :   mIdentifier(identifier),
         mStatement(std::move(statement)) {}
 };
 
@@ -253,29 +261,29 @@ struct CompoundStatement {
 };
 
 struct Break {
-    std::string mLabel;
-    Break(std::string label = "") : mLabel(label) {}
+    SymbolId mLabel;
+    Break(SymbolId label = SymbolId()) : mLabel(label) {}
 };
 
 struct Continue {
-    std::string mLabel;
-    Continue(std::string label = "") : mLabel(label) {}
+    SymbolId mLabel;
+    Continue(SymbolId label = SymbolId()) : mLabel(label) {}
 };
 
 struct While {
     Expression mCondition;
     std::unique_ptr<Statement> mBody;
-    std::string mLabel;
-    While(Expression condition, std::unique_ptr<Statement> body, std::string label = "")
+    SymbolId mLabel;
+    While(Expression condition, std::unique_ptr<Statement> body, SymbolId label = SymbolId())
     :   mCondition(std::move(condition)), mBody(std::move(body)), mLabel(label) {}
 };
 
 struct DoWhile {
     std::unique_ptr<Statement> mBody;
     Expression mCondition;
-    std::string mLabel;
-    DoWhile(std::unique_ptr<Statement> body, Expression condition, std::string label = "")
-    :   mBody(std::move(body)), mCondition(std::move(condition)), mLabel(std::move(label)) {}
+    SymbolId mLabel;
+    DoWhile(std::unique_ptr<Statement> body, Expression condition, SymbolId label = SymbolId())
+    :   mBody(std::move(body)), mCondition(std::move(condition)), mLabel(label) {}
 };
 
 using ForInit = std::variant<VarDecl, std::optional<Expression>>;
@@ -285,9 +293,9 @@ struct For {
     std::optional<Expression> mCondition;
     std::optional<Expression> mPost;
     std::unique_ptr<Statement> mBody;
-    std::string mLabel;
-    For(ForInit forInit, std::optional<Expression> condition, std::optional<Expression> post, std::unique_ptr<Statement> body, std::string label = "")
-    :   mForInit(std::move(forInit)), mCondition(std::move(condition)), mPost(std::move(post)), mBody(std::move(body)), mLabel(std::move(label)) {}
+    SymbolId mLabel;
+    For(ForInit forInit, std::optional<Expression> condition, std::optional<Expression> post, std::unique_ptr<Statement> body, SymbolId label = SymbolId())
+    :   mForInit(std::move(forInit)), mCondition(std::move(condition)), mPost(std::move(post)), mBody(std::move(body)), mLabel(label) {}
 };
 
 struct Switch {
@@ -296,10 +304,10 @@ struct Switch {
 
     Expression mSelector;
     std::unique_ptr<Statement> mBody;
-    std::string mLabel;
+    SymbolId mLabel;
 
-    Switch(Expression selector, std::unique_ptr<Statement> body, std::string label = "")
-    :   mSelector(std::move(selector)), mBody(std::move(body)), mLabel(std::move(label)) {}
+    Switch(Expression selector, std::unique_ptr<Statement> body, SymbolId label = SymbolId())
+    :   mSelector(std::move(selector)), mBody(std::move(body)), mLabel(label) {}
 
     void addCase(int newCase) {
         mCases.push_back(newCase);
@@ -309,17 +317,17 @@ struct Switch {
 struct Case {
     Expression mCondition;
     std::unique_ptr<Statement> mStmt;
-    std::string mLabel;
+    SymbolId mLabel;
 
-    Case(Expression condition, std::unique_ptr<Statement> stmt, std::string label = "")
-    :   mCondition(std::move(condition)), mStmt(std::move(stmt)), mLabel(std::move(label)) {}
+    Case(Expression condition, std::unique_ptr<Statement> stmt, SymbolId label = SymbolId())
+    :   mCondition(std::move(condition)), mStmt(std::move(stmt)), mLabel(label) {}
 };
 
 struct Default {
     std::unique_ptr<Statement> mStmt;
-    std::string mLabel;
-    Default(std::unique_ptr<Statement> stmt, std::string label = "")
-    :   mStmt(std::move(stmt)), mLabel(std::move(label)) {}
+    SymbolId mLabel;
+    Default(std::unique_ptr<Statement> stmt, SymbolId label = SymbolId())
+    :   mStmt(std::move(stmt)), mLabel(label) {}
 };
 
 struct NullStatement {};
@@ -337,6 +345,8 @@ struct Block {
 // ------------------------------> Program Definition <------------------------------
 
 struct Program {
+    // Declared first so it's destroyed last, every expression in the tree lives in here.
+    std::unique_ptr<Arena> mArena = std::make_unique<Arena>();
     std::vector<FuncDecl> mDeclarations;
 
     Program(std::vector<FuncDecl>  declarations)
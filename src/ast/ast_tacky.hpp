@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include "interner.hpp"
 
 namespace compiler::ast::tacky {
 
@@ -88,8 +89,8 @@ struct Constant {
 };
 
 struct Var {
-    std::string mIdentifier;
-    Var(std::string identifier) : mIdentifier(std::move(identifier)) {}
+    SymbolId mIdentifier;
+    Var(SymbolId identifier) : mIdentifier(identifier) {}
 };
 
 using Val = std::variant<Constant, Var>;
@@ -127,54 +128,79 @@ struct Copy {
 };
 
 struct Jump {
-    std::string mTarget;
-    Jump(std::string target) : mTarget(std::move(target)) {}
+    SymbolId mTarget;
+    Jump(SymbolId target) : mTarget(target) {}
 };
 
 struct JumpIfZero {
     Val mCondition;
-    std::string mTarget;
-    JumpIfZero(Val condition, std::string target) : mCondition(std::move(condition)), mTarget(std::move(target)) {}
+    SymbolId mTarget;
+    JumpIfZero(Val condition, SymbolId target) : mCondition(std::move(condition)), mTarget(target) {}
 };
 
 struct JumpIfNotZero {
     Val mCondition;
-    std::string mTarget;
-    JumpIfNotZero(Val condition, std::string target) : mCondition(std::move(condition)), mTarget(std::move(target)) {}
+    SymbolId mTarget;
+    JumpIfNotZero(Val condition, SymbolId target) : mCondition(std::move(condition)), mTarget(target) {}
 };
 
 struct JumpIfEqual {
     Val mSrc1;
     Val mSrc2;
-    std::string mTarget;
-    JumpIfEqual(Val src1, Val src2, std::string target) : mSrc1(std::move(src1)), mSrc2(std::move(src2)), mTarget(std::move(target)) {}
+    SymbolId mTarget;
+    JumpIfEqual(Val src1, Val src2, SymbolId target) : mSrc1(std::move(src1)), mSrc2(std::move(src2)), mTarget(target) {}
+};
+
+// Jumps when mSrc1 < mSrc2, compared as signed ints
+struct JumpIfLess {
+    Val mSrc1;
+    Val mSrc2;
+    SymbolId mTarget;
+    JumpIfLess(Val src1, Val src2, SymbolId target) : mSrc1(std::move(src1)), mSrc2(std::move(src2)), mTarget(target) {}
+};
+
+// Jumps to mTargets[mIndex - mLow], or to mDefault when that's out of range
+struct JumpTable {
+    Val mIndex;
+    int32_t mLow;
+    std::vector<SymbolId> mTargets;
+    SymbolId mDefault;
+    SymbolId mTable;    // name of the table in the emitted code
+
+    JumpTable(Val index, int32_t low, std::vector<SymbolId> targets, SymbolId defaultTarget, SymbolId table)
+        :   mIndex(std::move(index)),
+            mLow(low),
+            mTargets(std::move(targets)),
+            mDefault(defaultTarget),
+            mTable(table) {}
 };
 
 struct Label {
-    std::string mIdentifier;
-    Label(std::string identifier) : mIdentifier(std::move(identifier)) {}
+    SymbolId mIdentifier;
+    Label(SymbolId identifier) : mIdentifier(identifier) {}
 };
 
 struct FuncCall {
-    std::string mIdentifier;
+    SymbolId mIdentifier;
     std::vector<Val> mArgs;
     Val mDst;
 
-    FuncCall(std::string identifier, std::vector<Val> args, Val dst)
-        :   mIdentifier(std::move(identifier)), mArgs(std::move(args)), mDst(std::move(dst)) {}
+    FuncCall(SymbolId identifier, std::vector<Val> args, Val dst)
+        :   mIdentifier(identifier), mArgs(std::move(args)), mDst(std::move(dst)) {}
 };
 
-using Instruction = std::variant<Return, Unary, Binary, Copy, Jump, JumpIfZero, JumpIfNotZero, JumpIfEqual, Label, FuncCall>;
+using Instruction = std::variant<Return, Unary, Binary, Copy, Jump, JumpIfZero, JumpIfNotZero, JumpIfEqual,
+                                 JumpIfLess, JumpTable, Label, FuncCall>;
 
 // ------------------------------> Function Definition <------------------------------
 
 struct Function {
-    std::string mIdentifier;
-    std::vector<std::string> mParams;
+    SymbolId mIdentifier;
+    std::vector<SymbolId> mParams;
     std::vector<Instruction> mBody;
 
-    Function(std::string identifier, std::vector<std::string> params, std::vector<Instruction> body) : 
-        mIdentifier(std::move(identifier)),
+    Function(SymbolId identifier, std::vector<SymbolId> params, std::vector<Instruction> body) : 
+        mIdentifier(identifier),
         mParams(std::move(params)),
         mBody(std::move(body)) {}
 };
@@ -0,0 +1,65 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+namespace compiler::ast {
+
+// ------------------------------> Dense Bitset <------------------------------
+
+/// Fixed size set of small integers, the fact sets of the dataflow analyses on TACKY and ASMB
+class DenseBitset {
+private:
+    std::vector<uint64_t> mWords;
+    size_t mSize = 0;
+
+    void clearPadding() {
+        if (mSize % 64 != 0)
+            mWords.back() &= (uint64_t(1) << (mSize % 64)) - 1;
+    }
+
+public:
+    DenseBitset() = default;
+    explicit DenseBitset(size_t size, bool value = false)
+        : mWords((size + 63) / 64, value ? ~uint64_t(0) : 0), mSize(size) {
+        clearPadding();
+    }
+
+    size_t size() const { return mSize; }
+
+    bool test(size_t bit) const { return mWords[bit / 64] >> (bit % 64) & 1; }
+    void set(size_t bit) { mWords[bit / 64] |= uint64_t(1) << (bit % 64); }
+    void reset(size_t bit) { mWords[bit / 64] &= ~(uint64_t(1) << (bit % 64)); }
+
+    void setAll() {
+        std::fill(mWords.begin(), mWords.end(), ~uint64_t(0));
+        clearPadding();
+    }
+
+    void resetAll() {
+        std::fill(mWords.begin(), mWords.end(), 0);
+    }
+
+    void intersectWith(const DenseBitset& other) {
+        for (size_t i = 0; i < mWords.size(); ++i)
+            mWords[i] &= other.mWords[i];
+    }
+
+    void unionWith(const DenseBitset& other) {
+        for (size_t i = 0; i < mWords.size(); ++i)
+            mWords[i] |= other.mWords[i];
+    }
+
+    /// @brief Calls f with the index of every set bit, in increasing order
+    template<typename F>
+    void forEach(F&& f) const {
+        for (size_t i = 0; i < mWords.size(); ++i)
+            for (uint64_t word = mWords[i]; word != 0; word &= word - 1)
+                f(i * 64 + std::countr_zero(word));
+    }
+
+    bool operator==(const DenseBitset& other) const = default;
+};
+
+}
@@ -1,7 +1,8 @@
-#include <unordered_map>
+#pragma once
 #include <variant>
 #include <stdint.h>
 #include <string>
+#include "interner.hpp"
 
 namespace compiler::ast {
     
@@ -26,11 +27,12 @@ struct SymbolInfo {
     bool mDefined; // used for functions
     bool mHasExternalLinkage;
     int32_t mStackSize; // used for functions
+    uint32_t mCalleeSavedCount = 0; // used for functions, registers pushed below the locals
     SymbolInfo() = default;
     SymbolInfo(Type type, bool defined, bool hasExternalLinkage)
         : mType(std::move(type)), mDefined(defined), mHasExternalLinkage(hasExternalLinkage) {}
 };
 
-using SymbolMapType = std::unordered_map<std::string, SymbolInfo>;
+using SymbolMapType = SymbolIdMap<SymbolInfo>;
 
 }
\ No newline at end of file
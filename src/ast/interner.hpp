@@ -0,0 +1,292 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <string>
+
+namespace compiler::ast {
+
+// ------------------------------> SymbolId <------------------------------
+
+/// Handle to an interned identifier. Equal spellings always share an id, so comparing or hashing
+/// identifiers is an integer operation. Id 0 is reserved for the empty string.
+struct SymbolId {
+    uint32_t mValue = 0;
+
+    constexpr SymbolId() = default;
+    constexpr explicit SymbolId(uint32_t value) : mValue(value) {}
+
+    constexpr bool operator==(const SymbolId& other) const = default;
+    constexpr bool empty() const { return mValue == 0; }
+};
+
+// ------------------------------> Generated Names <------------------------------
+
+/// Kinds of compiler generated names. They're stored as a kind, an optional base symbol and a
+/// number, the text is only rendered if something actually prints or emits the name.
+enum class NameKind : uint8_t {
+    Temporary,      // tmp.N
+    UniqueVar,      // base.cvN
+    FunctionLabel,  // base.flN
+    AndFalse,       // and_false.N
+    AndEnd,         // and_end.N
+    OrTrue,         // or_true.N
+    OrEnd,          // or_end.N
+    CondElse,       // cond_expr2.N
+    CondEnd,        // cond_end.N
+    IfElse,         // if_else.N
+    IfEnd,          // if_end.N
+    Loop,           // loop.N
+    Switch,         // switch.N
+    Break,          // break_base
+    Continue,       // continue_base
+    Start,          // start_base
+    Default,        // default_base
+    Case,           // case_N_base
+    SwitchLess,     // less_N_base
+    SwitchTable,    // table_base
+    Count
+};
+
+struct GeneratedName {
+    NameKind mKind;
+    SymbolId mBase;
+    int64_t mNumber;
+};
+
+// ------------------------------> StringInterner <------------------------------
+
+class StringInterner {
+private:
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+
+    // Spellings are copied into fixed chunks so the views handed out never move
+    std::vector<std::unique_ptr<char[]>> mChunks;
+    char* mCursor = nullptr;
+    size_t mRemaining = 0;
+
+    std::vector<std::string_view> mSpellings;
+    std::unordered_map<std::string_view, uint32_t> mIds;
+
+    // Parallel to mSpellings, 1 + index into mGenerated for generated names which haven't been
+    // rendered yet and 0 for everything else
+    std::vector<uint32_t> mUnrendered;
+    std::vector<GeneratedName> mGenerated;
+    std::string mScratch;
+
+    void checkCapacity() const {
+        if (mSpellings.size() >= UINT32_MAX)
+            throw std::runtime_error("Too many distinct identifiers to intern");
+    }
+
+    std::string_view store(std::string_view text) {
+        if (text.size() > mRemaining) {
+            size_t chunkSize = std::max(CHUNK_SIZE, text.size());
+            mChunks.emplace_back(std::make_unique_for_overwrite<char[]>(chunkSize));
+            mCursor = mChunks.back().get();
+            mRemaining = chunkSize;
+        }
+        std::memcpy(mCursor, text.data(), text.size());
+        std::string_view stored(mCursor, text.size());
+        mCursor += text.size();
+        mRemaining -= text.size();
+        return stored;
+    }
+
+    void appendNumber(int64_t number) {
+        char digits[24];
+        auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), number);
+        mScratch.append(digits, end);
+    }
+
+    std::string_view render(const GeneratedName& name) {
+        // Render the base first, it may itself be generated and reuse the scratch buffer
+        std::string_view base = name.mBase.empty() ? std::string_view() : spelling(name.mBase);
+
+        mScratch.clear();
+        switch (name.mKind) {
+            case NameKind::Temporary:       mScratch += "tmp."; appendNumber(name.mNumber); break;
+            case NameKind::UniqueVar:       mScratch += base; mScratch += ".cv"; appendNumber(name.mNumber); break;
+            case NameKind::FunctionLabel:   mScratch += base; mScratch += ".fl"; appendNumber(name.mNumber); break;
+            case NameKind::AndFalse:        mScratch += "and_false."; appendNumber(name.mNumber); break;
+            case NameKind::AndEnd:          mScratch += "and_end."; appendNumber(name.mNumber); break;
+            case NameKind::OrTrue:          mScratch += "or_true."; appendNumber(name.mNumber); break;
+            case NameKind::OrEnd:           mScratch += "or_end."; appendNumber(name.mNumber); break;
+            case NameKind::CondElse:        mScratch += "cond_expr2."; appendNumber(name.mNumber); break;
+            case NameKind::CondEnd:         mScratch += "cond_end."; appendNumber(name.mNumber); break;
+            case NameKind::IfElse:          mScratch += "if_else."; appendNumber(name.mNumber); break;
+            case NameKind::IfEnd:           mScratch += "if_end."; appendNumber(name.mNumber); break;
+            case NameKind::Loop:            mScratch += "loop."; appendNumber(name.mNumber); break;
+            case NameKind::Switch:          mScratch += "switch."; appendNumber(name.mNumber); break;
+            case NameKind::Break:           mScratch += "break_"; mScratch += base; break;
+            case NameKind::Continue:        mScratch += "continue_"; mScratch += base; break;
+            case NameKind::Start:           mScratch += "start_"; mScratch += base; break;
+            case NameKind::Default:         mScratch += "default_"; mScratch += base; break;
+            case NameKind::Case:            mScratch += "case_"; appendNumber(name.mNumber); mScratch += '_'; mScratch += base; break;
+            case NameKind::SwitchLess:      mScratch += "less_"; appendNumber(name.mNumber); mScratch += '_'; mScratch += base; break;
+            case NameKind::SwitchTable:     mScratch += "table_"; mScratch += base; break;
+            case NameKind::Count:           throw std::invalid_argument("NameKind::Count is not a name");
+        }
+        return store(mScratch);
+    }
+
+public:
+    StringInterner() {
+        mSpellings.emplace_back();
+        mUnrendered.push_back(0);
+        mIds.emplace(std::string_view(), 0);
+    }
+
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    SymbolId intern(std::string_view text) {
+        if (auto it = mIds.find(text); it != mIds.end())
+            return SymbolId(it->second);
+
+        checkCapacity();
+        uint32_t id = static_cast<uint32_t>(mSpellings.size());
+        std::string_view stored = store(text);
+        mSpellings.push_back(stored);
+        mUnrendered.push_back(0);
+        mIds.emplace(stored, id);
+        return SymbolId(id);
+    }
+
+    /// @brief Allocate a fresh id for a generated name without building its text
+    SymbolId reserve(const GeneratedName& name) {
+        checkCapacity();
+        uint32_t id = static_cast<uint32_t>(mSpellings.size());
+        mSpellings.emplace_back();
+        mGenerated.push_back(name);
+        mUnrendered.push_back(static_cast<uint32_t>(mGenerated.size()));
+        return SymbolId(id);
+    }
+
+    std::string_view spelling(SymbolId id) {
+        if (uint32_t generated = mUnrendered[id.mValue]) {
+            mUnrendered[id.mValue] = 0;
+            mSpellings[id.mValue] = render(mGenerated[generated - 1]);
+        }
+        return mSpellings[id.mValue];
+    }
+
+    size_t size() const { return mSpellings.size(); }
+};
+
+inline StringInterner*& current_interner() {
+    static thread_local StringInterner fallback;
+    static thread_local StringInterner* current = &fallback;
+    return current;
+}
+
+/// @brief The interner shared by every stage of the compiler. Each thread gets its own, so
+/// separate compilations may run on separate threads but SymbolIds can't cross between them.
+/// Inside an InternerScope it is the scope's interner.
+inline StringInterner& interner() {
+    return *current_interner();
+}
+
+/// Gives one compilation a fresh interner, freed along with every name and id it handed out when
+/// the scope ends. Repeated in-process compilations each open one, so ids and the SymbolIdMaps
+/// indexed by them start from zero every time instead of growing without bound.
+class InternerScope {
+private:
+    StringInterner mInterner;
+    StringInterner* mPrevious;
+
+public:
+    InternerScope() : mPrevious(std::exchange(current_interner(), &mInterner)) {}
+    ~InternerScope() { current_interner() = mPrevious; }
+
+    InternerScope(const InternerScope&) = delete;
+    InternerScope& operator=(const InternerScope&) = delete;
+};
+
+inline SymbolId intern(std::string_view text) {
+    return interner().intern(text);
+}
+
+inline std::string_view spelling(SymbolId id) {
+    return interner().spelling(id);
+}
+
+inline std::ostream& operator<<(std::ostream& os, SymbolId id) {
+    return os << spelling(id);
+}
+
+// ------------------------------> SymbolIdMap <------------------------------
+
+/// Map keyed by SymbolId backed by a vector indexed with the id itself. clear() only revisits
+/// the slots that were filled, so a map can be reused per function without rescanning every id.
+template<typename T>
+class SymbolIdMap {
+private:
+    std::vector<std::optional<T>> mEntries;
+    std::vector<uint32_t> mOccupied;
+
+    std::optional<T>& slot(SymbolId id) {
+        if (id.mValue >= mEntries.size())
+            mEntries.resize(std::max<size_t>(id.mValue + 1, interner().size()));
+        return mEntries[id.mValue];
+    }
+
+public:
+    bool contains(SymbolId id) const {
+        return id.mValue < mEntries.size() && mEntries[id.mValue].has_value();
+    }
+
+    T& at(SymbolId id) {
+        if (!contains(id))
+            throw std::out_of_range("SymbolIdMap::at called with a missing symbol");
+        return *mEntries[id.mValue];
+    }
+
+    const T& at(SymbolId id) const {
+        if (!contains(id))
+            throw std::out_of_range("SymbolIdMap::at called with a missing symbol");
+        return *mEntries[id.mValue];
+    }
+
+    T& operator[](SymbolId id) {
+        auto& entry = slot(id);
+        if (!entry.has_value()) {
+            entry.emplace();
+            mOccupied.push_back(id.mValue);
+        }
+        return *entry;
+    }
+
+    void insert_or_assign(SymbolId id, T value) {
+        auto& entry = slot(id);
+        if (!entry.has_value())
+            mOccupied.push_back(id.mValue);
+        entry = std::move(value);
+    }
+
+    void clear() {
+        for (uint32_t id : mOccupied)
+            mEntries[id].reset();
+        mOccupied.clear();
+    }
+};
+
+}
+
+template<>
+struct std::hash<compiler::ast::SymbolId> {
+    size_t operator()(compiler::ast::SymbolId id) const noexcept {
+        return std::hash<uint32_t>()(id.mValue);
+    }
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include "interner.hpp"
+
+namespace compiler::ast {
+
+// ------------------------------> NameGenerator <------------------------------
+
+/// Source of unique temporaries and labels for one compilation. Every kind of name is numbered
+/// from zero by its own counter, and each name is only reserved as an id in the interner, its
+/// text isn't built unless the name is printed or emitted.
+class NameGenerator {
+private:
+    std::array<uint32_t, static_cast<size_t>(NameKind::Count)> mCounters{};
+
+    // Names derived from another symbol are shared, every break out of a loop must target the
+    // same label for instance.
+    struct DerivedKey {
+        NameKind mKind;
+        SymbolId mBase;
+        int64_t mNumber;
+        bool operator==(const DerivedKey& other) const = default;
+    };
+
+    struct DerivedKeyHash {
+        size_t operator()(const DerivedKey& key) const noexcept {
+            size_t hash = std::hash<int64_t>()(key.mNumber);
+            hash ^= (static_cast<size_t>(key.mBase.mValue) << 8 | static_cast<size_t>(key.mKind)) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+            return hash;
+        }
+    };
+
+    std::unordered_map<DerivedKey, SymbolId, DerivedKeyHash> mDerived;
+
+    uint32_t next(NameKind kind) {
+        return mCounters[static_cast<size_t>(kind)]++;
+    }
+
+public:
+    NameGenerator() = default;
+    NameGenerator(const NameGenerator&) = delete;
+    NameGenerator& operator=(const NameGenerator&) = delete;
+
+    SymbolId makeTemporary() {
+        return interner().reserve({NameKind::Temporary, SymbolId(), next(NameKind::Temporary)});
+    }
+
+    /// @brief Fresh name for a variable declaration, keeps the source name as a prefix
+    SymbolId makeUniqueVar(SymbolId name) {
+        return interner().reserve({NameKind::UniqueVar, name, next(NameKind::UniqueVar)});
+    }
+
+    SymbolId makeLoopID() {
+        return interner().reserve({NameKind::Loop, SymbolId(), next(NameKind::Loop)});
+    }
+
+    SymbolId makeSwitchID() {
+        return interner().reserve({NameKind::Switch, SymbolId(), next(NameKind::Switch)});
+    }
+
+    /// @brief Two labels sharing one number, numbered by the counter of the first kind
+    std::pair<SymbolId, SymbolId> makeLabelPair(NameKind first, NameKind second) {
+        uint32_t number = next(first);
+        return {
+            interner().reserve({first, SymbolId(), number}),
+            interner().reserve({second, SymbolId(), number})
+        };
+    }
+
+    /// @brief Name built from base (and number), asking for the same one twice gives the same id
+    SymbolId derive(NameKind kind, SymbolId base, int64_t number = 0) {
+        auto [it, inserted] = mDerived.try_emplace(DerivedKey{kind, base, number});
+        if (inserted)
+            it->second = interner().reserve({kind, base, number});
+        return it->second;
+    }
+};
+
+}
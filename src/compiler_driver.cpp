@@ -3,27 +3,53 @@
 #include <string>
 #include <cstdlib>
 #include <filesystem>
+#include <optional>
 #include <format>
-#include <fstream>
 #include "utils.h"
 #include "lexer.hpp"
+#include "preprocessor.hpp"
 #include "ast/ast_c.hpp"
 #include "parser.hpp"
 #include "visitors/asmb_visitors/printing.hpp"
 #include "visitors/c_visitors/utils.hpp"
 #include "visitors/tacky_visitors/printing.hpp"
+#include "visitors/tacky_visitors/control_flow_graph.hpp"
+#include "visitors/tacky_visitors/optimizer.hpp"
 #include "visitors/c_visitors/semantic_analysis.hpp"
 #include "visitors/c_to_tacky.hpp"
 #include "visitors/tacky_to_asmb.hpp"
+#include "visitors/asmb_visitors/register_allocation.hpp"
 #include "visitors/asmb_visitors/asmb_to_file.hpp"
+#include "visitors/asmb_visitors/asmb_to_object.hpp"
+#include "visitors/asmb_visitors/jit.hpp"
+#include "visitors/asmb_visitors/peephole.hpp"
 
 namespace fs = std::filesystem;
 
-fs::path preprocess_file(fs::path source_path, fs::path output_path, const cxxopts::ParseResult& args);
-fs::path compile(fs::path source_path, fs::path output_path, const cxxopts::ParseResult& args);
-void assemble(fs::path source_path, fs::path output_path, const cxxopts::ParseResult& args);
+std::string preprocess_source(fs::path source_path, const cxxopts::ParseResult& args);
+std::optional<compiler::ast::asmb::Program> generate_asmb(const Utils::SourceBuffer& source, compiler::ast::SymbolMapType& symbolMap, const cxxopts::ParseResult& args);
+fs::path compile(const Utils::SourceBuffer& source, fs::path output_path, const cxxopts::ParseResult& args);
+std::optional<compiler::codegen::ExecutableImage> load(const Utils::SourceBuffer& source, const cxxopts::ParseResult& args);
+void optimize_tacky(compiler::ast::tacky::Program& program, const cxxopts::ParseResult& args);
+void allocate_registers(compiler::ast::asmb::Program& program, compiler::ast::SymbolMapType& symbolMap, const cxxopts::ParseResult& args);
+void optimize_asmb(compiler::ast::asmb::Program& program, const cxxopts::ParseResult& args);
+void link(fs::path object_path, fs::path output_path);
+int compiler_main(int argc, char* argv[]);
+
+// Stack for the compiler's recursive descent, at about 1KB per nesting level in an unoptimized build
+// this allows sources nested some 200k levels deep.
+constexpr size_t COMPILER_STACK_SIZE = 256 * 1024 * 1024;
 
 int main(int argc, char* argv[]) {
+    try {
+        return Utils::runWithStack(COMPILER_STACK_SIZE, [&] { return compiler_main(argc, argv); });
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
+
+int compiler_main(int argc, char* argv[]) {
     cxxopts::Options options("Compiler Driver", "Driver for my C Compiler");
     options.add_options()
         ("s,source", "Source file", cxxopts::value<fs::path>())
@@ -32,11 +58,18 @@ int main(int argc, char* argv[]) {
         ("E,preprocess", "Stop at preprocessing")
         ("S,assembly", "Stop at assembly generation")
         ("c", "Build object file and don't invoke linker")
+        ("run", "Compile into memory and run main in-process, exiting with its return value")
         ("lex", "Stop at lexing")
         ("parse", "Stop at parsing")
         ("validate", "Stop at C AST validation")
         ("tacky", "Stop at tacky AST generation")
-        ("codegen", "Stop at assembly generation");
+        ("tacky-cfg", "Stop at tacky AST generation and print its control flow graph in Graphviz format")
+        ("codegen", "Stop at assembly generation")
+        ("optimize", "TACKY optimizations to run, comma separated (fold, unreachable, copy, dead-stores, all)", cxxopts::value<std::vector<std::string>>())
+        ("regalloc", "Register allocator (graph, linear, none)", cxxopts::value<std::string>()->default_value("graph"))
+        ("peephole", "ASMB peephole rules to run, comma separated (self-move, redundant-load, forward-store, dead-store, "
+                     "compare-zero, setcc-xor, zero-xor, multiply-shift, add-increment, all)", cxxopts::value<std::vector<std::string>>())
+        ("stats", "Print what the --optimize passes and --peephole rules changed to stderr");
 
     options.parse_positional({"source"});
 
@@ -58,10 +91,12 @@ int main(int argc, char* argv[]) {
         output_path.replace_extension();  // removes .c or whatever is there
     }
 
-    // Preprocessing Stage
-    fs::path preprocessed_path;
+    // Preprocessing Stage, the text stays in memory unless -E is set
+    std::string preprocessed;
     try {
-        preprocessed_path = preprocess_file(source_path, output_path, args);
+        preprocessed = preprocess_source(source_path, args);
+        if (args.count("preprocess"))
+            compiler::codegen::write_file(std::format("{}.i", output_path.string()), preprocessed);
     } catch (const std::exception& e) {
         std::cerr << "Preprocessing failed: " << e.what() << std::endl;
         return 1;
@@ -70,120 +105,236 @@ int main(int argc, char* argv[]) {
     if (args.count("preprocess"))
         return 0;
 
+    // Tokens and identifiers are views straight into the preprocessed text
+    Utils::SourceBuffer source(std::move(preprocessed));
+    // Every id handed out while compiling (and running) this source is released with it
+    compiler::ast::InternerScope interner;
+
+    // In-process Execution Stage, nothing is written
+    if (args.count("run")) {
+        std::optional<compiler::codegen::ExecutableImage> image;
+        try {
+            image = load(source, args);
+        } catch (const std::exception& e) {
+            std::cerr << "Compilation failed: " << e.what() << std::endl;
+            return 1;
+        }
+
+        if (!image)
+            return 0;
+        try {
+            return image->runMain();
+        } catch (const std::exception& e) {
+            std::cerr << "Execution failed: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
     // Compilation Stage
     fs::path compiled_path;
     try {
-        compiled_path = compile(preprocessed_path, output_path, args);
+        compiled_path = compile(source, output_path, args);
     } catch(const std::exception& e) {
         std::cerr << "Compilation failed: " << e.what() << std::endl;
-        fs::remove(preprocessed_path);
         return 1;
     }
 
-    // Cleanup preprocessed file as it's no longer needed
-    fs::remove(preprocessed_path);
-
-    // Stop if -S or --assembly flag is set or incomplete compilation
-    if (compiled_path.empty() || args.count("assembly"))
+    // Stop if -S or -c is set or incomplete compilation
+    if (compiled_path.empty() || args.count("assembly") || args.count("c"))
         return 0;
 
-    // Assembling Stage
+    // Linking Stage
     try {
-        assemble(compiled_path, output_path, args);
+        link(compiled_path, output_path);
     } catch (const std::exception& e) {
-        std::cerr << "Assembly failed: " << e.what() << std::endl;
+        std::cerr << "Linking failed: " << e.what() << std::endl;
+        fs::remove(compiled_path);
         return 1;
     }
 
-    // Cleanup assembly file as it's no longer needed
+    // Cleanup object file as it's no longer needed
     fs::remove(compiled_path);
 
     return 0;
 }
 
 
-fs::path preprocess_file(fs::path source_path, fs::path output_path, const cxxopts::ParseResult& args) {
-    std::string dest_path = std::format("{}.i", output_path.string());
-
-    std::string command;
-    if (args.count("no-linemarkers")) {
-        command = std::format("gcc -E -P {} -o {}", source_path.string(), dest_path);
-    } else {
-        command = std::format("gcc -E -P {} -o {}", source_path.string(), dest_path);
-    }
-
-    if(system(command.c_str())) {
-        throw std::runtime_error("Sys command error");
-    }
-
-    return fs::path(dest_path);
+std::string preprocess_source(fs::path source_path, const cxxopts::ParseResult& args) {
+    compiler::preprocessor::PreprocessorOptions options;
+    // Line markers are only written for -E, the lexer doesn't read them
+    options.mLineMarkers = args.count("preprocess") && !args.count("no-linemarkers");
+    options.mIncludePaths = compiler::preprocessor::default_include_paths();
+    return compiler::preprocessor::preprocess(source_path, options);
 }
 
 
-fs::path compile(fs::path source_path, fs::path output_path, const cxxopts::ParseResult& args) {
-    std::string sourceString = Utils::readFile(source_path);
-
-    
-    auto lexList = compiler::lexer::lexer(sourceString);
+std::optional<compiler::ast::asmb::Program> generate_asmb(const Utils::SourceBuffer& source, compiler::ast::SymbolMapType& symbolMap, const cxxopts::ParseResult& args) {
+    // Tokens are lexed on demand as the parser pulls them
+    compiler::lexer::TokenStream tokens(source);
     if (args.count("lex")) {
-        lexList.print();
-        return fs::path();
+        tokens.print();
+        return std::nullopt;
     } 
 
-    auto program = compiler::parser::parseProgram(lexList);
+    auto program = compiler::parser::parseProgram(tokens);
     if (args.count("parse")) {
         compiler::ast::c::PrintVisitor()(program);
-        return fs::path();
+        return std::nullopt;
     }
 
-    compiler::ast::SymbolMapType symbolMap;
+    // Temporaries and labels are numbered per compilation
+    compiler::ast::NameGenerator names;
 
     // Validate C AST
-    compiler::ast::c::IdentifierResolution()(program);
+    (compiler::ast::c::IdentifierResolution(names))(program);
     (compiler::ast::c::TypeChecking(symbolMap))(program);
-    compiler::ast::c::ControlFlowLabelling()(program);
-    compiler::ast::c::LabelResolution()(program);
+    (compiler::ast::c::ControlFlowLabelling(names))(program);
+    (compiler::ast::c::LabelResolution(names))(program);
     if (args.count("validate")) {
         compiler::ast::c::PrintVisitor()(program);
-        return fs::path();
+        return std::nullopt;
     }
 
     // Convert C to TACKY
-    auto tackyProgram = compiler::codegen::CToTacky()(program);
+    auto tackyProgram = compiler::codegen::CToTacky(names)(program);
+    optimize_tacky(tackyProgram, args);
     if (args.count("tacky")) {
         compiler::ast::tacky::PrintVisitor()(tackyProgram);
-        return fs::path();
+        return std::nullopt;
+    }
+    if (args.count("tacky-cfg")) {
+        compiler::ast::tacky::print_graphviz(std::cout, tackyProgram);
+        return std::nullopt;
     }
 
     // 0th pass, asmb tree creation
     compiler::ast::asmb::Program asmb = compiler::codegen::TackyToAsmb()(tackyProgram);
+    // Assign registers to pseudos, the ones left over are given stack slots below
+    allocate_registers(asmb, symbolMap, args);
     // 1st pass, removing pseudo-registers
     compiler::codegen::ReplacePseudoRegisters()(asmb, symbolMap);
     // 2nd pass, allocating stack memory and fixing memory-to-memory mov instructions
     compiler::codegen::FixUpAsmbInstructions()(asmb, symbolMap);
+    // 3rd pass, rewriting short instruction sequences into cheaper ones
+    optimize_asmb(asmb, args);
 
     if (args.count("codegen")) {
         compiler::ast::asmb::PrintVisitor()(asmb);;
+        return std::nullopt;
+    }
+
+    return asmb;
+}
+
+
+void optimize_tacky(compiler::ast::tacky::Program& program, const cxxopts::ParseResult& args) {
+    if (!args.count("optimize"))
+        return;
+
+    compiler::ast::tacky::OptimizationOptions options;
+    for (const auto& pass : args["optimize"].as<std::vector<std::string>>()) {
+        if (pass == "fold")
+            options.mFold = true;
+        else if (pass == "unreachable")
+            options.mUnreachable = true;
+        else if (pass == "copy")
+            options.mCopies = true;
+        else if (pass == "dead-stores")
+            options.mDeadStores = true;
+        else if (pass == "all")
+            options = {true, true, true, true};
+        else
+            throw std::runtime_error(std::format("Unknown optimization: {}", pass));
+    }
+
+    auto stats = compiler::ast::tacky::OptimizationPipeline(options)(program);
+    if (!args.count("stats"))
+        return;
+    if (options.mFold)
+        std::cerr << std::format("Constant folding: {} instructions folded, {} eliminated\n",
+                                 stats.mFolding.mFolded, stats.mFolding.mEliminated);
+    if (options.mUnreachable)
+        std::cerr << std::format("Unreachable code elimination: {} jumps threaded, {} instructions eliminated\n",
+                                 stats.mUnreachable.mThreaded, stats.mUnreachable.mEliminated);
+    if (options.mCopies)
+        std::cerr << std::format("Copy propagation: {} operands propagated, {} copies eliminated\n",
+                                 stats.mCopies.mPropagated, stats.mCopies.mEliminated);
+    if (options.mDeadStores)
+        std::cerr << std::format("Dead store elimination: {} instructions eliminated\n",
+                                 stats.mDeadStores.mEliminated);
+    std::cerr << std::format("Optimization converged after {} rounds\n", stats.mRounds);
+}
+
+
+void allocate_registers(compiler::ast::asmb::Program& program, compiler::ast::SymbolMapType& symbolMap, const cxxopts::ParseResult& args) {
+    const auto& allocator = args["regalloc"].as<std::string>();
+    if (allocator == "graph")
+        compiler::codegen::GraphColoringAllocation()(program, symbolMap);
+    else if (allocator == "linear")
+        compiler::codegen::LinearScanAllocation()(program, symbolMap);
+    else if (allocator != "none")
+        throw std::runtime_error(std::format("Unknown register allocator: {}", allocator));
+}
+
+
+void optimize_asmb(compiler::ast::asmb::Program& program, const cxxopts::ParseResult& args) {
+    if (!args.count("peephole"))
+        return;
+
+    compiler::codegen::PeepholeOptions options;
+    for (const auto& rule : args["peephole"].as<std::vector<std::string>>())
+        if (!options.enable(rule))
+            throw std::runtime_error(std::format("Unknown peephole rule: {}", rule));
+
+    auto stats = compiler::codegen::PeepholeOptimizer(options)(program);
+    if (!args.count("stats"))
+        return;
+    for (size_t rule = 0; rule < compiler::codegen::PEEPHOLE_RULES.size(); ++rule)
+        if (options.mEnabled[rule])
+            std::cerr << std::format("Peephole {}: {} hits\n", compiler::codegen::PEEPHOLE_RULES[rule].mName, stats.mHits[rule]);
+}
+
+
+fs::path compile(const Utils::SourceBuffer& source, fs::path output_path, const cxxopts::ParseResult& args) {
+    compiler::ast::SymbolMapType symbolMap;
+    auto asmb = generate_asmb(source, symbolMap, args);
+    if (!asmb)
         return fs::path();
+
+    if (args.count("assembly")) {
+        std::string dest_path = std::format("{}.s", output_path.string());
+
+        // Write assembly to file
+        compiler::codegen::EmitAsmbVisitor emitter(symbolMap);
+        compiler::codegen::write_file(dest_path, emitter(*asmb));
+
+        return fs::path(dest_path);
     }
 
-    std::string dest_path = std::format("{}.s", output_path.string());
+    std::string dest_path = std::format("{}.o", output_path.string());
 
-    // Write assembly to file
-    std::ofstream out(dest_path);
-    out << (compiler::codegen::EmitAsmbVisitor(symbolMap))(asmb);
-    out.close();
+    // Encode machine code and write it as an ELF object, no assembler needed
+    auto object = compiler::codegen::EncodeAsmbVisitor()(*asmb);
+    compiler::codegen::ElfObjectWriter writer;
+    compiler::codegen::write_file(dest_path, writer(object));
 
     return fs::path(dest_path);
 }
 
 
-void assemble(fs::path source_path, fs::path output_path, const cxxopts::ParseResult& args) {
-    std::string command;
-    if (args.count("c"))
-        command = std::format("gcc -c {} -o {}", source_path.string(), output_path.string() + ".o");
-    else
-        command = std::format("gcc {} -o {}", source_path.string(), output_path.string());
+std::optional<compiler::codegen::ExecutableImage> load(const Utils::SourceBuffer& source, const cxxopts::ParseResult& args) {
+    compiler::ast::SymbolMapType symbolMap;
+    auto asmb = generate_asmb(source, symbolMap, args);
+    if (!asmb)
+        return std::nullopt;
+
+    // Encode machine code straight into executable memory, no assembler or linker needed
+    return compiler::codegen::ExecutableImage(compiler::codegen::EncodeAsmbVisitor()(*asmb));
+}
+
+
+void link(fs::path object_path, fs::path output_path) {
+    std::string command = std::format("gcc {} -o {}", object_path.string(), output_path.string());
     if(system(command.c_str())) {
         throw std::runtime_error("Sys command error");
     }
@@ -1,7 +1,10 @@
-#include <ctre.hpp>
 #include <stdexcept>
 #include <vector>
+#include <charconv>
 #include <cxxopts.hpp>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 #include "./lexer.hpp"
 #include "./utils.h"
 
@@ -10,79 +13,298 @@ namespace compiler::lexer {
 // ------------------------------> checkForKeyword <------------------------------
 
 static LexType checkForKeyword(std::string_view sv) {
-    constexpr size_t len = std::size(KEYWORD_MAP);
-    for (size_t i = 0; i < len; ++i) {
-        auto [str, lexType] = KEYWORD_MAP[i];
-        if (sv == str)
-            return lexType;
-    }
+    const auto& [str, lexType] = KEYWORD_TABLE[keyword_hash(sv, KEYWORD_HASH_SEED)];
+    if (sv == str)
+        return lexType;
     // Fall back to identifier if not keyword
     return LexType::Identifier;
 }
 
-// ------------------------------> checkForType <------------------------------
+// ------------------------------> Scan Kernels <------------------------------
+// Each kernel returns a pointer to the first character in [p, end) which is not part of the run.
 
-static std::pair<LexType, std::string_view> checkForType(std::string_view sv) {
-    static constexpr auto pattern = ctll::fixed_string{ R"((?<Identifier>[a-zA-Z_]\w*\b)|(?<Constant>[0-9]+\b))" };
-    auto m = ctre::starts_with<pattern>(sv);
-    if (m) {
-        if (m.get<"Identifier">()) {
-            return std::make_pair(LexType::Identifier, m);
-        } else {
-            return std::make_pair(LexType::Constant, m);
-        }
+#if !defined(__x86_64__)
+
+// Only used where there are no vector kernels, SSE2 is always available on x86-64.
+
+static const char* skipWhitespaceScalar(const char* p, const char* end) {
+    while (p < end && CHAR_CLASS_TABLE[static_cast<unsigned char>(*p)] == CharClass::Whitespace)
+        ++p;
+    return p;
+}
+
+static const char* skipIdentifierScalar(const char* p, const char* end) {
+    while (p < end && is_identifier_char(*p))
+        ++p;
+    return p;
+}
+
+static const char* skipDigitsScalar(const char* p, const char* end) {
+    while (p < end && CHAR_CLASS_TABLE[static_cast<unsigned char>(*p)] == CharClass::Digit)
+        ++p;
+    return p;
+}
+
+#endif
+
+#if defined(__x86_64__)
+
+// Signed byte compares are used throughout, bytes >= 0x80 are negative and so never fall within a range.
+
+static inline __m128i whitespaceMask16(__m128i chunk) {
+    __m128i isSpace = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '));
+    __m128i isControl = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('\t' - 1)),
+                                      _mm_cmplt_epi8(chunk, _mm_set1_epi8('\r' + 1)));
+    return _mm_or_si128(isSpace, isControl);
+}
+
+static inline __m128i digitMask16(__m128i chunk) {
+    return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('0' - 1)),
+                         _mm_cmplt_epi8(chunk, _mm_set1_epi8('9' + 1)));
+}
+
+static inline __m128i identifierMask16(__m128i chunk) {
+    __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+    __m128i isAlpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                    _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+    __m128i isUnderscore = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_'));
+    return _mm_or_si128(_mm_or_si128(isAlpha, isUnderscore), digitMask16(chunk));
+}
+
+// Lexer input is always followed by Utils::SourceBuffer::PADDING readable bytes, so whole chunks
+// are loaded even when they straddle the end of the input.
+static_assert(Utils::SourceBuffer::PADDING >= 32, "Scan kernels over-read by up to 31 bytes");
+
+template<__m128i (*Mask)(__m128i)>
+static const char* skipRunSSE2(const char* p, const char* end) {
+    while (p < end) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        uint32_t outside = ~static_cast<uint32_t>(_mm_movemask_epi8(Mask(chunk))) & 0xFFFF;
+        if (outside)
+            return std::min(p + __builtin_ctz(outside), end);
+        p += 16;
     }
+    return end;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i whitespaceMask32(__m256i chunk) {
+    __m256i isSpace = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' '));
+    __m256i isControl = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, _mm256_set1_epi8('\t' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), chunk));
+    return _mm256_or_si256(isSpace, isControl);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i digitMask32(__m256i chunk) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(chunk, _mm256_set1_epi8('0' - 1)),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chunk));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i identifierMask32(__m256i chunk) {
+    __m256i lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+    __m256i isAlpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                       _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+    __m256i isUnderscore = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('_'));
+    return _mm256_or_si256(_mm256_or_si256(isAlpha, isUnderscore), digitMask32(chunk));
+}
+
+template<__m256i (*Mask)(__m256i)>
+__attribute__((target("avx2")))
+static const char* skipRunAVX2(const char* p, const char* end) {
+    while (p < end) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint32_t outside = ~static_cast<uint32_t>(_mm256_movemask_epi8(Mask(chunk)));
+        if (outside)
+            return std::min(p + __builtin_ctz(outside), end);
+        p += 32;
+    }
+    return end;
+}
 
-    // Check all other token types by iterating through them
-    
-    for (const auto& string_symbol : SORTED_SYMBOL_MAPPING) {
-        if (sv.starts_with(string_symbol.first)) {
-            return std::make_pair(string_symbol.second, string_symbol.first);
+#endif
+
+// ------------------------------> Scan Kernel Dispatch <------------------------------
+
+struct ScanKernels {
+    const char* (*mSkipWhitespace)(const char*, const char*);
+    const char* (*mSkipIdentifier)(const char*, const char*);
+    const char* (*mSkipDigits)(const char*, const char*);
+};
+
+/// Picks the widest kernels the running CPU supports, scalar when not on x86-64.
+static ScanKernels selectScanKernels() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return ScanKernels{
+            skipRunAVX2<whitespaceMask32>,
+            skipRunAVX2<identifierMask32>,
+            skipRunAVX2<digitMask32>
+        };
+    // SSE2 is part of the x86-64 baseline
+    return ScanKernels{
+        skipRunSSE2<whitespaceMask16>,
+        skipRunSSE2<identifierMask16>,
+        skipRunSSE2<digitMask16>
+    };
+#else
+    return ScanKernels{skipWhitespaceScalar, skipIdentifierScalar, skipDigitsScalar};
+#endif
+}
+
+static const ScanKernels SCAN_KERNELS = selectScanKernels();
+
+// ------------------------------> matchSymbol <------------------------------
+
+/// Walks the symbol trie from pos and returns the longest symbol found, Undefined if there is none.
+static std::pair<LexType, size_t> matchSymbol(std::string_view sv, size_t pos) {
+    LexType matchedType = LexType::Undefined;
+    size_t matchedLength = 0;
+
+    size_t node = 0;
+    for (size_t i = pos; i < sv.size(); ++i) {
+        uint8_t charIndex = SYMBOL_CHAR_INDEX[static_cast<unsigned char>(sv[i])];
+        if (charIndex == UINT8_MAX)
+            break;
+        node = SYMBOL_TRIE[node].mChildren[charIndex];
+        if (node == 0)
+            break;
+        if (SYMBOL_TRIE[node].mLexType != LexType::Undefined) {
+            matchedType = SYMBOL_TRIE[node].mLexType;
+            matchedLength = i - pos + 1;
         }
     }
-    
-    return std::make_pair(LexType::Undefined, lex_type_to_str(LexType::Undefined));
+
+    return std::make_pair(matchedType, matchedLength);
 }
 
-// ------------------------------> lexer <------------------------------
+// ------------------------------> throwUnparsableToken <------------------------------
 
-/**
- * @brief Extracts a set of tokens from a string containing C source code.
- * 
- * @param preprocessed_input 
- */
-LexList lexer(std::string_view preprocessed_input) {
-    LexList lexList;
+[[noreturn]] static void throwUnparsableToken(std::string_view input, size_t pos) {
+    auto output_string = Utils::stringCenteredOnPos(input, pos, 30);
+    throw std::runtime_error("Could not parse token at position " + std::to_string(pos)
+        + "\nNearby text:\n" + output_string);
+}
 
-    // while not at end
-    size_t pos = 0;
+// ------------------------------> makeLexItem <------------------------------
+
+static LexItem makeLexItem(LexType lexType, size_t offset, size_t length) {
+    if (length > UINT16_MAX)
+        throw std::runtime_error("Token at position " + std::to_string(offset) + " is too long");
+    return LexItem{static_cast<uint32_t>(offset), static_cast<uint16_t>(length), lexType};
+}
+
+// ------------------------------> checkInputSize <------------------------------
+
+static void checkInputSize(std::string_view preprocessed_input) {
+    if (preprocessed_input.size() > UINT32_MAX)
+        throw std::runtime_error("Source files larger than 4GiB are not supported");
+}
+
+// ------------------------------> lexNextToken <------------------------------
+
+/// The scan kernels read whole chunks, so the input must be followed by Utils::SourceBuffer::PADDING readable bytes.
+static bool lexNextPaddedToken(std::string_view preprocessed_input, size_t& pos, LexItem& item, uint64_t& constantValue) {
+    const char* begin = preprocessed_input.data();
+    const char* end = begin + preprocessed_input.size();
     size_t len = preprocessed_input.size();
+
     while (pos < len) {
-        // remove leading whitespace
-        if (std::isspace(preprocessed_input[pos])) {
-            ++pos;
-            continue;
-        }
+        size_t start = pos;
 
-        // Check for lexType
-        auto [lexType, token_sv] = checkForType(preprocessed_input.substr(pos, len-pos));
+        switch (CHAR_CLASS_TABLE[static_cast<unsigned char>(preprocessed_input[pos])]) {
+            case CharClass::Whitespace:
+                pos = SCAN_KERNELS.mSkipWhitespace(begin + pos + 1, end) - begin;
+                continue;
 
-        // if no match is found, raise an error
-        if (lexType == LexType::Undefined) {
-            auto output_string = Utils::stringCenteredOnPos(preprocessed_input, pos, 30);
-            throw std::runtime_error("Could not parse token at position " + std::to_string(pos)
-                + "\nNearby text:\n" + output_string);
+            case CharClass::IdentifierStart: {
+                pos = SCAN_KERNELS.mSkipIdentifier(begin + pos + 1, end) - begin;
+                auto token_sv = preprocessed_input.substr(start, pos - start);
+                item = makeLexItem(checkForKeyword(token_sv), start, pos - start);
+                return true;
+            }
+
+            case CharClass::Digit: {
+                pos = SCAN_KERNELS.mSkipDigits(begin + pos + 1, end) - begin;
+                // Constants must end on a word boundary, e.g. 123abc is invalid
+                if (pos < len && is_identifier_char(preprocessed_input[pos]))
+                    throwUnparsableToken(preprocessed_input, start);
+                // Decode the value now so the parser never has to re-read the digits
+                auto [ptr, ec] = std::from_chars(begin + start, begin + pos, constantValue);
+                if (ec == std::errc::result_out_of_range)
+                    throw std::runtime_error("Integer constant at position " + std::to_string(start) + " is too large"
+                        + "\nNearby text:\n" + Utils::stringCenteredOnPos(preprocessed_input, start, 30));
+                item = makeLexItem(LexType::Constant, start, pos - start);
+                return true;
+            }
+
+            case CharClass::Symbol: {
+                auto [lexType, length] = matchSymbol(preprocessed_input, pos);
+                if (lexType == LexType::Undefined)
+                    throwUnparsableToken(preprocessed_input, start);
+                item = makeLexItem(lexType, start, length);
+                pos += length;
+                return true;
+            }
+
+            case CharClass::Invalid:
+                throwUnparsableToken(preprocessed_input, start);
         }
-        else if (lexType == LexType::Identifier) {
-            LexType keyword = checkForKeyword(token_sv);
-            lexList.append(keyword, token_sv);
+    }
+
+    return false;
+}
+
+bool lexNextToken(const Utils::SourceBuffer& source, size_t& pos, LexItem& item, uint64_t& constantValue) {
+    return lexNextPaddedToken(source.view(), pos, item, constantValue);
+}
+
+// ------------------------------> TokenStream <------------------------------
+
+TokenStream::TokenStream(const Utils::SourceBuffer& source) : mInput(source.view()), mLineTable(source.view()) {
+    checkInputSize(mInput);
+}
+
+bool TokenStream::fill(size_t offset) {
+    while (mLexedCount <= mCurrentIndex + offset) {
+        if (mExhausted)
+            return false;
+        size_t slot = mLexedCount & (WINDOW_SIZE - 1);
+        if (!lexNextPaddedToken(mInput, mInputPos, mWindow[slot], mConstantValues[slot])) {
+            mExhausted = true;
+            return false;
         }
-        else lexList.append(lexType, token_sv);
+        ++mLexedCount;
+    }
+    return true;
+}
 
-        pos += token_sv.size();
+// ------------------------------> lexer <------------------------------
+
+/**
+ * @brief Extracts a set of tokens from a string containing C source code.
+ * 
+ * Materializes every token at once, the parser pulls tokens through a TokenStream instead.
+ * 
+ * @param source 
+ */
+LexList lexer(const Utils::SourceBuffer& source) {
+    std::string_view preprocessed_input = source.view();
+    checkInputSize(preprocessed_input);
+    LexList lexList(preprocessed_input);
+
+    size_t pos = 0;
+    LexItem item{};
+    uint64_t constantValue = 0;
+    while (lexNextPaddedToken(preprocessed_input, pos, item, constantValue)) {
+        lexList.append(item);
+        if (item.mLexType == LexType::Constant)
+            lexList.appendConstantValue(item, constantValue);
     }
 
     return lexList;
 }
 
-}
\ No newline at end of file
+}
@@ -4,12 +4,16 @@
 #include <memory>
 #include <concepts>
 #include <iostream>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include "utils.h"
 
 namespace compiler::lexer {
 
 // ------------------------------> Type Enum <------------------------------
 
-enum class LexType {
+enum class LexType : uint8_t {
     Identifier,
     Constant,
     BitwiseComplement,
@@ -321,53 +325,262 @@ constexpr std::array<std::pair<std::string_view, LexType>, SYMBOL_MAPPING_SIZE>
 
 constexpr auto SORTED_SYMBOL_MAPPING = generateSortedSymbolMapping();
 
+// ------------------------------> Character Classes <------------------------------
+
+enum class CharClass : uint8_t {
+    Invalid,
+    Whitespace,
+    IdentifierStart,
+    Digit,
+    Symbol
+};
+
+constexpr std::array<CharClass, 256> generateCharClassTable() {
+    std::array<CharClass, 256> table{};
+    table.fill(CharClass::Invalid);
+
+    for (unsigned char c : std::string_view(" \t\n\v\f\r"))
+        table[c] = CharClass::Whitespace;
+    for (int c = 'a'; c <= 'z'; ++c)
+        table[c] = CharClass::IdentifierStart;
+    for (int c = 'A'; c <= 'Z'; ++c)
+        table[c] = CharClass::IdentifierStart;
+    table['_'] = CharClass::IdentifierStart;
+    for (int c = '0'; c <= '9'; ++c)
+        table[c] = CharClass::Digit;
+
+    // Any character which begins a symbol
+    for (const auto& [str, lexType] : SORTED_SYMBOL_MAPPING)
+        table[static_cast<unsigned char>(str[0])] = CharClass::Symbol;
+
+    return table;
+}
+
+/// First-byte dispatch table used by the lexer to decide what kind of token starts at a position.
+constexpr auto CHAR_CLASS_TABLE = generateCharClassTable();
+
+inline constexpr bool is_identifier_char(char c) {
+    auto cc = CHAR_CLASS_TABLE[static_cast<unsigned char>(c)];
+    return cc == CharClass::IdentifierStart || cc == CharClass::Digit;
+}
+
+// ------------------------------> Symbol Trie <------------------------------
+
+// Every distinct character found in a symbol gets a dense index so trie nodes stay small.
+constexpr std::array<uint8_t, 256> generateSymbolCharIndex() {
+    std::array<uint8_t, 256> index{};
+    index.fill(UINT8_MAX);
+
+    uint8_t next = 0;
+    for (const auto& [str, lexType] : SORTED_SYMBOL_MAPPING) {
+        for (char c : str) {
+            if (index[static_cast<unsigned char>(c)] == UINT8_MAX)
+                index[static_cast<unsigned char>(c)] = next++;
+        }
+    }
+    return index;
+}
+
+constexpr auto SYMBOL_CHAR_INDEX = generateSymbolCharIndex();
+
+constexpr size_t countSymbolChars() {
+    size_t count = 0;
+    for (auto idx : SYMBOL_CHAR_INDEX)
+        if (idx != UINT8_MAX) ++count;
+    return count;
+}
+
+constexpr size_t SYMBOL_CHAR_COUNT = countSymbolChars();
+
+struct SymbolTrieNode {
+    std::array<uint8_t, SYMBOL_CHAR_COUNT> mChildren{}; // 0 means no child, root is never a child
+    LexType mLexType = LexType::Undefined;              // Undefined if no symbol ends at this node
+};
+
+// Upper bound on nodes, one root plus one node per symbol character.
+constexpr size_t countSymbolTrieNodes() {
+    size_t count = 1;
+    for (const auto& [str, lexType] : SORTED_SYMBOL_MAPPING)
+        count += str.size();
+    return count;
+}
+
+constexpr std::array<SymbolTrieNode, countSymbolTrieNodes()> generateSymbolTrie() {
+    std::array<SymbolTrieNode, countSymbolTrieNodes()> trie{};
+
+    size_t nodeCount = 1;
+    for (const auto& [str, lexType] : SORTED_SYMBOL_MAPPING) {
+        size_t node = 0;
+        for (char c : str) {
+            uint8_t charIndex = SYMBOL_CHAR_INDEX[static_cast<unsigned char>(c)];
+            if (trie[node].mChildren[charIndex] == 0)
+                trie[node].mChildren[charIndex] = static_cast<uint8_t>(nodeCount++);
+            node = trie[node].mChildren[charIndex];
+        }
+        trie[node].mLexType = lexType;
+    }
+
+    return trie;
+}
+
+/// Trie over every symbol, walked once per token to find the longest matching symbol.
+constexpr auto SYMBOL_TRIE = generateSymbolTrie();
+
+static_assert(countSymbolTrieNodes() <= UINT8_MAX, "Symbol trie node indices must fit in a uint8_t");
+
+// ------------------------------> Keyword Perfect Hash <------------------------------
+
+constexpr size_t KEYWORD_TABLE_SIZE = 32;
+
+inline constexpr uint32_t keyword_hash(std::string_view sv, uint32_t seed) {
+    uint32_t h = static_cast<uint32_t>(sv.size());
+    h = h * seed + static_cast<unsigned char>(sv.front());
+    h = h * seed + static_cast<unsigned char>(sv.back());
+    h ^= h >> 7;
+    return h & (KEYWORD_TABLE_SIZE - 1);
+}
+
+// Search for a seed which maps every keyword to a unique slot.
+constexpr uint32_t findKeywordHashSeed() {
+    for (uint32_t seed = 1; seed < 100000; ++seed) {
+        std::array<bool, KEYWORD_TABLE_SIZE> used{};
+        bool collision = false;
+        for (const auto& [str, lexType] : KEYWORD_MAP) {
+            uint32_t slot = keyword_hash(str, seed);
+            if (used[slot]) {
+                collision = true;
+                break;
+            }
+            used[slot] = true;
+        }
+        if (!collision)
+            return seed;
+    }
+    return 0;
+}
+
+constexpr uint32_t KEYWORD_HASH_SEED = findKeywordHashSeed();
+static_assert(KEYWORD_HASH_SEED != 0, "No perfect hash seed found for KEYWORD_MAP");
+
+constexpr std::array<std::pair<std::string_view, LexType>, KEYWORD_TABLE_SIZE> generateKeywordTable() {
+    std::array<std::pair<std::string_view, LexType>, KEYWORD_TABLE_SIZE> table{};
+    table.fill(std::make_pair(std::string_view(), LexType::Identifier));
+    for (const auto& keyword : KEYWORD_MAP)
+        table[keyword_hash(keyword.first, KEYWORD_HASH_SEED)] = keyword;
+    return table;
+}
+
+/// Keywords placed at their perfect hash slot, empty slots map to Identifier.
+constexpr auto KEYWORD_TABLE = generateKeywordTable();
+
 // ------------------------------> LexItem <------------------------------
 
+/// A token is a position within the source rather than a view, text() rebuilds the view when needed.
 struct LexItem {
+    uint32_t mOffset;   // Byte offset of the token within the source
+    uint16_t mLength;
     LexType mLexType;
-    std::string_view mSV;
+
+    std::string_view text(std::string_view source) const { return source.substr(mOffset, mLength); }
 };
 
+static_assert(sizeof(LexItem) == 8, "LexItem should stay 8 bytes");
+
+// ------------------------------> LineTable <------------------------------
+
+struct SourceLocation {
+    uint32_t mLine;     // 1-based
+    uint32_t mColumn;   // 1-based
+};
+
+/// Maps byte offsets to lines and columns. The line starts are only computed the first time a location is asked for,
+/// which in practice only happens when reporting an error.
+class LineTable {
+private:
+    std::string_view mSource;
+    std::vector<uint32_t> mLineStarts;
+
+public:
+    explicit LineTable(std::string_view source) : mSource(source) {}
+
+    SourceLocation locate(uint32_t offset) {
+        if (mLineStarts.empty()) {
+            mLineStarts.push_back(0);
+            for (size_t pos = mSource.find('\n'); pos != std::string_view::npos; pos = mSource.find('\n', pos + 1))
+                mLineStarts.push_back(static_cast<uint32_t>(pos + 1));
+        }
+        auto lineIt = std::upper_bound(mLineStarts.begin(), mLineStarts.end(), offset) - 1;
+        uint32_t line = static_cast<uint32_t>(lineIt - mLineStarts.begin());
+        return SourceLocation{line + 1, offset - *lineIt + 1};
+    }
+};
+
+// ------------------------------> LexList <------------------------------
+
+/// Materialized token buffer stored as a structure of arrays, 7 bytes per token.
 class LexList {
 private:
-    std::vector<LexItem> mLexVector;
+    std::string_view mSource;
+    std::vector<LexType> mTypes;
+    std::vector<uint32_t> mOffsets;
+    std::vector<uint16_t> mLengths;
+    std::vector<std::pair<uint32_t, uint64_t>> mConstantValues; // (offset, value) of each Constant, sorted by offset
     size_t mCurrentIndex = 0;
 
+    LexItem at(size_t index) const { return LexItem{mOffsets[index], mLengths[index], mTypes[index]}; }
+
 public:
+    explicit LexList(std::string_view source) : mSource(source) {}
+
+    size_t size() const { return mTypes.size(); }
+
+    void append(const LexItem& item) {
+        mTypes.push_back(item.mLexType);
+        mOffsets.push_back(item.mOffset);
+        mLengths.push_back(item.mLength);
+    }
+
+    void appendConstantValue(const LexItem& item, uint64_t value) {
+        mConstantValues.emplace_back(item.mOffset, value);
+    }
 
-    size_t size() { return mLexVector.size(); }
+    /// @brief Text of a token within this list's source
+    std::string_view text(const LexItem& item) const { return item.text(mSource); }
 
-    template<typename... Args>
-    requires std::constructible_from<LexItem, Args...>
-    void append(Args&&... args) {
-        mLexVector.emplace_back(std::forward<Args>(args)...);
+    /// @brief Value decoded by the lexer for a Constant token
+    uint64_t constantValue(const LexItem& item) const {
+        auto it = std::lower_bound(mConstantValues.begin(), mConstantValues.end(), item.mOffset,
+                                   [](const auto& entry, uint32_t offset) { return entry.first < offset; });
+        if (it == mConstantValues.end() || it->first != item.mOffset)
+            throw std::invalid_argument("constantValue called on a token which is not a Constant");
+        return it->second;
     }
 
-    bool hasCurrent() const { return mCurrentIndex < mLexVector.size(); }
+    bool hasCurrent() const { return mCurrentIndex < mTypes.size(); }
 
     /// @brief Get the current LexItem pointed to by the internal index
-    const LexItem& current() const {
+    LexItem current() const {
         if (!hasCurrent()) throw std::out_of_range("No more tokens");
-        return mLexVector[mCurrentIndex];
+        return at(mCurrentIndex);
     }
 
     /// @brief Get the current LexItem pointed to by the internal index and increment the internal index
-    const LexItem& consume() {
+    LexItem consume() {
         if (!hasCurrent()) throw std::out_of_range("No more tokens");
         ++mCurrentIndex;
-        return mLexVector[mCurrentIndex-1];
+        return at(mCurrentIndex-1);
     }
 
-    const LexItem& next() const {
-        if (mCurrentIndex + 1 >= mLexVector.size())
+    LexItem next() const {
+        if (mCurrentIndex + 1 >= mTypes.size())
             throw std::out_of_range("No next token");
-        return mLexVector[mCurrentIndex+1];
+        return at(mCurrentIndex+1);
     }
 
-    const LexItem& peekAtOffset(int32_t n) {
-        if ((mCurrentIndex + n >= mLexVector.size()) || (mCurrentIndex + n < 0))
+    LexItem peekAtOffset(int32_t n) const {
+        if ((mCurrentIndex + n >= mTypes.size()) || (static_cast<int64_t>(mCurrentIndex) + n < 0))
             throw std::out_of_range("No more tokens");
-        return mLexVector[mCurrentIndex+n];
+        return at(mCurrentIndex+n);
     }
 
     /// @brief Reset the internal index to 0
@@ -382,13 +595,99 @@ public:
 
     /// @brief Print the contents of the list
     void print(std::ostream& os = std::cout) const {
+        for (size_t i = 0; i < mTypes.size(); ++i) {
+            os << i << ": " << lex_type_to_str(mTypes[i]);
+            if (mTypes[i] == LexType::Identifier)
+                os << ": " << text(at(i)) << std::endl;
+            else
+                os << std::endl;
+        }
+    }
+};
+
+// ------------------------------> TokenStream <------------------------------
+
+/// Pull based token source, tokens are lexed on demand into a small lookahead window
+/// so the whole file never has to be materialized before parsing.
+/// Tokens are views into the source buffer, which must outlive the stream.
+class TokenStream {
+private:
+    // Must be a power of 2, the parser never looks further than 2 tokens ahead.
+    static constexpr size_t WINDOW_SIZE = 4;
+
+    std::string_view mInput;
+    size_t mInputPos = 0;
+    std::array<LexItem, WINDOW_SIZE> mWindow{};
+    std::array<uint64_t, WINDOW_SIZE> mConstantValues{}; // Values of Constant tokens, parallel to mWindow
+    size_t mCurrentIndex = 0;   // Index of the current token within the whole stream
+    size_t mLexedCount = 0;     // Number of tokens lexed so far
+    bool mExhausted = false;
+    LineTable mLineTable;
+
+    /// Lex until the token at mCurrentIndex + offset is in the window, returns false if the input ends first.
+    bool fill(size_t offset);
+
+    const LexItem& at(size_t offset) const { return mWindow[(mCurrentIndex + offset) & (WINDOW_SIZE - 1)]; }
+
+public:
+    explicit TokenStream(const Utils::SourceBuffer& source);
+
+    /// @brief Text of a token produced by this stream
+    std::string_view text(const LexItem& item) const { return item.text(mInput); }
+
+    /// @brief Value decoded by the lexer for a Constant token, the token must still be within the lookahead window
+    uint64_t constantValue(const LexItem& item) const {
+        for (size_t slot = 0; slot < WINDOW_SIZE; ++slot) {
+            if (mWindow[slot].mOffset == item.mOffset && mWindow[slot].mLexType == LexType::Constant)
+                return mConstantValues[slot];
+        }
+        throw std::invalid_argument("constantValue called on a token which is not a Constant in the lookahead window");
+    }
+
+    /// @brief Line and column of a token produced by this stream
+    SourceLocation location(const LexItem& item) { return mLineTable.locate(item.mOffset); }
+
+    bool hasCurrent() { return fill(0); }
+
+    /// @brief Get the current LexItem
+    LexItem current() {
+        if (!fill(0)) throw std::out_of_range("No more tokens");
+        return at(0);
+    }
+
+    /// @brief Get the current LexItem and move to the next one
+    LexItem consume() {
+        LexItem item = current();
+        ++mCurrentIndex;
+        return item;
+    }
+
+    LexItem next() {
+        if (!fill(1)) throw std::out_of_range("No next token");
+        return at(1);
+    }
+
+    LexItem peekAtOffset(int32_t n) {
+        if (n < 0 || static_cast<size_t>(n) >= WINDOW_SIZE || !fill(n))
+            throw std::out_of_range("No more tokens");
+        return at(n);
+    }
+
+    /// @brief Move to the next token.
+    void advance() {
+        ++mCurrentIndex;
+    }
+
+    /// @brief Drain the stream, printing every remaining token
+    void print(std::ostream& os = std::cout) {
         size_t i = 0;
-        for (const auto& item : mLexVector) {
+        while (hasCurrent()) {
+            LexItem item = consume();
             os << i << ": " << lex_type_to_str(item.mLexType);
             if (item.mLexType == LexType::Identifier)
-                std::cout << ": " << item.mSV << std::endl;
+                os << ": " << text(item) << std::endl;
             else
-                std::cout << std::endl;
+                os << std::endl;
             ++i;
         }
     }
@@ -396,6 +695,11 @@ public:
 
 // ------------------------------> Function Prototypes <------------------------------
 
-LexList lexer(std::string_view preprocessed_input);
+/// Lex the next token starting at pos, skipping leading whitespace. Returns false at the end of input.
+/// The value of Constant tokens is written to constantValue.
+/// The scan kernels read past the end of the input, which is why only padded Utils::SourceBuffers are accepted.
+bool lexNextToken(const Utils::SourceBuffer& source, size_t& pos, LexItem& item, uint64_t& constantValue);
+
+LexList lexer(const Utils::SourceBuffer& source);
 
 }
\ No newline at end of file
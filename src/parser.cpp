@@ -4,6 +4,7 @@
 #include <ctre.hpp>
 #include <stdexcept>
 #include <format>
+#include <limits>
 #include "lexer.hpp"
 #include "ast/ast_c.hpp"
 #include "parser.hpp"
@@ -63,60 +64,67 @@ inline constexpr ast::c::BinaryOperator lextype_to_binary_op(lexer::LexType unop
     throw std::runtime_error("lextype_to_binary_op received an invalid lexer::LexType");
 }
 
+// ------------------------------> describeToken <------------------------------
+
+static std::string describeToken(const lexer::LexItem& item, lexer::TokenStream& tokens) {
+    auto location = tokens.location(item);
+    return std::format("{} (line {}, column {})", tokens.text(item), location.mLine, location.mColumn);
+}
+
 // ------------------------------> expect <------------------------------
 
-const lexer::LexItem& expectAndAdvance(lexer::LexType expectedLexType, lexer::LexList& lexList) {
-    const lexer::LexItem& actual = lexList.consume();
+lexer::LexItem expectAndAdvance(lexer::LexType expectedLexType, lexer::TokenStream& tokens) {
+    lexer::LexItem actual = tokens.consume();
     if (actual.mLexType != expectedLexType) {
-        auto errorString = std::format("Expected: {}, got {}", lex_type_to_str(expectedLexType), actual.mSV);
+        auto errorString = std::format("Expected: {}, got {}", lex_type_to_str(expectedLexType), describeToken(actual, tokens));
         throw std::runtime_error(errorString);
     }
     return actual;
 }
 
-const lexer::LexItem& expectNoAdvance(lexer::LexType expectedLexType, lexer::LexList& lexList) {
-    const lexer::LexItem& actual = lexList.current();
+lexer::LexItem expectNoAdvance(lexer::LexType expectedLexType, lexer::TokenStream& tokens) {
+    lexer::LexItem actual = tokens.current();
     if (actual.mLexType != expectedLexType) {
-        auto errorString = std::format("Expected: {}, got {}", lex_type_to_str(expectedLexType), actual.mSV);
+        auto errorString = std::format("Expected: {}, got {}", lex_type_to_str(expectedLexType), describeToken(actual, tokens));
         throw std::runtime_error(errorString);
     }
     return actual;
 }
 
 // forward declarations
-static ast::c::Expression parseExpression(lexer::LexList& lexList, uint32_t minPrecedence=0);
-static ast::c::VarDecl parseVariableDeclaration(lexer::LexList& lexList);
+static ast::c::Expression parseExpression(lexer::TokenStream& tokens, ast::Arena& arena, uint32_t minPrecedence=0);
+static ast::c::VarDecl parseVariableDeclaration(lexer::TokenStream& tokens, ast::Arena& arena);
 
 // ------------------------------> parseArgumentList <------------------------------
 
-std::vector<std::unique_ptr<ast::c::Expression>> parseArgumentList(lexer::LexList& lexList, lexer::LexType terminator = lexer::LexType::Close_Parenthesis) {
-    std::vector<std::unique_ptr<ast::c::Expression>> args;
-    if (lexList.current().mLexType == terminator) return args; // no params
+std::span<ast::c::Expression*> parseArgumentList(lexer::TokenStream& tokens, ast::Arena& arena, lexer::LexType terminator = lexer::LexType::Close_Parenthesis) {
+    std::vector<ast::c::Expression*> args;
+    if (tokens.current().mLexType == terminator) return {}; // no params
     while (true) {
-        args.emplace_back(std::make_unique<ast::c::Expression>(parseExpression(lexList)));
-        if (lexList.current().mLexType != lexer::LexType::Comma) break;
-        lexList.advance();
+        args.emplace_back(arena.make<ast::c::Expression>(parseExpression(tokens, arena)));
+        if (tokens.current().mLexType != lexer::LexType::Comma) break;
+        tokens.advance();
     }
-    return args;
+    return arena.makeArray(args);
 }
 
 // ------------------------------> parseParamList <------------------------------
 
-static std::vector<std::string> parseParamList(lexer::LexList& lexList) {
-    std::vector<std::string> params;
+static std::vector<ast::SymbolId> parseParamList(lexer::TokenStream& tokens) {
+    std::vector<ast::SymbolId> params;
 
-    if (lexList.current().mLexType == lexer::LexType::Void) {
-        lexList.advance();
+    if (tokens.current().mLexType == lexer::LexType::Void) {
+        tokens.advance();
         return params;
     }
 
     while(true) {
-        expectAndAdvance(lexer::LexType::Int, lexList);
-        auto lexIdentifier = expectAndAdvance(lexer::LexType::Identifier, lexList);
-        params.emplace_back(std::string(lexIdentifier.mSV));
+        expectAndAdvance(lexer::LexType::Int, tokens);
+        auto lexIdentifier = expectAndAdvance(lexer::LexType::Identifier, tokens);
+        params.emplace_back(ast::intern(tokens.text(lexIdentifier)));
 
-        if (lexList.current().mLexType == lexer::LexType::Comma) {
-            lexList.advance();
+        if (tokens.current().mLexType == lexer::LexType::Comma) {
+            tokens.advance();
             continue;
         }
         // If there's no comma then break out of the loop
@@ -128,42 +136,46 @@ static std::vector<std::string> parseParamList(lexer::LexList& lexList) {
 
 // ------------------------------> parseFactor <------------------------------
 
-static ast::c::Expression parseFactor(lexer::LexList& lexList) {
-    const lexer::LexItem& currentToken = lexList.consume();
+static ast::c::Expression parseFactor(lexer::TokenStream& tokens, ast::Arena& arena) {
+    lexer::LexItem currentToken = tokens.consume();
 
     ast::c::Expression expression = ast::c::Constant(0);
 
     // Constant
-    if (currentToken.mLexType == lexer::LexType::Constant)
-        return ast::c::Constant(std::stoi(std::string(currentToken.mSV)));
+    if (currentToken.mLexType == lexer::LexType::Constant) {
+        uint64_t value = tokens.constantValue(currentToken);
+        if (value > static_cast<uint64_t>(std::numeric_limits<int>::max()))
+            throw std::runtime_error(std::format("Integer constant {} is too large for an int", describeToken(currentToken, tokens)));
+        return ast::c::Constant(static_cast<int>(value));
+    }
 
     // Unary Op
     else if (lexer::is_lextype_unary_op(currentToken.mLexType)) {
-        auto factor = std::make_unique<ast::c::Expression>(parseFactor(lexList));
-        expression = ast::c::Unary(lextype_to_unary_op(currentToken.mLexType), std::move(factor));
+        auto factor = arena.make<ast::c::Expression>(parseFactor(tokens, arena));
+        expression = ast::c::Unary(lextype_to_unary_op(currentToken.mLexType), factor);
     }
 
     // Open parenthesis
     else if (currentToken.mLexType == lexer::LexType::Open_Parenthesis) {
-        auto innerExpression = parseExpression(lexList);
-        expectAndAdvance(lexer::LexType::Close_Parenthesis, lexList);
+        auto innerExpression = parseExpression(tokens, arena);
+        expectAndAdvance(lexer::LexType::Close_Parenthesis, tokens);
         expression = std::move(innerExpression);
     }
 
     // Function Call
     else if ((currentToken.mLexType == lexer::LexType::Identifier) && 
-             (lexList.current().mLexType == lexer::LexType::Open_Parenthesis) // current lexList iterator was advanced with consume
+             (tokens.current().mLexType == lexer::LexType::Open_Parenthesis) // current token was advanced with consume
     ){
-        std::string identifier(currentToken.mSV);
-        lexList.advance(); // advance past open parentheses
-        auto argList = parseArgumentList(lexList);
-        expectAndAdvance(lexer::LexType::Close_Parenthesis, lexList);
-        return ast::c::FunctionCall(identifier, std::move(argList));
+        ast::SymbolId identifier = ast::intern(tokens.text(currentToken));
+        tokens.advance(); // advance past open parentheses
+        auto argList = parseArgumentList(tokens, arena);
+        expectAndAdvance(lexer::LexType::Close_Parenthesis, tokens);
+        return ast::c::FunctionCall(identifier, argList);
     }
 
     // Variable
     else if (currentToken.mLexType == lexer::LexType::Identifier) {
-        expression = ast::c::Variable(std::string(currentToken.mSV));
+        expression = ast::c::Variable(ast::intern(tokens.text(currentToken)));
     }
 
     // Crement
@@ -171,27 +183,27 @@ static ast::c::Expression parseFactor(lexer::LexList& lexList) {
             || (currentToken.mLexType == lexer::LexType::Decrement)
     ) {
         expression = ast::c::Crement(
-            std::make_unique<ast::c::Expression>(parseFactor(lexList)),
+            arena.make<ast::c::Expression>(parseFactor(tokens, arena)),
             (currentToken.mLexType == lexer::LexType::Increment),
             false // Post always false as the crement operator was found before the factor
         );
     }
 
     else {
-        std::string errorString = std::format("Malformed factor, got: {}", currentToken.mSV);
+        std::string errorString = std::format("Malformed factor, got: {}", describeToken(currentToken, tokens));
         throw std::runtime_error(errorString);
     }
 
     // Check for post increment/decrement
-    if (lexList.current().mLexType == lexer::LexType::Increment ||
-        lexList.current().mLexType == lexer::LexType::Decrement
+    if (tokens.current().mLexType == lexer::LexType::Increment ||
+        tokens.current().mLexType == lexer::LexType::Decrement
     ) {
         expression = ast::c::Crement(
-            std::make_unique<ast::c::Expression>(std::move(expression)),
-            (lexList.current().mLexType == lexer::LexType::Increment),
+            arena.make<ast::c::Expression>(std::move(expression)),
+            (tokens.current().mLexType == lexer::LexType::Increment),
             true // Post always true as the crement operator was found after the factor
         );
-        lexList.advance();
+        tokens.advance();
     }
 
     return expression;
@@ -199,60 +211,60 @@ static ast::c::Expression parseFactor(lexer::LexList& lexList) {
 
 // ------------------------------> parseExpression <------------------------------
 
-static ast::c::Expression parseExpression(lexer::LexList& lexList, uint32_t minPrecedence) {
-    auto expression = parseFactor(lexList);
-    const lexer::LexItem* currentToken = &lexList.current();
+static ast::c::Expression parseExpression(lexer::TokenStream& tokens, ast::Arena& arena, uint32_t minPrecedence) {
+    auto expression = parseFactor(tokens, arena);
+    lexer::LexItem currentToken = tokens.current();
 
     // Check if operator is a binary op and is above minimum precendence level
-    while (lexer::is_lextype_binary_op(currentToken->mLexType)
-        && lexer::binary_op_precedence(currentToken->mLexType) >= minPrecedence) {
+    while (lexer::is_lextype_binary_op(currentToken.mLexType)
+        && lexer::binary_op_precedence(currentToken.mLexType) >= minPrecedence) {
 
-        lexList.advance();
+        tokens.advance();
         
         // Assignment type operator
-        if (lexer::is_assignment(currentToken->mLexType)) {
-            auto right = std::make_unique<ast::c::Expression>(
-                parseExpression(lexList, lexer::binary_op_precedence(lexer::LexType::Assignment)));
+        if (lexer::is_assignment(currentToken.mLexType)) {
+            auto right = arena.make<ast::c::Expression>(
+                parseExpression(tokens, arena, lexer::binary_op_precedence(lexer::LexType::Assignment)));
             
             // Regular assignment
-            if (currentToken->mLexType == lexer::LexType::Assignment)
+            if (currentToken.mLexType == lexer::LexType::Assignment)
                 expression = ast::c::Assignment(
-                    std::make_unique<ast::c::Expression>(std::move(expression)), 
-                    std::move(right));
+                    arena.make<ast::c::Expression>(std::move(expression)), 
+                    right);
             // Compound assignment, right side is a binary expression
             else {
-                auto op = lextype_to_binary_op(currentToken->mLexType);
-                ast::c::Expression copiedExpr = std::visit(ast::c::CopyVisitor{}, expression);
+                auto op = lextype_to_binary_op(currentToken.mLexType);
+                ast::c::Expression copiedExpr = std::visit(ast::c::CopyVisitor{arena}, expression);
                 expression = ast::c::Assignment(
-                    std::make_unique<ast::c::Expression>(std::move(copiedExpr)),
-                    std::make_unique<ast::c::Expression>(
+                    arena.make<ast::c::Expression>(std::move(copiedExpr)),
+                    arena.make<ast::c::Expression>(
                         ast::c::Binary(
                             op,
-                            std::make_unique<ast::c::Expression>(std::move(expression)),  
-                            std::move(right))));
+                            arena.make<ast::c::Expression>(std::move(expression)),  
+                            right)));
             }
         }
         // Conditional expression
-        else if (currentToken->mLexType == lexer::LexType::Question_Mark) {
-            auto middleExpr = std::make_unique<ast::c::Expression>(parseExpression(lexList));
-            expectAndAdvance(lexer::LexType::Colon, lexList);
-            auto rightExpr = std::make_unique<ast::c::Expression>(
-                parseExpression(lexList, lexer::binary_op_precedence(currentToken->mLexType))
+        else if (currentToken.mLexType == lexer::LexType::Question_Mark) {
+            auto middleExpr = arena.make<ast::c::Expression>(parseExpression(tokens, arena));
+            expectAndAdvance(lexer::LexType::Colon, tokens);
+            auto rightExpr = arena.make<ast::c::Expression>(
+                parseExpression(tokens, arena, lexer::binary_op_precedence(currentToken.mLexType))
             );
             expression = ast::c::Conditional(
-                std::make_unique<ast::c::Expression>(std::move(expression)),
-                std::move(middleExpr),
-                std::move(rightExpr)
+                arena.make<ast::c::Expression>(std::move(expression)),
+                middleExpr,
+                rightExpr
             );
         }
         // Regular binary op
         else {
-            auto op = lextype_to_binary_op(currentToken->mLexType);
-            auto right = std::make_unique<ast::c::Expression>(parseExpression(lexList, lexer::binary_op_precedence(currentToken->mLexType)+1));
-            expression = ast::c::Binary(op, std::make_unique<ast::c::Expression>(std::move(expression)), 
-                                      std::move(right));
+            auto op = lextype_to_binary_op(currentToken.mLexType);
+            auto right = arena.make<ast::c::Expression>(parseExpression(tokens, arena, lexer::binary_op_precedence(currentToken.mLexType)+1));
+            expression = ast::c::Binary(op, arena.make<ast::c::Expression>(std::move(expression)), 
+                                      right);
         }
-        currentToken = &lexList.current();
+        currentToken = tokens.current();
     }
 
     return expression;
@@ -260,45 +272,45 @@ static ast::c::Expression parseExpression(lexer::LexList& lexList, uint32_t minP
 
 // ------------------------------> parseOptionalExpression <------------------------------
 
-static std::optional<ast::c::Expression> parseOptionalExpression(lexer::LexType endingToken, lexer::LexList& lexList) {
-    if (lexList.current().mLexType == endingToken) {
-        lexList.advance();
+static std::optional<ast::c::Expression> parseOptionalExpression(lexer::LexType endingToken, lexer::TokenStream& tokens, ast::Arena& arena) {
+    if (tokens.current().mLexType == endingToken) {
+        tokens.advance();
         return std::nullopt;
     }
 
-    auto expression = parseExpression(lexList);
-    expectAndAdvance(endingToken, lexList);
+    auto expression = parseExpression(tokens, arena);
+    expectAndAdvance(endingToken, tokens);
     return expression;
 }
 
 // ------------------------------> parseStatement <------------------------------
 
 // forward declaration
-static ast::c::Block parseBlock(lexer::LexList& lexList);
+static ast::c::Block parseBlock(lexer::TokenStream& tokens, ast::Arena& arena);
 
-static ast::c::Statement parseStatement(lexer::LexList& lexList) {
-    auto currentToken = lexList.current();
+static ast::c::Statement parseStatement(lexer::TokenStream& tokens, ast::Arena& arena) {
+    auto currentToken = tokens.current();
 
     // Return Statement
     if (currentToken.mLexType == lexer::LexType::Return) {
-        lexList.advance();
-        auto returnObject = ast::c::Return(parseExpression(lexList));
-        expectAndAdvance(lexer::LexType::Semicolon, lexList);
+        tokens.advance();
+        auto returnObject = ast::c::Return(parseExpression(tokens, arena));
+        expectAndAdvance(lexer::LexType::Semicolon, tokens);
         return returnObject;
     }
     // If Statement
     else if (currentToken.mLexType == lexer::LexType::If) {
         std::optional<std::unique_ptr<ast::c::Statement>> elseStmt = std::nullopt;
 
-        lexList.advance();
-        expectAndAdvance(lexer::LexType::Open_Parenthesis, lexList);
-        auto condition = parseExpression(lexList);
-        expectAndAdvance(lexer::LexType::Close_Parenthesis, lexList);
-        auto then = std::make_unique<ast::c::Statement>(parseStatement(lexList));
+        tokens.advance();
+        expectAndAdvance(lexer::LexType::Open_Parenthesis, tokens);
+        auto condition = parseExpression(tokens, arena);
+        expectAndAdvance(lexer::LexType::Close_Parenthesis, tokens);
+        auto then = std::make_unique<ast::c::Statement>(parseStatement(tokens, arena));
 
-        if (lexList.current().mLexType == lexer::LexType::Else) {
-            lexList.advance();
-            elseStmt = std::make_unique<ast::c::Statement>(parseStatement(lexList));
+        if (tokens.current().mLexType == lexer::LexType::Else) {
+            tokens.advance();
+            elseStmt = std::make_unique<ast::c::Statement>(parseStatement(tokens, arena));
         };
 
         return ast::c::If(
@@ -309,120 +321,120 @@ static ast::c::Statement parseStatement(lexer::LexList& lexList) {
     }
     // goto Statement
     else if (currentToken.mLexType == lexer::LexType::Go_To) {
-        lexList.advance();
-        auto target = expectAndAdvance(lexer::LexType::Identifier, lexList);
-        expectAndAdvance(lexer::LexType::Semicolon, lexList);
-        return ast::c::GoTo(std::string(target.mSV));
+        tokens.advance();
+        auto target = expectAndAdvance(lexer::LexType::Identifier, tokens);
+        expectAndAdvance(lexer::LexType::Semicolon, tokens);
+        return ast::c::GoTo(ast::intern(tokens.text(target)));
     }
     // Labelled Statement
     else if (currentToken.mLexType == lexer::LexType::Identifier &&
-             lexList.next().mLexType == lexer::LexType::Colon
+             tokens.next().mLexType == lexer::LexType::Colon
     ) {
-        std::string label(currentToken.mSV);
-        lexList.advance();
-        lexList.advance();
-        auto statement = std::make_unique<ast::c::Statement>(parseStatement(lexList));
+        ast::SymbolId label = ast::intern(tokens.text(currentToken));
+        tokens.advance();
+        tokens.advance();
+        auto statement = std::make_unique<ast::c::Statement>(parseStatement(tokens, arena));
         return ast::c::LabelledStatement(
-            std::move(label),
+            label,
             std::move(statement)
         );
     }
     // Compound Statment
     else if (currentToken.mLexType == lexer::LexType::Open_Brace) {
-        return ast::c::CompoundStatement(std::make_unique<ast::c::Block>(parseBlock(lexList)));
+        return ast::c::CompoundStatement(std::make_unique<ast::c::Block>(parseBlock(tokens, arena)));
     }
     // Break Statement
     else if (currentToken.mLexType == lexer::LexType::Break) {
-        lexList.advance();
-        expectAndAdvance(lexer::LexType::Semicolon, lexList);
+        tokens.advance();
+        expectAndAdvance(lexer::LexType::Semicolon, tokens);
         return ast::c::Break();
     }
     // Continue statement
     else if (currentToken.mLexType == lexer::LexType::Continue) {
-        lexList.advance();
-        expectAndAdvance(lexer::LexType::Semicolon, lexList);
+        tokens.advance();
+        expectAndAdvance(lexer::LexType::Semicolon, tokens);
         return ast::c::Continue();
     }
     // While Loop
     else if (currentToken.mLexType == lexer::LexType::While) {
-        lexList.advance();
+        tokens.advance();
         // Get condition expression
-        expectAndAdvance(lexer::LexType::Open_Parenthesis, lexList);
-        ast::c::Expression condition = parseExpression(lexList);
-        expectAndAdvance(lexer::LexType::Close_Parenthesis, lexList);
+        expectAndAdvance(lexer::LexType::Open_Parenthesis, tokens);
+        ast::c::Expression condition = parseExpression(tokens, arena);
+        expectAndAdvance(lexer::LexType::Close_Parenthesis, tokens);
         // Get statement
-        auto body = std::make_unique<ast::c::Statement>(parseStatement(lexList));
+        auto body = std::make_unique<ast::c::Statement>(parseStatement(tokens, arena));
 
         return ast::c::While(std::move(condition), std::move(body));
     }
     // DoWhile loop
     else if (currentToken.mLexType == lexer::LexType::Do) {
-        lexList.advance();
-        auto body = std::make_unique<ast::c::Statement>(parseStatement(lexList));
-        expectAndAdvance(lexer::LexType::While, lexList);
-        expectAndAdvance(lexer::LexType::Open_Parenthesis, lexList);
-        ast::c::Expression condition = parseExpression(lexList);
-        expectAndAdvance(lexer::LexType::Close_Parenthesis, lexList);
-        expectAndAdvance(lexer::LexType::Semicolon, lexList);
+        tokens.advance();
+        auto body = std::make_unique<ast::c::Statement>(parseStatement(tokens, arena));
+        expectAndAdvance(lexer::LexType::While, tokens);
+        expectAndAdvance(lexer::LexType::Open_Parenthesis, tokens);
+        ast::c::Expression condition = parseExpression(tokens, arena);
+        expectAndAdvance(lexer::LexType::Close_Parenthesis, tokens);
+        expectAndAdvance(lexer::LexType::Semicolon, tokens);
 
         return ast::c::DoWhile(std::move(body), std::move(condition));
     }
     // For loop
     else if (currentToken.mLexType == lexer::LexType::For) {
-        lexList.advance();
-        expectAndAdvance(lexer::LexType::Open_Parenthesis, lexList);
+        tokens.advance();
+        expectAndAdvance(lexer::LexType::Open_Parenthesis, tokens);
 
         // For init
         ast::c::ForInit forInit = std::nullopt;
 
         // check for declaration
-        if (lexList.current().mLexType == lexer::LexType::Int)
-            forInit = parseVariableDeclaration(lexList);
+        if (tokens.current().mLexType == lexer::LexType::Int)
+            forInit = parseVariableDeclaration(tokens, arena);
         else
-            forInit = parseOptionalExpression(lexer::LexType::Semicolon, lexList);
+            forInit = parseOptionalExpression(lexer::LexType::Semicolon, tokens, arena);
         
-        auto condition = parseOptionalExpression(lexer::LexType::Semicolon, lexList);
+        auto condition = parseOptionalExpression(lexer::LexType::Semicolon, tokens, arena);
 
-        auto postExpression = parseOptionalExpression(lexer::LexType::Close_Parenthesis, lexList);
+        auto postExpression = parseOptionalExpression(lexer::LexType::Close_Parenthesis, tokens, arena);
 
-        auto statement = std::make_unique<ast::c::Statement>(parseStatement(lexList));
+        auto statement = std::make_unique<ast::c::Statement>(parseStatement(tokens, arena));
 
         return ast::c::For(std::move(forInit), std::move(condition), std::move(postExpression), std::move(statement));
     }
     // Switch statement
     else if (currentToken.mLexType == lexer::LexType::Switch) {
-        lexList.advance();
-        expectAndAdvance(lexer::LexType::Open_Parenthesis, lexList);
-        ast::c::Expression selector = parseExpression(lexList);
-        expectAndAdvance(lexer::LexType::Close_Parenthesis, lexList);
-        auto body = std::make_unique<ast::c::Statement>(parseStatement(lexList));
+        tokens.advance();
+        expectAndAdvance(lexer::LexType::Open_Parenthesis, tokens);
+        ast::c::Expression selector = parseExpression(tokens, arena);
+        expectAndAdvance(lexer::LexType::Close_Parenthesis, tokens);
+        auto body = std::make_unique<ast::c::Statement>(parseStatement(tokens, arena));
         
         return ast::c::Switch(std::move(selector), std::move(body));
     }
     // Case statement
     else if (currentToken.mLexType == lexer::LexType::Case) {
-        lexList.advance();
-        auto condition = parseExpression(lexList);
-        expectAndAdvance(lexer::LexType::Colon, lexList);
-        auto stmt = std::make_unique<ast::c::Statement>(parseStatement(lexList));
+        tokens.advance();
+        auto condition = parseExpression(tokens, arena);
+        expectAndAdvance(lexer::LexType::Colon, tokens);
+        auto stmt = std::make_unique<ast::c::Statement>(parseStatement(tokens, arena));
         return ast::c::Case(std::move(condition), std::move(stmt));
     }
     // Default statement
     else if (currentToken.mLexType == lexer::LexType::Default) {
-        lexList.advance();
-        expectAndAdvance(lexer::LexType::Colon, lexList);
-        auto stmt = std::make_unique<ast::c::Statement>(parseStatement(lexList));
+        tokens.advance();
+        expectAndAdvance(lexer::LexType::Colon, tokens);
+        auto stmt = std::make_unique<ast::c::Statement>(parseStatement(tokens, arena));
         return ast::c::Default(std::move(stmt));
     }
     // Null Statement
     else if (currentToken.mLexType == lexer::LexType::Semicolon) {
-        lexList.advance();
+        tokens.advance();
         return ast::c::NullStatement();
     }
     // Expression Statement
     else {
-        ast::c::ExpressionStatement es(parseExpression(lexList));
-        expectAndAdvance(lexer::LexType::Semicolon, lexList);
+        ast::c::ExpressionStatement es(parseExpression(tokens, arena));
+        expectAndAdvance(lexer::LexType::Semicolon, tokens);
         return es;
     }
 
@@ -431,104 +443,105 @@ static ast::c::Statement parseStatement(lexer::LexList& lexList) {
 }
 
 // ------------------------------> parseBlockItem <------------------------------
-static ast::c::Declaration parseDeclaration(lexer::LexList& lexList);
+static ast::c::Declaration parseDeclaration(lexer::TokenStream& tokens, ast::Arena& arena);
 
-static ast::c::BlockItem parseBlockItem(lexer::LexList& lexList) {
-    const lexer::LexItem* currentToken = &lexList.current();
+static ast::c::BlockItem parseBlockItem(lexer::TokenStream& tokens, ast::Arena& arena) {
+    lexer::LexItem currentToken = tokens.current();
 
     // Declaration
-    if (currentToken->mLexType == lexer::LexType::Int) {
-        return parseDeclaration(lexList);
+    if (currentToken.mLexType == lexer::LexType::Int) {
+        return parseDeclaration(tokens, arena);
     }
-    else return parseStatement(lexList);
+    else return parseStatement(tokens, arena);
 }
 
 // ------------------------------> parseBlock <------------------------------
 
-static ast::c::Block parseBlock(lexer::LexList& lexList) {
+static ast::c::Block parseBlock(lexer::TokenStream& tokens, ast::Arena& arena) {
     // Opening brace
-    expectAndAdvance(lexer::LexType::Open_Brace, lexList);
+    expectAndAdvance(lexer::LexType::Open_Brace, tokens);
 
     std::vector<ast::c::BlockItem> blockItems;
-    while (lexList.current().mLexType != lexer::LexType::Close_Brace) {
-        auto nextBlockItem = parseBlockItem(lexList);
+    while (tokens.current().mLexType != lexer::LexType::Close_Brace) {
+        auto nextBlockItem = parseBlockItem(tokens, arena);
         blockItems.push_back(std::move(nextBlockItem));
     }
     
     // We've seen the closing brace, move forward
-    lexList.advance();
+    tokens.advance();
     return ast::c::Block(std::move(blockItems));
 }
 
 // ------------------------------> parseDeclaration <------------------------------
 
-static ast::c::VarDecl parseVariableDeclaration(lexer::LexList& lexList);
-static ast::c::FuncDecl parseFunctionDeclaration(lexer::LexList& lexList);
+static ast::c::VarDecl parseVariableDeclaration(lexer::TokenStream& tokens, ast::Arena& arena);
+static ast::c::FuncDecl parseFunctionDeclaration(lexer::TokenStream& tokens, ast::Arena& arena);
 
-static ast::c::Declaration parseDeclaration(lexer::LexList& lexList) {
-    if (lexList.peekAtOffset(2).mLexType == lexer::LexType::Open_Parenthesis)
-        return parseFunctionDeclaration(lexList);
+static ast::c::Declaration parseDeclaration(lexer::TokenStream& tokens, ast::Arena& arena) {
+    if (tokens.peekAtOffset(2).mLexType == lexer::LexType::Open_Parenthesis)
+        return parseFunctionDeclaration(tokens, arena);
     else
-        return parseVariableDeclaration(lexList);
+        return parseVariableDeclaration(tokens, arena);
 }
 
 // ------------------------------> parseVariableDeclaration <------------------------------
 
-static ast::c::VarDecl parseVariableDeclaration(lexer::LexList& lexList) {
-    expectAndAdvance(lexer::LexType::Int, lexList);
-    std::string identifier(expectAndAdvance(lexer::LexType::Identifier, lexList).mSV);
-    const auto& currentToken = lexList.current();
-    lexList.advance();
+static ast::c::VarDecl parseVariableDeclaration(lexer::TokenStream& tokens, ast::Arena& arena) {
+    expectAndAdvance(lexer::LexType::Int, tokens);
+    ast::SymbolId identifier = ast::intern(tokens.text(expectAndAdvance(lexer::LexType::Identifier, tokens)));
+    auto currentToken = tokens.current();
+    tokens.advance();
 
     if (currentToken.mLexType == lexer::LexType::Assignment) {
-        ast::c::Expression expression = parseExpression(lexList);
-        expectAndAdvance(lexer::LexType::Semicolon, lexList);
-        return ast::c::VarDecl(std::move(identifier), std::move(expression));
+        ast::c::Expression expression = parseExpression(tokens, arena);
+        expectAndAdvance(lexer::LexType::Semicolon, tokens);
+        return ast::c::VarDecl(identifier, std::move(expression));
     }
     else if (currentToken.mLexType == lexer::LexType::Semicolon) {
-        return ast::c::VarDecl(std::move(identifier));
+        return ast::c::VarDecl(identifier);
     }
     else {
-        throw std::runtime_error(std::format("Invalid variable declaration, got {}", std::string(currentToken.mSV)));
+        throw std::runtime_error(std::format("Invalid variable declaration, got {}", describeToken(currentToken, tokens)));
     }
 }
 
 // ------------------------------> parseFunctionDeclaration <------------------------------
 
-static ast::c::FuncDecl parseFunctionDeclaration(lexer::LexList& lexList) {
+static ast::c::FuncDecl parseFunctionDeclaration(lexer::TokenStream& tokens, ast::Arena& arena) {
     // Check for keyword void
-    expectAndAdvance(lexer::LexType::Int, lexList);
+    expectAndAdvance(lexer::LexType::Int, tokens);
 
     // Check for identifier (should be main but we'll pay no attention for now)
-    auto lexIdentifier = expectAndAdvance(lexer::LexType::Identifier, lexList);
+    auto lexIdentifier = expectAndAdvance(lexer::LexType::Identifier, tokens);
 
     // Check for parameter list
-    expectAndAdvance(lexer::LexType::Open_Parenthesis, lexList);
+    expectAndAdvance(lexer::LexType::Open_Parenthesis, tokens);
 
     // parse list of parameters
-    auto paramList = parseParamList(lexList);
+    auto paramList = parseParamList(tokens);
 
-    expectAndAdvance(lexer::LexType::Close_Parenthesis, lexList);
+    expectAndAdvance(lexer::LexType::Close_Parenthesis, tokens);
 
     // parse definition if it exists
     std::unique_ptr<ast::c::Block> body = nullptr;
-    if (lexList.current().mLexType == lexer::LexType::Semicolon)
-        lexList.advance();
+    if (tokens.current().mLexType == lexer::LexType::Semicolon)
+        tokens.advance();
     else
-        body = std::make_unique<ast::c::Block>(parseBlock(lexList));
+        body = std::make_unique<ast::c::Block>(parseBlock(tokens, arena));
 
-    return ast::c::FuncDecl(std::string(lexIdentifier.mSV), std::move(paramList), std::move(body));
+    return ast::c::FuncDecl(ast::intern(tokens.text(lexIdentifier)), std::move(paramList), std::move(body));
 }
 
 // ------------------------------> parseProgram <------------------------------
 
-ast::c::Program parseProgram(lexer::LexList& lexList) {
+ast::c::Program parseProgram(lexer::TokenStream& tokens) {
     ast::c::Program returnedProgram;
+    ast::Arena& arena = *returnedProgram.mArena;
 
-    while (lexList.hasCurrent())
-        returnedProgram.addFuncDeclaration(parseFunctionDeclaration(lexList));
+    while (tokens.hasCurrent())
+        returnedProgram.addFuncDeclaration(parseFunctionDeclaration(tokens, arena));
 
-    if (lexList.hasCurrent())
+    if (tokens.hasCurrent())
         throw std::runtime_error("Program can only contain one top level function (for now)");
 
     return returnedProgram;
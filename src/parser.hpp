@@ -4,5 +4,5 @@
 #include "lexer.hpp"
 
 namespace compiler::parser {
-    ast::c::Program parseProgram(lexer::LexList& lexList);
+    ast::c::Program parseProgram(lexer::TokenStream& tokens);
 }
\ No newline at end of file
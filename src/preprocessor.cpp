@@ -0,0 +1,1472 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "preprocessor.hpp"
+#include "utils.h"
+
+namespace compiler::preprocessor {
+
+// ------------------------------> Tokens <------------------------------
+
+enum class TokenKind : uint8_t {
+    Identifier,
+    Number,
+    Character,
+    String,
+    Punctuator,
+    Other,          // Any other single character, e.g. a stray backslash or an unterminated quote
+    EndOfFile
+};
+
+/// Sorted names of the macros a token came out of, which may not expand it again
+using HideSet = std::vector<std::string_view>;
+
+struct Token {
+    std::string_view mText;
+    const HideSet* mHideSet = nullptr;  // Null for none
+    uint32_t mLine = 0;
+    TokenKind mKind = TokenKind::EndOfFile;
+    bool mLineStart = false;            // First token on its line
+    bool mSpaceBefore = false;
+    bool mExpanded = false;             // Produced by a macro expansion, so it never starts a directive
+
+    bool is(std::string_view text) const {
+        return mText == text && (mKind == TokenKind::Punctuator || mKind == TokenKind::Identifier);
+    }
+};
+
+static const Token END_OF_FILE{{}, nullptr, 0, TokenKind::EndOfFile, true};
+
+// ------------------------------> Tokenizer <------------------------------
+
+static constexpr bool is_identifier_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$';
+}
+
+static constexpr bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static constexpr bool is_identifier_char(char c) {
+    return is_identifier_start(c) || is_digit(c);
+}
+
+static constexpr bool is_horizontal_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+// Punctuators longer than one character, wouldMerge checks output against them
+static constexpr std::string_view MULTI_CHAR_PUNCTUATORS[] = {
+    "<<=", ">>=", "...", "->", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+    "*=", "/=", "%=", "+=", "-=", "&=", "^=", "|=", "##"
+};
+
+/// @brief Deletes backslash-newline pairs, recording where each one was in the result so the tokens after it can
+/// still be given their physical line
+static std::string remove_line_splices(std::string_view text, std::vector<uint32_t>& splices) {
+    std::string result;
+    result.reserve(text.size() + 1);
+
+    // Copy the runs between backslashes whole, splices are rare
+    size_t pos = 0;
+    for (size_t backslash = text.find('\\'); backslash != std::string_view::npos; backslash = text.find('\\', pos)) {
+        size_t next = backslash + 1;
+        if (next < text.size() && text[next] == '\r')
+            ++next;
+        if (next < text.size() && text[next] == '\n') {
+            result.append(text.substr(pos, backslash - pos));
+            splices.push_back(static_cast<uint32_t>(result.size()));
+            pos = next + 1;
+        }
+        else {
+            result.append(text.substr(pos, backslash + 1 - pos));
+            pos = backslash + 1;
+        }
+    }
+    result.append(text.substr(pos));
+
+    if (result.empty() || result.back() != '\n')
+        result.push_back('\n');
+    return result;
+}
+
+/// @brief Length of the punctuator at the start of text, 0 if there is none
+static size_t punctuator_length(std::string_view text) {
+    char c = text[0];
+    char next = text.size() > 1 ? text[1] : '\0';
+    char third = text.size() > 2 ? text[2] : '\0';
+    switch (c) {
+        case '<':
+        case '>':
+            if (next == c)
+                return third == '=' ? 3 : 2;
+            return next == '=' ? 2 : 1;
+        case '.':
+            return next == '.' && third == '.' ? 3 : 1;
+        case '-':
+            return next == '-' || next == '=' || next == '>' ? 2 : 1;
+        case '+':
+        case '&':
+        case '|':
+            return next == c || next == '=' ? 2 : 1;
+        case '#':
+            return next == '#' ? 2 : 1;
+        case '=':
+        case '!':
+        case '*':
+        case '/':
+        case '%':
+        case '^':
+            return next == '=' ? 2 : 1;
+        case '[': case ']': case '(': case ')': case '{': case '}':
+        case '~': case '?': case ':': case ';': case ',':
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/// @brief Splits text into preprocessing tokens, appending them and a final EndOfFile token to tokens. The tokens
+/// are views into text. Returns false instead of throwing on an unterminated comment.
+static bool tokenize(std::string_view text, std::vector<Token>& tokens, const std::vector<uint32_t>& splices = {}) {
+    size_t pos = 0;
+    uint32_t line = 1;
+    size_t splice = 0;
+    bool lineStart = true;
+    bool spaceBefore = false;
+
+    while (pos < text.size()) {
+        // Every splice passed moves on a physical line without ending the logical one
+        for (; splice < splices.size() && splices[splice] <= pos; ++splice)
+            ++line;
+
+        char c = text[pos];
+        char next = pos + 1 < text.size() ? text[pos + 1] : '\0';
+
+        if (c == '\n') {
+            ++line;
+            ++pos;
+            lineStart = true;
+            spaceBefore = false;
+            continue;
+        }
+        if (is_horizontal_space(c)) {
+            ++pos;
+            spaceBefore = true;
+            continue;
+        }
+        if (c == '/' && next == '/') {
+            pos = text.find('\n', pos);
+            if (pos == std::string_view::npos)
+                pos = text.size();
+            spaceBefore = true;
+            continue;
+        }
+        if (c == '/' && next == '*') {
+            size_t end = text.find("*/", pos + 2);
+            if (end == std::string_view::npos)
+                return false;
+            line += static_cast<uint32_t>(std::count(text.begin() + pos, text.begin() + end, '\n'));
+            pos = end + 2;
+            spaceBefore = true;
+            continue;
+        }
+
+        size_t start = pos;
+        TokenKind kind;
+
+        // Literals, with an optional L, u, U or u8 prefix
+        size_t quote = pos;
+        if (c == 'L' || c == 'U' || (c == 'u' && next != '8'))
+            quote = pos + 1;
+        else if (c == 'u' && next == '8')
+            quote = pos + 2;
+        size_t literalEnd = 0;
+        if (quote < text.size() && (text[quote] == '"' || text[quote] == '\'')) {
+            size_t end = quote + 1;
+            while (end < text.size() && text[end] != text[quote] && text[end] != '\n')
+                end += text[end] == '\\' ? 2 : 1;
+            if (end < text.size() && text[end] == text[quote])
+                literalEnd = end + 1;
+        }
+
+        if (literalEnd) {
+            kind = text[quote] == '"' ? TokenKind::String : TokenKind::Character;
+            pos = literalEnd;
+        }
+        else if (is_digit(c) || (c == '.' && is_digit(next))) {
+            // pp-number, which also covers suffixes, exponents and things like 1.2.3
+            kind = TokenKind::Number;
+            ++pos;
+            while (pos < text.size()) {
+                char d = text[pos];
+                if ((d == 'e' || d == 'E' || d == 'p' || d == 'P') && pos + 1 < text.size()
+                    && (text[pos + 1] == '+' || text[pos + 1] == '-'))
+                    pos += 2;
+                else if (is_identifier_char(d) || d == '.')
+                    ++pos;
+                else
+                    break;
+            }
+        }
+        else if (is_identifier_start(c)) {
+            kind = TokenKind::Identifier;
+            while (pos < text.size() && is_identifier_char(text[pos]))
+                ++pos;
+        }
+        else if (size_t length = punctuator_length(text.substr(pos))) {
+            kind = TokenKind::Punctuator;
+            pos += length;
+        }
+        else {
+            kind = TokenKind::Other;
+            ++pos;
+        }
+
+        tokens.push_back(Token{text.substr(start, pos - start), nullptr, line, kind, lineStart, spaceBefore});
+        lineStart = false;
+        spaceBefore = false;
+    }
+
+    Token end;
+    end.mLine = line + static_cast<uint32_t>(splices.size() - splice);
+    end.mLineStart = true;
+    tokens.push_back(end);
+    return true;
+}
+
+// ------------------------------> Source Files <------------------------------
+
+struct SourceFile {
+    std::string mPath;          // As written in __FILE__ and line markers
+    fs::path mDirectory;        // Searched first for "..." includes
+    std::string mContents;      // Without line splices, the tokens are views into it
+    std::vector<Token> mTokens;
+    std::string_view mGuard;    // Macro of an include guard wrapping the whole file, empty if there's none
+};
+
+static bool is_directive(const std::vector<Token>& tokens, size_t index) {
+    return tokens[index].mLineStart && tokens[index].is("#") && !tokens[index + 1].mLineStart;
+}
+
+/// @brief Finds the macro of an #ifndef X ... #endif wrapping the whole file. Including the file again while X is
+/// defined can't produce anything, so it can be skipped without being scanned.
+static std::string_view detect_include_guard(const std::vector<Token>& tokens) {
+    if (tokens.size() < 4 || !is_directive(tokens, 0) || !tokens[1].is("ifndef")
+        || tokens[2].mKind != TokenKind::Identifier || !tokens[3].mLineStart)
+        return {};
+
+    int depth = 0;
+    for (size_t i = 3; tokens[i].mKind != TokenKind::EndOfFile; ++i) {
+        if (!is_directive(tokens, i))
+            continue;
+        std::string_view name = tokens[i + 1].mText;
+        if (name == "if" || name == "ifdef" || name == "ifndef")
+            ++depth;
+        else if (depth == 0 && (name == "elif" || name == "else" || name == "elifdef" || name == "elifndef"))
+            return {};
+        else if (name == "endif" && depth-- == 0) {
+            size_t next = i + 2;
+            while (!tokens[next].mLineStart)
+                ++next;
+            return tokens[next].mKind == TokenKind::EndOfFile ? tokens[2].mText : std::string_view();
+        }
+    }
+    return {};
+}
+
+// ------------------------------> Macros <------------------------------
+
+enum class BuiltinMacro : uint8_t {
+    None,
+    File,
+    Line,
+    Counter
+};
+
+struct Macro {
+    std::vector<Token> mBody;
+    std::vector<std::string_view> mParameters;  // __VA_ARGS__ or the named variadic parameter is last
+    bool mFunctionLike = false;
+    bool mVariadic = false;
+    BuiltinMacro mBuiltin = BuiltinMacro::None;
+};
+
+static constexpr std::string_view PREDEFINED_MACROS =
+    "#define __STDC__ 1\n"
+    "#define __STDC_VERSION__ 201710L\n"
+    "#define __STDC_HOSTED__ 1\n"
+    "#define __x86_64__ 1\n"
+    "#define __x86_64 1\n"
+    "#define __amd64__ 1\n"
+    "#define __amd64 1\n"
+    "#define __linux__ 1\n"
+    "#define __linux 1\n"
+    "#define __unix__ 1\n"
+    "#define __unix 1\n"
+    "#define __ELF__ 1\n"
+    "#define __LP64__ 1\n"
+    "#define _LP64 1\n"
+    "#define __CHAR_BIT__ 8\n"
+    "#define __SIZEOF_SHORT__ 2\n"
+    "#define __SIZEOF_INT__ 4\n"
+    "#define __SIZEOF_LONG__ 8\n"
+    "#define __SIZEOF_LONG_LONG__ 8\n"
+    "#define __SIZEOF_POINTER__ 8\n"
+    "#define __SCHAR_MAX__ 0x7f\n"
+    "#define __SHRT_MAX__ 0x7fff\n"
+    "#define __INT_MAX__ 0x7fffffff\n"
+    "#define __LONG_MAX__ 0x7fffffffffffffffL\n"
+    "#define __LONG_LONG_MAX__ 0x7fffffffffffffffLL\n"
+    "#define __SIZE_TYPE__ long unsigned int\n"
+    "#define __PTRDIFF_TYPE__ long int\n"
+    "#define __WCHAR_TYPE__ int\n"
+    "#define __ORDER_LITTLE_ENDIAN__ 1234\n"
+    "#define __ORDER_BIG_ENDIAN__ 4321\n"
+    "#define __BYTE_ORDER__ __ORDER_LITTLE_ENDIAN__\n";
+
+// ------------------------------> Condition Evaluation <------------------------------
+// #if expressions after defined, __has_include and macros have been replaced. Operands are intmax_t, or uintmax_t
+// where C says so, and division by zero is only an error where the operand is actually evaluated.
+
+class ConditionEvaluator {
+private:
+    // Both types share the 64 bit pattern, mUnsigned picks how it is read
+    struct Value {
+        uint64_t mBits = 0;
+        bool mUnsigned = false;
+
+        static Value ofSigned(int64_t value) { return Value{static_cast<uint64_t>(value), false}; }
+        int64_t asSigned() const { return static_cast<int64_t>(mBits); }
+        explicit operator bool() const { return mBits != 0; }
+    };
+
+    const std::vector<Token>& mTokens;
+    const std::string& mLocation;
+    size_t mPos = 0;
+
+    [[noreturn]] void error(std::string_view message) const {
+        throw std::runtime_error(std::format("{}: {}", mLocation, message));
+    }
+
+    const Token& peek() const {
+        return mPos < mTokens.size() ? mTokens[mPos] : END_OF_FILE;
+    }
+
+    void expect(std::string_view text) {
+        if (!peek().is(text))
+            error(std::format("expected '{}' in preprocessor expression", text));
+        ++mPos;
+    }
+
+    Value number(std::string_view text) const {
+        bool isUnsigned = false;
+        while (!text.empty() && (text.back() == 'u' || text.back() == 'U' || text.back() == 'l' || text.back() == 'L')) {
+            isUnsigned |= text.back() == 'u' || text.back() == 'U';
+            text.remove_suffix(1);
+        }
+        int base = 10;
+        if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+            base = 16;
+            text.remove_prefix(2);
+        }
+        else if (text.size() > 2 && text[0] == '0' && (text[1] == 'b' || text[1] == 'B')) {
+            base = 2;
+            text.remove_prefix(2);
+        }
+        else if (text.size() > 1 && text[0] == '0')
+            base = 8;
+        uint64_t value = 0;
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+        if (ec != std::errc() || ptr != text.data() + text.size())
+            error(std::format("invalid integer constant '{}' in preprocessor expression", text));
+        // Constants too large for intmax_t are uintmax_t
+        return Value{value, isUnsigned || value > static_cast<uint64_t>(INT64_MAX)};
+    }
+
+    int64_t character(std::string_view text) const {
+        text = text.substr(text.find('\'') + 1);
+        text.remove_suffix(1);
+        if (text.empty())
+            error("empty character constant in preprocessor expression");
+        if (text[0] != '\\')
+            return static_cast<signed char>(text[0]);
+        switch (text.size() > 1 ? text[1] : '\0') {
+            case 'n':   return '\n';
+            case 't':   return '\t';
+            case 'r':   return '\r';
+            case 'a':   return '\a';
+            case 'b':   return '\b';
+            case 'f':   return '\f';
+            case 'v':   return '\v';
+            case 'e':   return 27;
+            case 'x': {
+                unsigned value = 0;
+                std::from_chars(text.data() + 2, text.data() + text.size(), value, 16);
+                return static_cast<signed char>(value);
+            }
+            default:
+                if (is_digit(text[1])) {
+                    unsigned value = 0;
+                    std::from_chars(text.data() + 1, text.data() + std::min<size_t>(text.size(), 4), value, 8);
+                    return static_cast<signed char>(value);
+                }
+                return text[1];
+        }
+    }
+
+    Value unary(bool live) {
+        const Token& token = peek();
+        ++mPos;
+        switch (token.mKind) {
+            case TokenKind::Number:     return number(token.mText);
+            case TokenKind::Character:  return Value::ofSigned(character(token.mText));
+            case TokenKind::Identifier: return Value::ofSigned(0);  // Identifiers left after expansion are 0
+            default:                    break;
+        }
+        if (token.is("(")) {
+            Value value = comma(live);
+            expect(")");
+            return value;
+        }
+        if (token.is("+"))  return unary(live);
+        if (token.is("-"))  { Value value = unary(live); return Value{0 - value.mBits, value.mUnsigned}; }
+        if (token.is("~"))  { Value value = unary(live); return Value{~value.mBits, value.mUnsigned}; }
+        if (token.is("!"))  return Value::ofSigned(!unary(live));
+        if (token.mKind == TokenKind::EndOfFile)
+            error("missing expression in preprocessor expression");
+        error(std::format("token '{}' is not valid in preprocessor expressions", token.mText));
+    }
+
+    static int precedence(const Token& token) {
+        if (token.mKind != TokenKind::Punctuator)
+            return -1;
+        std::string_view op = token.mText;
+        if (op == "*" || op == "/" || op == "%")    return 10;
+        if (op == "+" || op == "-")                 return 9;
+        if (op == "<<" || op == ">>")               return 8;
+        if (op == "<" || op == ">" || op == "<=" || op == ">=") return 7;
+        if (op == "==" || op == "!=")               return 6;
+        if (op == "&")                              return 5;
+        if (op == "^")                              return 4;
+        if (op == "|")                              return 3;
+        if (op == "&&")                             return 2;
+        if (op == "||")                             return 1;
+        return -1;
+    }
+
+    /// @brief lhs op rhs, after the usual arithmetic conversions where op calls for them
+    Value apply(std::string_view op, Value lhs, Value rhs, bool live) const {
+        // Shifts take the type of their left operand, logical operators and comparisons give an int
+        bool isUnsigned = lhs.mUnsigned || rhs.mUnsigned;
+        uint64_t a = lhs.mBits, b = rhs.mBits;
+        if (op == "*")      return Value{a * b, isUnsigned};
+        if (op == "+")      return Value{a + b, isUnsigned};
+        if (op == "-")      return Value{a - b, isUnsigned};
+        if (op == "&")      return Value{a & b, isUnsigned};
+        if (op == "^")      return Value{a ^ b, isUnsigned};
+        if (op == "|")      return Value{a | b, isUnsigned};
+        if (op == "/" || op == "%") {
+            if (b == 0) {
+                if (live)
+                    error("division by zero in preprocessor expression");
+                return Value{0, isUnsigned};
+            }
+            if (isUnsigned)
+                return Value{op == "/" ? a / b : a % b, true};
+            if (rhs.asSigned() == -1)
+                return Value{op == "/" ? 0 - a : 0, false};
+            return Value::ofSigned(op == "/" ? lhs.asSigned() / rhs.asSigned() : lhs.asSigned() % rhs.asSigned());
+        }
+        if (op == "<<")     return Value{a << (b & 63), lhs.mUnsigned};
+        if (op == ">>")
+            return lhs.mUnsigned ? Value{a >> (b & 63), true} : Value::ofSigned(lhs.asSigned() >> (b & 63));
+        if (op == "==")     return Value::ofSigned(a == b);
+        if (op == "!=")     return Value::ofSigned(a != b);
+        if (op == "&&")     return Value::ofSigned(a && b);
+        if (op == "||")     return Value::ofSigned(a || b);
+        if (isUnsigned) {
+            if (op == "<")  return Value::ofSigned(a < b);
+            if (op == ">")  return Value::ofSigned(a > b);
+            if (op == "<=") return Value::ofSigned(a <= b);
+            return Value::ofSigned(a >= b);
+        }
+        if (op == "<")      return Value::ofSigned(lhs.asSigned() < rhs.asSigned());
+        if (op == ">")      return Value::ofSigned(lhs.asSigned() > rhs.asSigned());
+        if (op == "<=")     return Value::ofSigned(lhs.asSigned() <= rhs.asSigned());
+        return Value::ofSigned(lhs.asSigned() >= rhs.asSigned());
+    }
+
+    Value binary(int minPrecedence, bool live) {
+        Value lhs = unary(live);
+        for (int prec = precedence(peek()); prec >= minPrecedence; prec = precedence(peek())) {
+            std::string_view op = peek().mText;
+            ++mPos;
+            // The right operand of && and || is only evaluated when it decides the result
+            bool rhsLive = live && !(op == "&&" && !lhs) && !(op == "||" && lhs);
+            Value rhs = binary(prec + 1, rhsLive);
+            lhs = apply(op, lhs, rhs, live);
+        }
+        return lhs;
+    }
+
+    Value conditional(bool live) {
+        Value condition = binary(1, live);
+        if (!peek().is("?"))
+            return condition;
+        ++mPos;
+        Value whenTrue = comma(live && condition);
+        expect(":");
+        Value whenFalse = conditional(live && !condition);
+        // Either branch is converted to the common type of both
+        Value result = condition ? whenTrue : whenFalse;
+        result.mUnsigned = whenTrue.mUnsigned || whenFalse.mUnsigned;
+        return result;
+    }
+
+    Value comma(bool live) {
+        Value value = conditional(live);
+        while (peek().is(",")) {
+            ++mPos;
+            value = conditional(live);
+        }
+        return value;
+    }
+
+public:
+    ConditionEvaluator(const std::vector<Token>& tokens, const std::string& location)
+        : mTokens(tokens), mLocation(location) {}
+
+    bool operator()() {
+        Value value = comma(true);
+        if (mPos != mTokens.size())
+            error(std::format("missing binary operator before token '{}'", peek().mText));
+        return static_cast<bool>(value);
+    }
+};
+
+// ------------------------------> Preprocessor <------------------------------
+
+class Preprocessor {
+private:
+    struct Frame {
+        const SourceFile* mFile;
+        size_t mPosition;
+        size_t mConditionBase;      // mConditions.size() when the file was entered
+        size_t mSearchIndex;        // Include path the file was found in, for #include_next, SIZE_MAX for none
+        uint64_t mSerial;           // Tells apart separate inclusions of the same file
+        int64_t mLineDelta = 0;     // Presumed minus physical line, set by #line
+        std::string mPresumedPath;
+    };
+
+    struct Conditional {
+        bool mTaken;                // Some group of this #if chain has been included
+        bool mElseSeen;
+    };
+
+    const PreprocessorOptions& mOptions;
+
+    // Every file read so far by normalized path, so each is only read and tokenized once
+    std::unordered_map<std::string, std::unique_ptr<SourceFile>> mFiles;
+    std::unordered_set<const SourceFile*> mPragmaOnce;
+    SourceFile mPredefined;
+
+    std::unordered_map<std::string_view, Macro> mMacros;
+    std::vector<Frame> mFrames;
+    std::vector<Conditional> mConditions;
+    uint64_t mFrameSerial = 0;
+    uint64_t mCounter = 0;
+
+    // Tokens to be read before the rest of the file, in reverse order. While a macro argument is expanded on its
+    // own, the tokens below mPendingBase belong to the surrounding text and reading stops at them.
+    std::vector<Token> mPending;
+    size_t mPendingBase = 0;
+    bool mIsolated = false;
+    bool mEvaluatingCondition = false;
+
+    // Text of pasted, stringized and builtin tokens, and every hide set, kept for as long as the tokens are
+    std::deque<std::string> mArena;
+    std::deque<HideSet> mHideSets;
+
+    std::string mOutput;
+    uint64_t mOutputSerial = 0;
+    size_t mOutputDepth = 0;
+    int64_t mOutputLine = 0;
+    bool mLastExpanded = false;
+    bool mLineChanged = false;      // Set by #line, the next token starts a new output line with a line marker
+    size_t mExpansionIndent = 0;    // Indentation of the macro name an expansion at the start of a line replaced
+
+    // ------------------------------> Errors <------------------------------
+
+    std::string location(const Token& token) const {
+        const Frame& frame = mFrames.back();
+        return std::format("{}:{}", frame.mPresumedPath, token.mLine + frame.mLineDelta);
+    }
+
+    [[noreturn]] void error(const Token& token, std::string_view message) const {
+        throw std::runtime_error(std::format("{}: {}", location(token), message));
+    }
+
+    // ------------------------------> Reading Tokens <------------------------------
+
+    const Token& peek() const {
+        if (mPending.size() > mPendingBase)
+            return mPending.back();
+        if (mIsolated)
+            return END_OF_FILE;
+        const Frame& frame = mFrames.back();
+        return frame.mFile->mTokens[frame.mPosition];
+    }
+
+    Token read() {
+        if (mPending.size() > mPendingBase) {
+            Token token = mPending.back();
+            mPending.pop_back();
+            return token;
+        }
+        if (mIsolated)
+            return END_OF_FILE;
+        Frame& frame = mFrames.back();
+        const Token& token = frame.mFile->mTokens[frame.mPosition];
+        // The EndOfFile token is never stepped over, leaveFile pops the frame instead
+        if (token.mKind != TokenKind::EndOfFile)
+            ++frame.mPosition;
+        return token;
+    }
+
+    /// @brief The remaining tokens of a directive's line
+    std::vector<Token> readLine() {
+        std::vector<Token> line;
+        while (!peek().mLineStart)
+            line.push_back(read());
+        return line;
+    }
+
+    Token readIdentifier(const Token& directive) {
+        if (peek().mLineStart || peek().mKind != TokenKind::Identifier)
+            error(directive, std::format("#{} expects a macro name", directive.mText));
+        return read();
+    }
+
+    std::string_view store(std::string text) {
+        return mArena.emplace_back(std::move(text));
+    }
+
+    // ------------------------------> Files <------------------------------
+
+    const SourceFile* loadFile(const fs::path& path) {
+        std::string key = path.lexically_normal().string();
+        if (auto it = mFiles.find(key); it != mFiles.end())
+            return it->second.get();
+
+        auto file = std::make_unique<SourceFile>();
+        file->mPath = path.string();
+        file->mDirectory = path.parent_path();
+        std::vector<uint32_t> splices;
+        file->mContents = remove_line_splices(Utils::SourceBuffer(path).view(), splices);
+        if (!tokenize(file->mContents, file->mTokens, splices))
+            throw std::runtime_error(std::format("{}: unterminated comment", file->mPath));
+        file->mGuard = detect_include_guard(file->mTokens);
+        return mFiles.emplace(std::move(key), std::move(file)).first->second.get();
+    }
+
+    void enterFile(const SourceFile* file, size_t searchIndex) {
+        if (mPragmaOnce.contains(file) || (!file->mGuard.empty() && mMacros.contains(file->mGuard)))
+            return;
+        if (mFrames.size() >= 200)
+            throw std::runtime_error(std::format("{}: #include nested too deeply", file->mPath));
+        mFrames.push_back(Frame{file, 0, mConditions.size(), searchIndex, ++mFrameSerial, 0, file->mPath});
+    }
+
+    /// @brief Pops the finished file, returns false once the main file is done
+    bool leaveFile() {
+        const Frame& frame = mFrames.back();
+        if (mConditions.size() > frame.mConditionBase)
+            error(frame.mFile->mTokens.back(), "unterminated conditional directive");
+        mFrames.pop_back();
+        return !mFrames.empty();
+    }
+
+    /// @brief Looks an include up in the includer's directory for "..." and then the include paths
+    std::optional<std::pair<fs::path, size_t>> findInclude(std::string_view name, bool angled, bool next) const {
+        std::error_code ec;
+        fs::path path(name);
+        if (path.is_absolute())
+            return fs::is_regular_file(path, ec) ? std::optional(std::pair(path, SIZE_MAX)) : std::nullopt;
+
+        const Frame& frame = mFrames.back();
+        if (!angled && !next) {
+            fs::path candidate = frame.mFile->mDirectory / path;
+            if (fs::is_regular_file(candidate, ec))
+                return std::pair(candidate, SIZE_MAX);
+        }
+        size_t start = next && frame.mSearchIndex != SIZE_MAX ? frame.mSearchIndex + 1 : 0;
+        for (size_t i = start; i < mOptions.mIncludePaths.size(); ++i) {
+            fs::path candidate = mOptions.mIncludePaths[i] / path;
+            if (fs::is_regular_file(candidate, ec))
+                return std::pair(candidate, i);
+        }
+        return std::nullopt;
+    }
+
+    /// @brief Reads "name" or <name> from the start of tokens, returns the index past it or 0 if it isn't there
+    size_t headerName(const std::vector<Token>& tokens, size_t start, std::string& name, bool& angled) const {
+        if (start >= tokens.size())
+            return 0;
+        const Token& first = tokens[start];
+        if (first.mKind == TokenKind::String && first.mText.front() == '"') {
+            name = first.mText.substr(1, first.mText.size() - 2);
+            angled = false;
+            return start + 1;
+        }
+        if (!first.is("<"))
+            return 0;
+        name.clear();
+        for (size_t i = start + 1; i < tokens.size(); ++i) {
+            if (tokens[i].is(">")) {
+                angled = true;
+                return i + 1;
+            }
+            if (i > start + 1 && tokens[i].mSpaceBefore)
+                name += ' ';
+            name += tokens[i].mText;
+        }
+        error(first, "missing terminating > character");
+    }
+
+    // ------------------------------> Hide Sets <------------------------------
+
+    static bool hideSetContains(const HideSet* set, std::string_view name) {
+        return set && std::binary_search(set->begin(), set->end(), name);
+    }
+
+    const HideSet* hideSetUnion(const HideSet* a, const HideSet* b) {
+        if (!a || a == b)
+            return b;
+        if (!b)
+            return a;
+        HideSet result;
+        std::set_union(a->begin(), a->end(), b->begin(), b->end(), std::back_inserter(result));
+        return &mHideSets.emplace_back(std::move(result));
+    }
+
+    const HideSet* hideSetIntersection(const HideSet* a, const HideSet* b) {
+        if (!a || !b)
+            return nullptr;
+        if (a == b)
+            return a;
+        HideSet result;
+        std::set_intersection(a->begin(), a->end(), b->begin(), b->end(), std::back_inserter(result));
+        return result.empty() ? nullptr : &mHideSets.emplace_back(std::move(result));
+    }
+
+    const HideSet* hideSetAdd(const HideSet* set, std::string_view name) {
+        HideSet single{name};
+        return hideSetUnion(set, &mHideSets.emplace_back(std::move(single)));
+    }
+
+    // ------------------------------> Macro Expansion <------------------------------
+    // Prosser's algorithm: every token remembers which macros it came out of, and a macro name is only expanded
+    // when it isn't one of them. The expansion is pushed back in front of the input to be rescanned.
+
+    static int parameterIndex(const Macro& macro, const Token& token) {
+        if (!macro.mFunctionLike || token.mKind != TokenKind::Identifier)
+            return -1;
+        auto it = std::find(macro.mParameters.begin(), macro.mParameters.end(), token.mText);
+        return it == macro.mParameters.end() ? -1 : static_cast<int>(it - macro.mParameters.begin());
+    }
+
+    Token stringize(const std::vector<Token>& argument, const Token& hash) {
+        std::string text = "\"";
+        for (size_t i = 0; i < argument.size(); ++i) {
+            const Token& token = argument[i];
+            if (i > 0 && token.mSpaceBefore)
+                text += ' ';
+            if (token.mKind == TokenKind::String || token.mKind == TokenKind::Character) {
+                for (char c : token.mText) {
+                    if (c == '"' || c == '\\')
+                        text += '\\';
+                    text += c;
+                }
+            }
+            else
+                text += token.mText;
+        }
+        text += '"';
+        Token result = hash;
+        result.mText = store(std::move(text));
+        result.mKind = TokenKind::String;
+        return result;
+    }
+
+    Token paste(const Token& lhs, const Token& rhs) {
+        std::string_view text = store(std::string(lhs.mText) + std::string(rhs.mText));
+        std::vector<Token> tokens;
+        if (!tokenize(text, tokens) || tokens.size() != 2)
+            error(lhs, std::format("pasting \"{}\" and \"{}\" does not give a valid preprocessing token",
+                                   lhs.mText, rhs.mText));
+        Token result = tokens[0];
+        result.mLine = lhs.mLine;
+        result.mLineStart = false;
+        result.mSpaceBefore = lhs.mSpaceBefore;
+        result.mHideSet = hideSetIntersection(lhs.mHideSet, rhs.mHideSet);
+        return result;
+    }
+
+    void append(std::vector<Token>& result, const std::vector<Token>& tokens, const Token& placeholder) {
+        size_t first = result.size();
+        result.insert(result.end(), tokens.begin(), tokens.end());
+        if (result.size() > first)
+            result[first].mSpaceBefore = placeholder.mSpaceBefore;
+    }
+
+    /// @brief Replaces the parameters in a macro's body, handling # and ##
+    std::vector<Token> substitute(const Macro& macro, const std::vector<std::vector<Token>>& arguments) {
+        const auto& body = macro.mBody;
+        std::vector<Token> result;
+        for (size_t i = 0; i < body.size(); ++i) {
+            const Token& token = body[i];
+
+            if (macro.mFunctionLike && token.is("#")) {
+                result.push_back(stringize(arguments[parameterIndex(macro, body[i + 1])], token));
+                ++i;
+                continue;
+            }
+
+            if (token.is("##")) {
+                const Token& rhs = body[i + 1];
+                int parameter = parameterIndex(macro, rhs);
+                ++i;
+                if (parameter < 0) {
+                    if (result.empty())
+                        result.push_back(rhs);
+                    else
+                        result.back() = paste(result.back(), rhs);
+                    continue;
+                }
+                const auto& argument = arguments[parameter];
+                // GNU extension, a comma pasted to empty variadic arguments disappears
+                if (macro.mVariadic && parameter + 1 == static_cast<int>(macro.mParameters.size())
+                    && !result.empty() && result.back().is(",")) {
+                    if (argument.empty())
+                        result.pop_back();
+                    else
+                        append(result, argument, rhs);
+                    continue;
+                }
+                if (argument.empty())
+                    continue;
+                if (result.empty())
+                    append(result, argument, rhs);
+                else {
+                    result.back() = paste(result.back(), argument.front());
+                    result.insert(result.end(), argument.begin() + 1, argument.end());
+                }
+                continue;
+            }
+
+            int parameter = parameterIndex(macro, token);
+            if (parameter < 0) {
+                result.push_back(token);
+                continue;
+            }
+            const auto& argument = arguments[parameter];
+
+            // The left operand of ## isn't expanded
+            if (i + 1 < body.size() && body[i + 1].is("##")) {
+                if (!argument.empty()) {
+                    append(result, argument, token);
+                    continue;
+                }
+                // An empty left operand leaves the right one as it is
+                int rhsParameter = parameterIndex(macro, body[i + 2]);
+                if (rhsParameter >= 0 && !(macro.mVariadic && rhsParameter + 1 == static_cast<int>(macro.mParameters.size()))) {
+                    append(result, arguments[rhsParameter], body[i + 2]);
+                    i += 2;
+                }
+                else
+                    ++i;
+                continue;
+            }
+
+            append(result, expandIsolated(argument), token);
+        }
+        return result;
+    }
+
+    /// @brief Collects a function-like macro's arguments after its '(', returns the closing ')'
+    Token collectArguments(const Macro& macro, const Token& name, std::vector<std::vector<Token>>& arguments) {
+        arguments.emplace_back();
+        int depth = 0;
+        for (;;) {
+            Token token = read();
+            if (token.mKind == TokenKind::EndOfFile)
+                error(name, std::format("unterminated argument list invoking macro \"{}\"", name.mText));
+            if (depth == 0 && token.is(")")) {
+                size_t parameters = macro.mParameters.size();
+                if (parameters == 0 && arguments.size() == 1 && arguments[0].empty())
+                    arguments.clear();
+                else if (macro.mVariadic && arguments.size() + 1 == parameters)
+                    arguments.emplace_back();
+                if (arguments.size() != parameters)
+                    error(name, std::format("macro \"{}\" passed {} arguments, but takes {}",
+                                            name.mText, arguments.size(), parameters));
+                return token;
+            }
+            // Commas inside the variadic arguments belong to them
+            if (depth == 0 && token.is(",") && !(macro.mVariadic && arguments.size() == macro.mParameters.size())) {
+                arguments.emplace_back();
+                continue;
+            }
+            if (token.is("("))
+                ++depth;
+            else if (token.is(")"))
+                --depth;
+            arguments.back().push_back(token);
+        }
+    }
+
+    void pushExpansion(std::vector<Token>& expansion, const Token& name, const HideSet* hideSet) {
+        for (auto& token : expansion) {
+            token.mHideSet = hideSetUnion(token.mHideSet, hideSet);
+            token.mLine = name.mLine;
+            token.mLineStart = false;
+            token.mExpanded = true;
+        }
+        // The expansion takes the name's place on its line
+        if (name.mLineStart && !name.mExpanded)
+            mExpansionIndent = indentation(name);
+        if (!expansion.empty()) {
+            expansion.front().mSpaceBefore = name.mSpaceBefore;
+            expansion.front().mLineStart = name.mLineStart;
+        }
+        else
+            mLastExpanded = true;   // The tokens around an empty expansion mustn't run together
+        mPending.insert(mPending.end(), expansion.rbegin(), expansion.rend());
+    }
+
+    Token builtin(BuiltinMacro kind, const Token& name) {
+        Token token = name;
+        token.mHideSet = nullptr;
+        token.mExpanded = true;
+        const Frame& frame = mFrames.back();
+        switch (kind) {
+            case BuiltinMacro::File: {
+                std::string text = "\"";
+                for (char c : frame.mPresumedPath) {
+                    if (c == '"' || c == '\\')
+                        text += '\\';
+                    text += c;
+                }
+                text += '"';
+                token.mText = store(std::move(text));
+                token.mKind = TokenKind::String;
+                break;
+            }
+            case BuiltinMacro::Line:
+                token.mText = store(std::to_string(name.mLine + frame.mLineDelta));
+                token.mKind = TokenKind::Number;
+                break;
+            case BuiltinMacro::Counter:
+                token.mText = store(std::to_string(mCounter++));
+                token.mKind = TokenKind::Number;
+                break;
+            case BuiltinMacro::None:
+                break;
+        }
+        return token;
+    }
+
+    /// @brief Expands the macro named by token onto mPending, returns false if it isn't an expandable macro name
+    bool expandMacro(const Token& token) {
+        if (token.mKind != TokenKind::Identifier || hideSetContains(token.mHideSet, token.mText))
+            return false;
+        auto it = mMacros.find(token.mText);
+        if (it == mMacros.end())
+            return false;
+        const Macro& macro = it->second;
+
+        if (macro.mBuiltin != BuiltinMacro::None) {
+            mPending.push_back(builtin(macro.mBuiltin, token));
+            return true;
+        }
+
+        if (!macro.mFunctionLike) {
+            auto expansion = substitute(macro, {});
+            pushExpansion(expansion, token, hideSetAdd(token.mHideSet, token.mText));
+            return true;
+        }
+
+        // A function-like macro name without arguments is left alone
+        if (!peek().is("("))
+            return false;
+        read();
+        std::vector<std::vector<Token>> arguments;
+        Token closing = collectArguments(macro, token, arguments);
+        auto expansion = substitute(macro, arguments);
+        pushExpansion(expansion, token, hideSetAdd(hideSetIntersection(token.mHideSet, closing.mHideSet), token.mText));
+        return true;
+    }
+
+    /// @brief Fully expands tokens on their own, without reading anything past them
+    std::vector<Token> expandIsolated(const std::vector<Token>& tokens) {
+        size_t savedBase = mPendingBase;
+        bool savedIsolated = mIsolated;
+        mPendingBase = mPending.size();
+        mIsolated = true;
+        mPending.insert(mPending.end(), tokens.rbegin(), tokens.rend());
+
+        std::vector<Token> result;
+        for (Token token = read(); token.mKind != TokenKind::EndOfFile; token = read()) {
+            if (mEvaluatingCondition && token.is("defined")) {
+                // The operand of a defined produced by a macro is left alone, as it would be when written out
+                result.push_back(token);
+                for (Token operand = read(); operand.mKind != TokenKind::EndOfFile; operand = read()) {
+                    result.push_back(operand);
+                    if (!operand.is("("))
+                        break;
+                }
+            }
+            else if (!expandMacro(token))
+                result.push_back(token);
+        }
+
+        mPendingBase = savedBase;
+        mIsolated = savedIsolated;
+        return result;
+    }
+
+    // ------------------------------> Directives <------------------------------
+
+    void define(const Token& directive) {
+        Token name = readIdentifier(directive);
+        if (name.mText == "defined")
+            error(name, "\"defined\" cannot be used as a macro name");
+
+        Macro macro;
+        // Only a '(' right after the name starts a parameter list
+        if (!peek().mLineStart && peek().is("(") && !peek().mSpaceBefore) {
+            read();
+            macro.mFunctionLike = true;
+            auto addParameter = [&](const Token& token, std::string_view parameter) {
+                if (std::find(macro.mParameters.begin(), macro.mParameters.end(), parameter) != macro.mParameters.end())
+                    error(token, std::format("duplicate macro parameter \"{}\"", parameter));
+                macro.mParameters.push_back(parameter);
+            };
+            for (bool first = true; ; first = false) {
+                Token token = read();
+                if (token.mLineStart)
+                    error(name, "missing ')' in macro parameter list");
+                if (first && token.is(")"))
+                    break;
+                if (token.is("...")) {
+                    macro.mVariadic = true;
+                    addParameter(token, "__VA_ARGS__");
+                    token = read();
+                }
+                else if (token.mKind == TokenKind::Identifier) {
+                    addParameter(token, token.mText);
+                    token = read();
+                    if (token.is("...")) {
+                        macro.mVariadic = true;
+                        token = read();
+                    }
+                }
+                else
+                    error(token, "expected parameter name in macro parameter list");
+                if (token.is(")"))
+                    break;
+                if (!token.is(",") || macro.mVariadic)
+                    error(token, "expected ',' or ')' in macro parameter list");
+            }
+        }
+
+        macro.mBody = readLine();
+        if (!macro.mBody.empty()) {
+            if (macro.mBody.front().is("##") || macro.mBody.back().is("##"))
+                error(name, "'##' cannot appear at either end of a macro expansion");
+            macro.mBody.front().mSpaceBefore = false;
+        }
+        if (macro.mFunctionLike) {
+            for (size_t i = 0; i < macro.mBody.size(); ++i) {
+                if (macro.mBody[i].is("#") && (i + 1 == macro.mBody.size() || parameterIndex(macro, macro.mBody[i + 1]) < 0))
+                    error(macro.mBody[i], "'#' is not followed by a macro parameter");
+            }
+        }
+        mMacros.insert_or_assign(name.mText, std::move(macro));
+    }
+
+    void include(const Token& directive, bool next) {
+        std::vector<Token> line = readLine();
+        std::string name;
+        bool angled = false;
+        if (!headerName(line, 0, name, angled)) {
+            line = expandIsolated(line);
+            if (!headerName(line, 0, name, angled))
+                error(directive, std::format("#{} expects \"FILENAME\" or <FILENAME>", directive.mText));
+        }
+        auto found = findInclude(name, angled, next);
+        if (!found)
+            error(directive, std::format("{}: No such file or directory", name));
+        enterFile(loadFile(found->first), found->second);
+    }
+
+    /// @brief Replaces the defined and __has_include operators with 0 or 1
+    std::vector<Token> resolveOperators(const std::vector<Token>& line) const {
+        std::vector<Token> resolved;
+        for (size_t i = 0; i < line.size(); ++i) {
+            const Token& token = line[i];
+            bool value;
+            if (token.is("defined")) {
+                bool parenthesized = i + 1 < line.size() && line[i + 1].is("(");
+                size_t nameIndex = i + 1 + parenthesized;
+                if (nameIndex >= line.size() || line[nameIndex].mKind != TokenKind::Identifier)
+                    error(token, "operator \"defined\" requires an identifier");
+                value = isDefined(line[nameIndex].mText);
+                i = nameIndex;
+                if (parenthesized) {
+                    if (i + 1 >= line.size() || !line[i + 1].is(")"))
+                        error(token, "missing ')' after \"defined\"");
+                    ++i;
+                }
+            }
+            else if (token.is("__has_include") || token.is("__has_include_next")) {
+                std::string name;
+                bool angled = false;
+                size_t end = i + 1 < line.size() && line[i + 1].is("(") ? headerName(line, i + 2, name, angled) : 0;
+                if (!end || end >= line.size() || !line[end].is(")"))
+                    error(token, std::format("operator \"{}\" requires a header name", token.mText));
+                value = findInclude(name, angled, token.is("__has_include_next")).has_value();
+                i = end;
+            }
+            else {
+                resolved.push_back(token);
+                continue;
+            }
+            Token number = token;
+            number.mText = value ? "1" : "0";
+            number.mKind = TokenKind::Number;
+            resolved.push_back(number);
+        }
+        return resolved;
+    }
+
+    /// @brief Reads, expands and evaluates an #if or #elif condition. The operators are resolved before expansion,
+    /// and again after it for macros that expand to them.
+    bool condition(const Token& directive) {
+        std::vector<Token> line = resolveOperators(readLine());
+        mEvaluatingCondition = true;
+        line = resolveOperators(expandIsolated(line));
+        mEvaluatingCondition = false;
+        return ConditionEvaluator(line, location(directive))();
+    }
+
+    bool isDefined(std::string_view name) const {
+        return mMacros.contains(name) || name == "__has_include" || name == "__has_include_next";
+    }
+
+    /// @brief Skips a group whose condition is false, up to the #elif, #else or #endif ending it
+    void skipGroup() {
+        Frame& frame = mFrames.back();
+        const auto& tokens = frame.mFile->mTokens;
+        int depth = 0;
+        for (; tokens[frame.mPosition].mKind != TokenKind::EndOfFile; ++frame.mPosition) {
+            if (!is_directive(tokens, frame.mPosition))
+                continue;
+            std::string_view name = tokens[frame.mPosition + 1].mText;
+            if (name == "if" || name == "ifdef" || name == "ifndef")
+                ++depth;
+            else if (name == "endif" && depth-- == 0)
+                return;
+            else if (depth == 0 && (name == "elif" || name == "else" || name == "elifdef" || name == "elifndef"))
+                return;
+        }
+    }
+
+    void beginConditional(bool value) {
+        mConditions.push_back(Conditional{value, false});
+        if (!value)
+            skipGroup();
+    }
+
+    Conditional& currentConditional(const Token& directive) {
+        if (mConditions.size() == mFrames.back().mConditionBase)
+            error(directive, std::format("#{} without #if", directive.mText));
+        return mConditions.back();
+    }
+
+    void elseGroup(const Token& directive) {
+        Conditional& conditional = currentConditional(directive);
+        if (conditional.mElseSeen)
+            error(directive, std::format("#{} after #else", directive.mText));
+
+        std::string_view name = directive.mText;
+        if (name == "else") {
+            conditional.mElseSeen = true;
+            readLine();
+            if (conditional.mTaken)
+                skipGroup();
+            conditional.mTaken = true;
+            return;
+        }
+        if (conditional.mTaken) {
+            readLine();
+            skipGroup();
+            return;
+        }
+        bool value;
+        if (name == "elif")
+            value = condition(directive);
+        else {
+            value = isDefined(readIdentifier(directive).mText) == (name == "elifdef");
+            readLine();
+        }
+        // condition() may have read tokens but never pushes conditionals, so the reference is still valid
+        conditional.mTaken = value;
+        if (!value)
+            skipGroup();
+    }
+
+    void line(const Token& directive, const Token& hash) {
+        std::vector<Token> tokens = expandIsolated(readLine());
+        if (tokens.empty() || tokens[0].mKind != TokenKind::Number)
+            error(directive, "#line directive requires a simple digit sequence");
+        int64_t number = 0;
+        std::from_chars(tokens[0].mText.data(), tokens[0].mText.data() + tokens[0].mText.size(), number);
+        Frame& frame = mFrames.back();
+        // The line after the directive gets the given number
+        frame.mLineDelta = number - static_cast<int64_t>(hash.mLine) - 1;
+        if (tokens.size() > 1 && tokens[1].mKind == TokenKind::String)
+            frame.mPresumedPath = std::string(tokens[1].mText.substr(1, tokens[1].mText.size() - 2));
+        // The number may go backwards or stay the same, so it can't be told from the next token's line
+        mLineChanged = true;
+    }
+
+    std::string lineText(const std::vector<Token>& tokens) const {
+        std::string text;
+        for (const auto& token : tokens) {
+            if (!text.empty() && token.mSpaceBefore)
+                text += ' ';
+            text += token.mText;
+        }
+        return text;
+    }
+
+    void directive(const Token& hash) {
+        // A # alone on its line does nothing
+        if (peek().mLineStart)
+            return;
+        Token name = read();
+        std::string_view directive = name.mText;
+
+        if (directive == "define")
+            define(name);
+        else if (directive == "undef") {
+            mMacros.erase(readIdentifier(name).mText);
+            readLine();
+        }
+        else if (directive == "include")
+            include(name, false);
+        else if (directive == "include_next")
+            include(name, true);
+        else if (directive == "if")
+            beginConditional(condition(name));
+        else if (directive == "ifdef" || directive == "ifndef") {
+            bool value = isDefined(readIdentifier(name).mText) == (directive == "ifdef");
+            readLine();
+            beginConditional(value);
+        }
+        else if (directive == "elif" || directive == "else" || directive == "elifdef" || directive == "elifndef")
+            elseGroup(name);
+        else if (directive == "endif") {
+            currentConditional(name);
+            mConditions.pop_back();
+            readLine();
+        }
+        else if (directive == "line" || name.mKind == TokenKind::Number) {
+            if (name.mKind == TokenKind::Number)
+                mPending.push_back(name);   // GNU line marker, # 12 "file"
+            line(name, hash);
+        }
+        else if (directive == "error")
+            error(name, std::format("#error {}", lineText(readLine())));
+        else if (directive == "warning")
+            std::cerr << std::format("{}: warning: #warning {}\n", location(name), lineText(readLine()));
+        else if (directive == "pragma") {
+            // Only #pragma once means anything here, other pragmas are dropped
+            std::vector<Token> tokens = readLine();
+            if (!tokens.empty() && tokens[0].is("once"))
+                mPragmaOnce.insert(mFrames.back().mFile);
+        }
+        else if (directive == "ident" || directive == "sccs")
+            readLine();
+        else
+            error(name, std::format("invalid preprocessing directive #{}", directive));
+    }
+
+    // ------------------------------> Output <------------------------------
+
+    void lineMarker(int64_t line, const std::string& path, int flag) {
+        mOutput += std::format("# {} \"{}\"", line, path);
+        if (flag)
+            mOutput += std::format(" {}", flag);
+        mOutput += '\n';
+    }
+
+    /// @brief Whether two tokens written next to each other would be read back as something else
+    static bool wouldMerge(char last, char first) {
+        if (is_identifier_char(last) || last == '.')
+            return is_identifier_char(first) || first == '.' || first == '"' || first == '\''
+                || ((last == 'e' || last == 'E' || last == 'p' || last == 'P') && (first == '+' || first == '-'));
+        char pair[] = {last, first};
+        std::string_view joined(pair, 2);
+        if (joined == "//" || joined == "/*")
+            return true;
+        return std::any_of(std::begin(MULTI_CHAR_PUNCTUATORS), std::end(MULTI_CHAR_PUNCTUATORS),
+                           [&](std::string_view punctuator) { return punctuator.starts_with(joined); });
+    }
+
+    /// @brief Columns before a token read straight from the current file, which gcc writes out as spaces
+    size_t indentation(const Token& token) const {
+        std::string_view contents = mFrames.back().mFile->mContents;
+        const char* begin = contents.data();
+        const char* text = token.mText.data();
+        if (std::less<>()(text, begin) || std::less<>()(begin + contents.size(), text))
+            return 0;
+        size_t column = 0;
+        for (; text > begin && text[-1] != '\n'; --text)
+            ++column;
+        return column;
+    }
+
+    void emit(const Token& token) {
+        const Frame& frame = mFrames.back();
+        int64_t line = token.mLine + frame.mLineDelta;
+
+        if (frame.mSerial != mOutputSerial || mLineChanged) {
+            if (!mOutput.empty() && mOutput.back() != '\n')
+                mOutput += '\n';
+            if (mOptions.mLineMarkers) {
+                // 1 for entering an include, 2 for returning from one
+                int flag = mFrames.size() > mOutputDepth ? 1 : mFrames.size() < mOutputDepth ? 2 : 0;
+                lineMarker(line, frame.mPresumedPath, flag);
+            }
+            mOutputSerial = frame.mSerial;
+            mOutputDepth = mFrames.size();
+            mOutputLine = line;
+            mLineChanged = false;
+        }
+        else if (token.mLineStart && line != mOutputLine) {
+            // Like gcc -P, blank lines are dropped without line markers. With them short gaps are kept as
+            // blank lines, and longer ones get a line marker.
+            int64_t gap = line - mOutputLine;
+            if (!mOptions.mLineMarkers)
+                mOutput += '\n';
+            else if (gap > 0 && gap <= 8)
+                mOutput.append(static_cast<size_t>(gap), '\n');
+            else {
+                mOutput += '\n';
+                lineMarker(line, frame.mPresumedPath, 0);
+            }
+            mOutputLine = line;
+        }
+
+        bool atLineStart = mOutput.empty() || mOutput.back() == '\n';
+        if (atLineStart && token.mLineStart)
+            mOutput.append(token.mExpanded ? mExpansionIndent : indentation(token), ' ');
+        else if (!atLineStart && (token.mSpaceBefore
+                 || ((token.mExpanded || mLastExpanded) && wouldMerge(mOutput.back(), token.mText.front()))))
+            mOutput += ' ';
+
+        mOutput += token.mText;
+        mLastExpanded = token.mExpanded;
+    }
+
+    void run() {
+        for (;;) {
+            Token token = read();
+            if (token.mKind == TokenKind::EndOfFile) {
+                if (!leaveFile())
+                    break;
+                continue;
+            }
+            if (!token.mExpanded && token.mLineStart && token.is("#"))
+                directive(token);
+            else if (!expandMacro(token))
+                emit(token);
+        }
+    }
+
+public:
+    explicit Preprocessor(const PreprocessorOptions& options) : mOptions(options) {
+        mPredefined.mPath = "<built-in>";
+        mPredefined.mContents = PREDEFINED_MACROS;
+        tokenize(mPredefined.mContents, mPredefined.mTokens);
+
+        mMacros["__FILE__"].mBuiltin = BuiltinMacro::File;
+        mMacros["__LINE__"].mBuiltin = BuiltinMacro::Line;
+        mMacros["__COUNTER__"].mBuiltin = BuiltinMacro::Counter;
+    }
+
+    std::string operator()(const fs::path& sourcePath) {
+        enterFile(loadFile(sourcePath), SIZE_MAX);
+        if (mOptions.mLineMarkers) {
+            lineMarker(1, mFrames.back().mPresumedPath, 0);
+            mOutputSerial = mFrames.back().mSerial;
+            mOutputDepth = mFrames.size();
+            mOutputLine = 1;
+        }
+        // The predefined macros are read first, as if included at the top of the source file
+        enterFile(&mPredefined, SIZE_MAX);
+        run();
+        if (!mOutput.empty() && mOutput.back() != '\n')
+            mOutput += '\n';
+        return std::move(mOutput);
+    }
+};
+
+// ------------------------------> default_include_paths <------------------------------
+
+std::vector<fs::path> default_include_paths() {
+    std::vector<fs::path> paths;
+
+    // GCC's own headers such as stddef.h and stdarg.h, from the newest version installed
+    std::error_code ec;
+    fs::path newest;
+    int newestVersion = -1;
+    for (const auto& entry : fs::directory_iterator("/usr/lib/gcc/x86_64-linux-gnu", ec)) {
+        std::string name = entry.path().filename().string();
+        int version = 0;
+        auto [ptr, err] = std::from_chars(name.data(), name.data() + name.size(), version);
+        if (err == std::errc() && version > newestVersion && fs::is_directory(entry.path() / "include", ec)) {
+            newestVersion = version;
+            newest = entry.path() / "include";
+        }
+    }
+    if (newestVersion >= 0)
+        paths.push_back(newest);
+
+    for (const char* path : {"/usr/local/include", "/usr/include/x86_64-linux-gnu", "/usr/include"})
+        paths.emplace_back(path);
+    return paths;
+}
+
+// ------------------------------> preprocess <------------------------------
+
+std::string preprocess(const fs::path& sourcePath, const PreprocessorOptions& options) {
+    return Preprocessor(options)(sourcePath);
+}
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace compiler::preprocessor {
+
+struct PreprocessorOptions {
+    bool mLineMarkers = false;              // Write # <line> "<file>" markers like gcc -E does without -P
+    std::vector<fs::path> mIncludePaths;    // Searched for <...> includes, and for "..." ones after the includer's directory
+};
+
+/// @brief Include paths of the host's C compiler: its own headers, then the system's
+std::vector<fs::path> default_include_paths();
+
+/// @brief Runs the preprocessor over a source file and returns the resulting text. Included files are read and
+/// tokenized once per call however often they're included, and files with include guards or #pragma once are
+/// skipped without being rescanned.
+std::string preprocess(const fs::path& sourcePath, const PreprocessorOptions& options);
+
+}
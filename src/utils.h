@@ -1,21 +1,103 @@
 #pragma once
+#include <exception>
 #include <iostream>
 #include <optional>
 #include <string>
 #include <filesystem>
 #include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
 namespace Utils {
 
-inline std::string readFile(const fs::path& filePath) {
-    std::ifstream file {filePath};
-    if (!file) {
-        throw std::runtime_error("Failed to read file: " + filePath.string());
+// ------------------------------> SourceBuffer <------------------------------
+
+/// Read-only view of a source file, memory mapped where possible so no copy of the file is made.
+/// The contents are always followed by PADDING zero bytes, so scanners may read past the end
+/// in wide chunks and will stop at the zero sentinel.
+class SourceBuffer {
+public:
+    static constexpr size_t PADDING = 64;
+
+    explicit SourceBuffer(const fs::path& filePath) {
+        int fd = ::open(filePath.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Failed to read file: " + filePath.string());
+
+        struct stat fileStat;
+        if (::fstat(fd, &fileStat) < 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to read file: " + filePath.string());
+        }
+
+        // Empty files and pipes can't be mapped, fall back to reading into a padded heap buffer
+        if (!S_ISREG(fileStat.st_mode) || fileStat.st_size == 0) {
+            ::close(fd);
+            readIntoFallback(filePath);
+            return;
+        }
+
+        mSize = static_cast<size_t>(fileStat.st_size);
+        size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        mMappedSize = ((mSize + PADDING + pageSize - 1) / pageSize) * pageSize;
+
+        // Reserve zeroed pages for the file plus padding, then map the file over the start of them.
+        // Pages past the end of the file stay anonymous so reading the padding can't fault.
+        void* reserved = ::mmap(nullptr, mMappedSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (reserved == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Failed to map file: " + filePath.string());
+        }
+
+        void* mapped = ::mmap(reserved, mSize, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            ::munmap(reserved, mMappedSize);
+            throw std::runtime_error("Failed to map file: " + filePath.string());
+        }
+
+        ::madvise(mapped, mSize, MADV_SEQUENTIAL);
+        mData = static_cast<const char*>(mapped);
     }
-    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
-}
+
+    /// Takes ownership of text produced in memory, such as the preprocessor's output
+    explicit SourceBuffer(std::string contents) : mSize(contents.size()), mFallback(std::move(contents)) {
+        mFallback.resize(mSize + PADDING, '\0');
+        mData = mFallback.data();
+    }
+
+    ~SourceBuffer() {
+        if (mMappedSize)
+            ::munmap(const_cast<char*>(mData), mMappedSize);
+    }
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    std::string_view view() const { return std::string_view(mData, mSize); }
+
+private:
+    const char* mData = nullptr;
+    size_t mSize = 0;
+    size_t mMappedSize = 0;        // Non-zero only when the file is memory mapped
+    std::string mFallback;
+
+    void readIntoFallback(const fs::path& filePath) {
+        std::ifstream file {filePath, std::ios::binary};
+        if (!file)
+            throw std::runtime_error("Failed to read file: " + filePath.string());
+        mFallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        mSize = mFallback.size();
+        mFallback.resize(mSize + PADDING, '\0');
+        mData = mFallback.data();
+    }
+};
 
 /// Outputs a substring centered on a particular position of a string_view.
 /// 
@@ -33,4 +115,44 @@ inline std::string stringCenteredOnPos(std::string_view sv, size_t pos, int32_t
     return std::string(sv.substr(start_index, end_index));
 }
 
+// ------------------------------> runWithStack <------------------------------
+
+/// Runs f on a thread with a stack of stackSize bytes and returns its result, rethrowing anything it throws.
+/// The parser and the passes over the AST recurse once per nesting level of the source, so deeply nested
+/// programs need far more than the usual 8MB. Only the part of the stack actually used is backed by memory.
+template<typename F>
+int runWithStack(size_t stackSize, F&& f) {
+    struct Call {
+        F* mFunction;
+        int mResult = 0;
+        std::exception_ptr mException;
+    } call{&f};
+
+    auto entry = [](void* argument) -> void* {
+        auto* call = static_cast<Call*>(argument);
+        try {
+            call->mResult = (*call->mFunction)();
+        } catch (...) {
+            call->mException = std::current_exception();
+        }
+        return nullptr;
+    };
+
+    pthread_attr_t attributes;
+    pthread_t thread;
+    if (::pthread_attr_init(&attributes) != 0)
+        throw std::runtime_error("Failed to create a thread");
+    int error = ::pthread_attr_setstacksize(&attributes, stackSize);
+    if (error == 0)
+        error = ::pthread_create(&thread, &attributes, entry, &call);
+    ::pthread_attr_destroy(&attributes);
+    if (error != 0)
+        throw std::runtime_error("Failed to create a thread with a " + std::to_string(stackSize >> 20) + "MB stack");
+    ::pthread_join(thread, nullptr);
+
+    if (call.mException)
+        std::rethrow_exception(call.mException);
+    return call.mResult;
+}
+
 }
\ No newline at end of file
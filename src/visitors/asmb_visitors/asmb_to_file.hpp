@@ -1,8 +1,15 @@
 #pragma once
 #include "../../ast/ast_asmb.hpp"
-#include <memory>
-#include <sstream>
+#include "../../ast/general.hpp"
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <fcntl.h>
 #include <format>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unistd.h>
 #include <unordered_map>
 
 
@@ -14,7 +21,7 @@ using namespace ast;
 
 struct ReplacePseudoRegisters {
 
-    std::unordered_map<std::string, uint32_t> mMap;
+    SymbolIdMap<int32_t> mMap;
     int32_t mLastStackLocation = 0;
     
     // Operand visitors
@@ -28,10 +35,10 @@ struct ReplacePseudoRegisters {
 
     asmb::Operand operator()(const asmb::Pseudo& pseudo) {
         if (mMap.contains(pseudo.mName))
-            return asmb::Stack(mMap[pseudo.mName]);
+            return asmb::Stack(mMap.at(pseudo.mName));
         // else
         mLastStackLocation -= 4;
-        mMap.emplace(pseudo.mName, mLastStackLocation);
+        mMap.insert_or_assign(pseudo.mName, mLastStackLocation);
         return asmb::Stack(mLastStackLocation);
     }
 
@@ -58,6 +65,10 @@ struct ReplacePseudoRegisters {
         idiv.mOperand = std::visit(*this, idiv.mOperand);
     }
 
+    void operator()(asmb::Imul& imul) {
+        imul.mOperand = std::visit(*this, imul.mOperand);
+    }
+
     void operator()(const asmb::Cdq& cdq) const {}
 
     void operator()(const asmb::AllocateStack& allocateStack) const {
@@ -73,6 +84,10 @@ struct ReplacePseudoRegisters {
     void operator()(const asmb::Jmp& jmp) const {}
     void operator()(const asmb::JmpCC& jmpCC) const {}
 
+    void operator()(asmb::JmpTable& jmpTable) {
+        jmpTable.mIndex = std::visit(*this, jmpTable.mIndex);
+    }
+
     void operator()(asmb::SetCC& setCC) {
         setCC.mDst = std::visit(*this, setCC.mDst);
     }
@@ -81,6 +96,8 @@ struct ReplacePseudoRegisters {
 
     void operator()(const asmb::Push& push) const {}
 
+    void operator()(const asmb::Pop& pop) const {}
+
     void operator()(const asmb::Call& call) const {}
 
     void operator()(const asmb::Ret& ret) const {}
@@ -106,30 +123,21 @@ struct ReplacePseudoRegisters {
 // ------------------------------> Fix up ASMB instructions (2nd Pass) <------------------------------
 
 struct FixUpAsmbInstructions {
-    std::vector<asmb::Instruction>* mInstructions = nullptr;
-    size_t mInstructionCounter = 0;
+    // Fixed instructions are streamed here in order, rather than inserted into the middle of the
+    // function's vector, and the two are swapped at the end. Kept across functions for reuse.
+    std::vector<asmb::Instruction> mOutput;
 
-    // Operand visitors
-    void operator()(const asmb::Imm& imm) const {}
-    void operator()(const asmb::Reg& reg) const {}
-    void operator()(const asmb::Pseudo& pseudo) const {}
-    void operator()(const asmb::Stack& stack) const {}
-    
     // Instruction visitors
-    void operator()(const asmb::Ret& ret) const {}
-    
     void operator()(asmb::Mov& mov) {
         if (!std::holds_alternative<asmb::Stack>(mov.mSrc) ||
-            !std::holds_alternative<asmb::Stack>(mov.mDst))
+            !std::holds_alternative<asmb::Stack>(mov.mDst)) {
+            mOutput.emplace_back(std::move(mov));
             return;
+        }
         // Otherwise this is a mem->mem mov operation which is not allowed.
-        auto stackDst = mov.mDst;
-        mov.mDst = asmb::Reg(asmb::RegisterName::R10);
-        asmb::Mov nextMovInstruction(mov.mDst, stackDst);
-        mInstructions->emplace(mInstructions->begin() + mInstructionCounter + 1, std::move(nextMovInstruction));
-    }
-
-    void operator()(const asmb::Unary& unary) const {
+        auto registerDst = asmb::Reg(asmb::RegisterName::R10);
+        mOutput.emplace_back(asmb::Mov(std::move(mov.mSrc), registerDst));
+        mOutput.emplace_back(asmb::Mov(registerDst, std::move(mov.mDst)));
     }
 
     void operator()(asmb::Binary& binary) {
@@ -139,66 +147,50 @@ struct FixUpAsmbInstructions {
         ) {
             auto stackDestination = binary.mOperand2;
             auto registerDst = asmb::Reg(asmb::RegisterName::R11);
-            asmb::Mov mov1(stackDestination, registerDst);
-            asmb::Mov mov2(registerDst, stackDestination);
 
             binary.mOperand2 = registerDst;
-            mInstructions->emplace(mInstructions->begin() + mInstructionCounter + 1, std::move(mov2));
-            mInstructions->emplace(mInstructions->begin() + mInstructionCounter, std::move(mov1));
-        }
-
-        // Shift operation needs second operand in CX register.
-        else if ((binary.mOp == asmb::BinaryOperator::Left_Shift
-                || binary.mOp == asmb::BinaryOperator::Right_Shift)
-                && (!std::holds_alternative<asmb::Reg>(binary.mOperand1)
-                || std::get<asmb::Reg>(binary.mOperand1).mReg != asmb::RegisterName::CX)
-        ) {
-            // Move count to CX register for calculation
-            auto count = binary.mOperand1;
-            auto registerDst = asmb::Reg(asmb::RegisterName::CX);
-            asmb::Mov moveCount(count, registerDst);
-
-            binary.mOperand1 = registerDst;
-            mInstructions->emplace(mInstructions->begin() + mInstructionCounter, std::move(moveCount));
+            mOutput.emplace_back(asmb::Mov(stackDestination, registerDst));
+            mOutput.emplace_back(std::move(binary));
+            mOutput.emplace_back(asmb::Mov(registerDst, stackDestination));
+            return;
         }
 
         // Binary operation can't have both operands in memory.
-        else if (std::holds_alternative<asmb::Stack>(binary.mOperand1)
+        if (std::holds_alternative<asmb::Stack>(binary.mOperand1)
             && std::holds_alternative<asmb::Stack>(binary.mOperand2)
         ) {
-            // Move operand1 to r10 register
+            // Move operand1 to r10 register and use that in the binop instead
             auto registerDst = asmb::Reg(asmb::RegisterName::R10);
-            asmb::Mov movInstruction(binary.mOperand1, registerDst);
-
-            // Replace operand1 in binop as r10 register
+            mOutput.emplace_back(asmb::Mov(binary.mOperand1, registerDst));
             binary.mOperand1 = registerDst;
-
-            // Insert move instruction
-            mInstructions->emplace(mInstructions->begin() + mInstructionCounter, std::move(movInstruction));
         }
+        mOutput.emplace_back(std::move(binary));
     }
 
     void operator()(asmb::Idiv& idiv) {
-        if (!std::holds_alternative<asmb::Imm>(idiv.mOperand)) return;
-        // Otherwise idiv is using an immediate value as operand which is not allowed.
-        asmb::Mov preMovInstruction(idiv.mOperand, asmb::Reg(asmb::RegisterName::R10));
-        idiv.mOperand = asmb::Reg(asmb::RegisterName::R10);
-        mInstructions->emplace(mInstructions->begin() + mInstructionCounter, preMovInstruction);
+        // idiv can't use an immediate value as operand
+        if (std::holds_alternative<asmb::Imm>(idiv.mOperand)) {
+            mOutput.emplace_back(asmb::Mov(idiv.mOperand, asmb::Reg(asmb::RegisterName::R10)));
+            idiv.mOperand = asmb::Reg(asmb::RegisterName::R10);
+        }
+        mOutput.emplace_back(std::move(idiv));
     }
 
-    void operator()(const asmb::Cdq& cdq) const {}
-
-    void operator()(const asmb::AllocateStack& allocateStack) const {}
-
-    void operator()(const asmb::DeallocateStack& deallocateStack) const {}
+    void operator()(asmb::Imul& imul) {
+        // Same as idiv, the one operand form can't take an immediate value
+        if (std::holds_alternative<asmb::Imm>(imul.mOperand)) {
+            mOutput.emplace_back(asmb::Mov(imul.mOperand, asmb::Reg(asmb::RegisterName::R10)));
+            imul.mOperand = asmb::Reg(asmb::RegisterName::R10);
+        }
+        mOutput.emplace_back(std::move(imul));
+    }
 
-    void operator()(asmb::Cmp& cmp) const {
+    void operator()(asmb::Cmp& cmp) {
 
         // Compare operation can't have Operand2 be an immediate value (analaguous to dst in sub).
         if (std::holds_alternative<asmb::Imm>(cmp.mOperand2)) {
-            asmb::Mov preMovInstruction(cmp.mOperand2, asmb::Reg(asmb::RegisterName::R10));
+            mOutput.emplace_back(asmb::Mov(cmp.mOperand2, asmb::Reg(asmb::RegisterName::R10)));
             cmp.mOperand2 = asmb::Reg(asmb::RegisterName::R10);
-            mInstructions->emplace(mInstructions->begin() + mInstructionCounter, preMovInstruction);
         }
 
         // Compare operation can't have both operands in memory.
@@ -206,183 +198,342 @@ struct FixUpAsmbInstructions {
         else if (std::holds_alternative<asmb::Stack>(cmp.mOperand1)
             && std::holds_alternative<asmb::Stack>(cmp.mOperand2)
         ) {
-            // Move operand1 to r10 register
+            // Move operand1 to r10 register and use that in the compare instead
             auto registerDst = asmb::Reg(asmb::RegisterName::R10);
-            asmb::Mov movInstruction(cmp.mOperand1, registerDst);
-
-            // Replace operand1 in binop as r10 register
+            mOutput.emplace_back(asmb::Mov(cmp.mOperand1, registerDst));
             cmp.mOperand1 = registerDst;
-
-            // Insert move instruction
-            mInstructions->emplace(mInstructions->begin() + mInstructionCounter, std::move(movInstruction));
         }
+        mOutput.emplace_back(std::move(cmp));
+    }
+
+    // Nothing to fix in the remaining instructions
+    template<typename T>
+    void operator()(T& instruction) {
+        mOutput.emplace_back(std::move(instruction));
     }
-    void operator()(const asmb::Jmp& jmp) const {}
-    void operator()(const asmb::JmpCC& jmpCC) const {}
-    void operator()(const asmb::SetCC& setCC) const {}
-    void operator()(const asmb::Label& label) const {}
-    void operator()(const asmb::Push& push) const {}
-    void operator()(const asmb::Call& call) const {}
 
     // Function visitor
-    void operator()(asmb::Function& func, uint32_t stackSize) {
-        // Set mInstructions reference and reset instruction counter
-        mInstructions = &func.mInstructions;
-        mInstructionCounter = 0;
+    void operator()(asmb::Function& func, uint32_t stackSize, uint32_t calleeSavedCount = 0) {
+        auto& instructions = func.mInstructions;
+
+        // A fixed instruction gains at most two more and most need nothing, so half again as
+        // many rarely has to grow
+        mOutput.clear();
+        mOutput.reserve(instructions.size() + instructions.size() / 2 + 1);
 
-        // Add AllocateStack instruction rounded to nearest 16 for alignment
-        stackSize = ((stackSize + 16 - 1) / 16) * 16;
-        asmb::AllocateStack allocateStackInstruction(stackSize);
-        mInstructions->emplace(mInstructions->begin(), allocateStackInstruction);
+        // Add AllocateStack instruction rounded so that, with the callee-saved registers pushed
+        // after it, the frame stays a multiple of 16 for alignment
+        uint32_t savedSize = 8 * calleeSavedCount;
+        stackSize = ((stackSize + savedSize + 16 - 1) / 16) * 16 - savedSize;
+        mOutput.emplace_back(asmb::AllocateStack(stackSize));
 
         // Fix any memory to memory mov instructions
-        while(mInstructionCounter < mInstructions->size()) {
-            std::visit(*this, (*mInstructions)[mInstructionCounter]);
-            ++mInstructionCounter;
-        }
+        for (auto& instruction : instructions)
+            std::visit(*this, instruction);
+
+        instructions.swap(mOutput);
     }
 
     // Program visitor
     void operator()(asmb::Program& program, SymbolMapType& symbolMap) {
-        for (auto& function : program.mFunctions)
-            (*this)(function, symbolMap.at(function.mIdentifier).mStackSize);
+        for (auto& function : program.mFunctions) {
+            const SymbolInfo& symbolInfo = symbolMap.at(function.mIdentifier);
+            (*this)(function, symbolInfo.mStackSize, symbolInfo.mCalleeSavedCount);
+        }
     }
 };
 
 // ------------------------------> Code Emission <------------------------------
-// A lot of copying, but I'm okay with it for now as it makes it more readable.
+// Text is appended straight into one buffer for the whole program, which is written out with a
+// single write() at the end. Register and condition code names come from tables built at compile
+// time, numbers go through std::to_chars.
+
+// Every register's name at every size, indexed by RegisterName then RegisterSize
+constexpr size_t REGISTER_NAME_COUNT = static_cast<size_t>(asmb::RegisterName::R15) + 1;
+constexpr size_t REGISTER_SIZE_COUNT = static_cast<size_t>(asmb::RegisterSize::BYTE) + 1;
+
+constexpr auto REGISTER_STRINGS = [] {
+    std::array<std::array<std::string_view, REGISTER_SIZE_COUNT>, REGISTER_NAME_COUNT> strings{};
+    for (size_t reg = 0; reg < REGISTER_NAME_COUNT; ++reg)
+        for (size_t size = 0; size < REGISTER_SIZE_COUNT; ++size)
+            strings[reg][size] = asmb::reg_name_to_string(static_cast<asmb::RegisterName>(reg),
+                                                          static_cast<asmb::RegisterSize>(size));
+    return strings;
+}();
+
+constexpr size_t CONDITION_CODE_COUNT = static_cast<size_t>(asmb::ConditionCode::A) + 1;
+
+constexpr auto CONDITION_CODE_STRINGS = [] {
+    std::array<std::string_view, CONDITION_CODE_COUNT> strings{};
+    for (size_t code = 0; code < CONDITION_CODE_COUNT; ++code)
+        strings[code] = asmb::condition_code_to_string(static_cast<asmb::ConditionCode>(code));
+    return strings;
+}();
+
+/// @brief Writes contents to the file at path with as few write() calls as the kernel allows
+inline void write_file(const std::string& path, std::string_view contents) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error(std::format("Couldn't open {} for writing", path));
+    while (!contents.empty()) {
+        ssize_t written = ::write(fd, contents.data(), contents.size());
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            ::close(fd);
+            throw std::runtime_error(std::format("Couldn't write {}", path));
+        }
+        contents.remove_prefix(static_cast<size_t>(written));
+    }
+    ::close(fd);
+}
 
 struct EmitAsmbVisitor {
 
 private:
     const SymbolMapType& mSymbolMap;
 
+    // The whole program's assembly, kept between calls so its storage is reused
+    std::string mBuffer;
+
+    // Jump tables of the function being emitted, written out after its instructions
+    std::vector<const asmb::JmpTable*> mJumpTables;
+
+    void append(std::string_view text) {
+        mBuffer.append(text);
+    }
+
+    void appendNumber(int64_t value) {
+        char digits[24];
+        auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value);
+        mBuffer.append(digits, end);
+    }
+
+    void appendLabel(SymbolId label) {
+        append(".L");
+        append(spelling(label));
+    }
+
+    void appendRegister(asmb::RegisterName reg, asmb::RegisterSize size) {
+        append(REGISTER_STRINGS[static_cast<size_t>(reg)][static_cast<size_t>(size)]);
+    }
+
+    void appendConditionCode(asmb::ConditionCode code) {
+        append(CONDITION_CODE_STRINGS[static_cast<size_t>(code)]);
+    }
+
+    void appendOperand(const asmb::Operand& operand, asmb::RegisterSize registerSize = asmb::RegisterSize::DWORD) {
+        std::visit([&](const auto& op) { (*this)(op, registerSize); }, operand);
+    }
+
 public:
     EmitAsmbVisitor(const SymbolMapType& symbolMap) : mSymbolMap(symbolMap) {}
 
     // Operand visitors
-    std::string operator() (const asmb::Imm& imm) {
-        return std::format("${}", imm.mValue);
+    void operator() (const asmb::Imm& imm, asmb::RegisterSize) {
+        append("$");
+        appendNumber(imm.mValue);
     }
 
-    std::string operator() (const asmb::Reg& reg, asmb::RegisterSize registerSize = asmb::RegisterSize::DWORD) {
-        return std::string(asmb::reg_name_to_string(reg.mReg, registerSize));
+    void operator() (const asmb::Reg& reg, asmb::RegisterSize registerSize) {
+        appendRegister(reg.mReg, registerSize);
     }
 
-    std::string operator() (const asmb::Pseudo& pseudo) {
+    void operator() (const asmb::Pseudo& pseudo, asmb::RegisterSize) {
         // should not have any pseudo registers.
         throw std::runtime_error("Pseudo operand in tree during EmitAsmbVisitor");
     }
 
-    std::string operator() (const asmb::Stack& stack) {
-        return std::format("{}(%rbp)", stack.mLocation);
+    void operator() (const asmb::Stack& stack, asmb::RegisterSize) {
+        appendNumber(stack.mLocation);
+        append("(%rbp)");
     }
 
     // Instruction visitors
-    std::string operator() (const asmb::Mov& mov) {
-        return std::format("movl {}, {}", std::visit(*this, mov.mSrc), std::visit(*this, mov.mDst));
+    void operator() (const asmb::Mov& mov) {
+        append("\tmovl ");
+        appendOperand(mov.mSrc);
+        append(", ");
+        appendOperand(mov.mDst);
+        append("\n");
+    }
+
+    void operator() (const asmb::Ret& ret) {
+        append("\tmovq %rbp, %rsp\n\tpopq %rbp\n\tret\n");
     }
 
-    std::string operator() (const asmb::Ret& ret) {
-        return "movq %rbp, %rsp\n\tpopq %rbp\n\tret";
+    void operator() (const asmb::Unary& unary) {
+        append("\t");
+        append(asmb::unary_op_to_instruction(unary.mOp));
+        append(" ");
+        appendOperand(unary.mOperand);
+        append("\n");
     }
 
-    std::string operator() (const asmb::Unary& unary) {
-        return std::format("{} {}", asmb::unary_op_to_instruction(unary.mOp), std::visit(*this, unary.mOperand));
+    void operator() (const asmb::Binary& binary) {
+        append("\t");
+        append(asmb::binary_op_to_instruction(binary.mOp));
+        append(" ");
+        appendOperand(binary.mOperand1);
+        append(", ");
+        appendOperand(binary.mOperand2);
+        append("\n");
     }
 
-    std::string operator() (const asmb::Binary& binary) {
-        return std::format("{} {}, {}",
-                            asmb::binary_op_to_instruction(binary.mOp),
-                            std::visit(*this, binary.mOperand1),
-                            std::visit(*this, binary.mOperand2));
+    void operator() (const asmb::Idiv& idiv) {
+        append("\tidivl ");
+        appendOperand(idiv.mOperand);
+        append("\n");
     }
 
-    std::string operator() (const asmb::Idiv& idiv) {
-        return std::format("idivl {}", std::visit(*this, idiv.mOperand));
+    void operator() (const asmb::Imul& imul) {
+        append("\timull ");
+        appendOperand(imul.mOperand);
+        append("\n");
     }
 
-    std::string operator() (const asmb::Cdq& cdq) {
-        return "Cdq";
+    void operator() (const asmb::Cdq& cdq) {
+        append("\tCdq\n");
     }
 
-    std::string operator() (const asmb::AllocateStack& allocateStack) {
-        return std::format("subq ${}, %rsp", allocateStack.mValue);
+    void operator() (const asmb::AllocateStack& allocateStack) {
+        append("\tsubq $");
+        appendNumber(allocateStack.mValue);
+        append(", %rsp\n");
     }
 
-    std::string operator()(const asmb::DeallocateStack& deallocateStack) {
-       return std::format("addq ${}, %rsp", deallocateStack.mValue);
+    void operator()(const asmb::DeallocateStack& deallocateStack) {
+        append("\taddq $");
+        appendNumber(deallocateStack.mValue);
+        append(", %rsp\n");
     }
 
-    std::string operator()(const asmb::Cmp& cmp) {
-        return std::format("cmpl {}, {}", std::visit(*this, cmp.mOperand1), std::visit(*this, cmp.mOperand2));
+    void operator()(const asmb::Cmp& cmp) {
+        append("\tcmpl ");
+        appendOperand(cmp.mOperand1);
+        append(", ");
+        appendOperand(cmp.mOperand2);
+        append("\n");
     }
 
-    std::string operator()(const asmb::Jmp& jmp) {
-        return std::format("jmp .L{}", jmp.mIdentifier);
+    void operator()(const asmb::Jmp& jmp) {
+        append("\tjmp ");
+        appendLabel(jmp.mIdentifier);
+        append("\n");
     }
 
-    std::string operator()(const asmb::JmpCC& jmpCC) {
-        return std::format("j{} .L{}", asmb::condition_code_to_string(jmpCC.mCondCode), jmpCC.mIdentifier);
+    void operator()(const asmb::JmpCC& jmpCC) {
+        append("\tj");
+        appendConditionCode(jmpCC.mCondCode);
+        append(" ");
+        appendLabel(jmpCC.mIdentifier);
+        append("\n");
     }
 
-    std::string operator()(const asmb::SetCC& setCC) {
-        std::string_view dstString;
-        // Can't use visitor on register as we need 1 byte name.
-        if (std::holds_alternative<asmb::Reg>(setCC.mDst))
-            dstString = asmb::reg_name_to_string(std::get<asmb::Reg>(setCC.mDst).mReg, 
-                                                      asmb::RegisterSize::BYTE);
-        else
-            dstString = std::visit(*this, setCC.mDst);
+    void operator()(const asmb::JmpTable& jmpTable) {
+        // Entries are offsets from the table so it needs no relocations in a PIE
+        if (!std::holds_alternative<asmb::Reg>(jmpTable.mIndex))
+            throw std::runtime_error("JmpTable index must be a register");
+        mJumpTables.push_back(&jmpTable);
 
-        return std::format(
-            "set{} {}",
-            asmb::condition_code_to_string(setCC.mCondCode),
-            dstString);
+        std::string_view index = REGISTER_STRINGS[static_cast<size_t>(std::get<asmb::Reg>(jmpTable.mIndex).mReg)]
+                                                 [static_cast<size_t>(asmb::RegisterSize::QWORD)];
+        append("\tleaq ");
+        appendLabel(jmpTable.mTable);
+        append("(%rip), %r11\n\tmovslq (%r11,");
+        append(index);
+        append(",4), ");
+        append(index);
+        append("\n\taddq %r11, ");
+        append(index);
+        append("\n\tjmp *");
+        append(index);
+        append("\n");
     }
 
-    std::string operator()(const asmb::Label& label) {
-        return std::format(".L{}:", label.mIdentifier);
+    void operator()(const asmb::SetCC& setCC) {
+        // Registers need their 1 byte name
+        append("\tset");
+        appendConditionCode(setCC.mCondCode);
+        append(" ");
+        appendOperand(setCC.mDst, asmb::RegisterSize::BYTE);
+        append("\n");
     }
 
-    std::string operator()(const asmb::Push& push) {
-        std::string pushOperand;
+    void operator()(const asmb::Label& label) {
+        append("\t");
+        appendLabel(label.mIdentifier);
+        append(":\n");
+    }
+
+    void operator()(const asmb::Push& push) {
         // If operand is a register it must use quad alias
-        if (std::holds_alternative<asmb::Reg>(push.mOperand))
-            pushOperand = (*this)(std::get<asmb::Reg>(push.mOperand), asmb::RegisterSize::QWORD);
-        else
-            pushOperand = std::visit(*this, push.mOperand);
-        return "pushq " + pushOperand;
+        append("\tpushq ");
+        appendOperand(push.mOperand, asmb::RegisterSize::QWORD);
+        append("\n");
     }
 
-    std::string operator()(const asmb::Call& call) {
-        if (mSymbolMap.at(call.mFuncName).mDefined)
-            return "call " + call.mFuncName;
-        else
-            return "call " + call.mFuncName + "@PLT";
+    void operator()(const asmb::Pop& pop) {
+        append("\tpopq ");
+        appendRegister(pop.mReg, asmb::RegisterSize::QWORD);
+        append("\n");
+    }
+
+    void operator()(const asmb::Call& call) {
+        append("\tcall ");
+        append(spelling(call.mFuncName));
+        if (!mSymbolMap.at(call.mFuncName).mDefined)
+            append("@PLT");
+        append("\n");
     }
 
     // Function visitor
-    void operator()(const asmb::Function& function, std::stringstream& ss) {   
-        ss << ".globl " << function.mIdentifier << std::endl;
-        ss << function.mIdentifier << ":\n";
-        ss << "\tpushq %rbp\n" << "\tmovq %rsp, %rbp\n";
-        
-        for (auto& instruction : function.mInstructions) {
-            ss << "\t" << std::visit(*this, instruction) << "\n";
+    void operator()(const asmb::Function& function) {
+        std::string_view name = spelling(function.mIdentifier);
+        append(".globl ");
+        append(name);
+        append("\n");
+        append(name);
+        append(":\n\tpushq %rbp\n\tmovq %rsp, %rbp\n");
+
+        mJumpTables.clear();
+        for (auto& instruction : function.mInstructions)
+            std::visit(*this, instruction);
+
+        if (mJumpTables.empty())
+            return;
+        append(".section .rodata\n");
+        for (const asmb::JmpTable* jmpTable : mJumpTables) {
+            append("\t.align 4\n");
+            appendLabel(jmpTable->mTable);
+            append(":\n");
+            for (SymbolId target : jmpTable->mTargets) {
+                append("\t.long ");
+                appendLabel(target);
+                append("-");
+                appendLabel(jmpTable->mTable);
+                append("\n");
+            }
         }
+        append(".text\n");
     }
 
-    // Program
-    std::string operator()(const asmb::Program& program) {
-        std::stringstream ss;
+    // Program visitor, the returned text stays valid until the next call
+    std::string_view operator()(const asmb::Program& program) {
+        // Roughly what an instruction takes, so the buffer rarely has to grow
+        size_t instructionCount = 0;
+        for (auto& function : program.mFunctions)
+            instructionCount += function.mInstructions.size();
+        mBuffer.clear();
+        mBuffer.reserve(instructionCount * 24 + 64);
+
         for (auto& function : program.mFunctions) {
-            (*this)(function, ss);
-            ss << "\n";
+            (*this)(function);
+            append("\n");
         }
-        ss << ".section .note.GNU-stack,\"\",@progbits\n";
-        return ss.str();
+        append(".section .note.GNU-stack,\"\",@progbits\n");
+        return mBuffer;
     }
 };
 
-}
\ No newline at end of file
+}
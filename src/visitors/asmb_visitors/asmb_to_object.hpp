@@ -0,0 +1,712 @@
+#pragma once
+#include "../../ast/ast_asmb.hpp"
+#include "../../ast/general.hpp"
+#include "asmb_to_file.hpp"
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <elf.h>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+
+namespace compiler::codegen {
+
+using namespace ast;
+
+// ------------------------------> Object Code <------------------------------
+// Machine code for a whole program, independent of the file format it ends up in. Every
+// relocation patches a 32 bit field with S + A - P, where S is the target's address, A the addend
+// and P the field's own address.
+
+enum class RelocationTarget {
+    Function,   // a function by name, defined in this program or not
+    Text,       // an offset into mText
+    Rodata      // an offset into mRodata
+};
+
+struct Relocation {
+    uint32_t mOffset;               // of the field, in the section holding it
+    RelocationTarget mTarget;
+    SymbolId mSymbol;               // for RelocationTarget::Function
+    int64_t mAddend;
+};
+
+struct ObjectFunction {
+    SymbolId mName;
+    uint32_t mOffset;
+    uint32_t mSize;
+};
+
+struct ObjectCode {
+    std::vector<uint8_t> mText;
+    std::vector<uint8_t> mRodata;
+    std::vector<Relocation> mTextRelocations;
+    std::vector<Relocation> mRodataRelocations;
+    std::vector<ObjectFunction> mFunctions;
+};
+
+// ------------------------------> Machine Code Encoding <------------------------------
+// Encodes the instructions exactly as EmitAsmbVisitor prints them. A function is first split into
+// pieces: runs of straight line code, labels and branches. Branches start out in their 2 byte short
+// form and the ones whose target turns out to be out of reach of a signed byte are grown to the
+// near form, repeating until no more have to grow, before the pieces are copied into mText.
+
+constexpr uint8_t register_number(asmb::RegisterName reg) {
+    switch (reg) {
+        case asmb::RegisterName::AX:    return 0;
+        case asmb::RegisterName::CX:    return 1;
+        case asmb::RegisterName::DX:    return 2;
+        case asmb::RegisterName::BX:    return 3;
+        case asmb::RegisterName::SI:    return 6;
+        case asmb::RegisterName::DI:    return 7;
+        case asmb::RegisterName::R8:    return 8;
+        case asmb::RegisterName::R9:    return 9;
+        case asmb::RegisterName::R10:   return 10;
+        case asmb::RegisterName::R11:   return 11;
+        case asmb::RegisterName::R12:   return 12;
+        case asmb::RegisterName::R13:   return 13;
+        case asmb::RegisterName::R14:   return 14;
+        case asmb::RegisterName::R15:   return 15;
+    }
+    throw std::invalid_argument("Unhandled RegisterName in register_number");
+}
+
+// Low nibble of the jcc and setcc opcodes
+constexpr uint8_t condition_code_number(asmb::ConditionCode code) {
+    switch (code) {
+        case asmb::ConditionCode::E:    return 0x4;
+        case asmb::ConditionCode::NE:   return 0x5;
+        case asmb::ConditionCode::G:    return 0xF;
+        case asmb::ConditionCode::GE:   return 0xD;
+        case asmb::ConditionCode::L:    return 0xC;
+        case asmb::ConditionCode::LE:   return 0xE;
+        case asmb::ConditionCode::A:    return 0x7;
+    }
+    throw std::invalid_argument("Unhandled ConditionCode in condition_code_number");
+}
+
+constexpr bool fits_int8(int64_t value) {
+    return value >= std::numeric_limits<int8_t>::min() && value <= std::numeric_limits<int8_t>::max();
+}
+
+// Opcodes of the add-like instructions: the ModRM digit with an immediate, then the r/m <- reg
+// and reg <- r/m forms
+struct ArithmeticOpcodes {
+    uint8_t mDigit;
+    uint8_t mStore;
+    uint8_t mLoad;
+};
+
+constexpr ArithmeticOpcodes ADD_OPCODES = {0, 0x01, 0x03};
+constexpr ArithmeticOpcodes OR_OPCODES  = {1, 0x09, 0x0B};
+constexpr ArithmeticOpcodes AND_OPCODES = {4, 0x21, 0x23};
+constexpr ArithmeticOpcodes SUB_OPCODES = {5, 0x29, 0x2B};
+constexpr ArithmeticOpcodes XOR_OPCODES = {6, 0x31, 0x33};
+constexpr ArithmeticOpcodes CMP_OPCODES = {7, 0x39, 0x3B};
+
+struct EncodeAsmbVisitor {
+
+private:
+    // A run of mCode, a label or a branch, in function order
+    struct Piece {
+        enum class Kind { Code, Label, Branch };
+        Kind mKind;
+        uint32_t mBegin = 0;        // Code: range of mCode
+        uint32_t mEnd = 0;
+        SymbolId mLabel;            // Label: its name, Branch: its target
+        int16_t mCondition = -1;    // Branch: condition_code_number, -1 for jmp
+        bool mNear = false;         // Branch: grown to a 32 bit displacement
+    };
+
+    // A relocation whose field is at mCode offset mOffset, moved to its mText offset once laid out
+    struct PendingRelocation {
+        uint32_t mPiece;
+        Relocation mRelocation;
+    };
+
+    // A jump table in mRodata whose entries are filled in once the function is laid out
+    struct PendingTable {
+        uint32_t mOffset;
+        const std::vector<SymbolId>* mTargets;
+    };
+
+    ObjectCode mObject;
+
+    // Per function, kept across functions for reuse
+    std::vector<uint8_t> mCode;
+    std::vector<Piece> mPieces;
+    std::vector<PendingRelocation> mRelocations;
+    std::vector<PendingTable> mTables;
+    SymbolIdMap<uint32_t> mLabelPieces;
+    std::vector<uint32_t> mPieceOffsets;
+
+    // ------------------------------> Bytes <------------------------------
+
+    // Straight line code extends the last piece, or starts a new one after a label or branch
+    void codePiece() {
+        if (mPieces.empty() || mPieces.back().mKind != Piece::Kind::Code)
+            mPieces.push_back(Piece{Piece::Kind::Code, static_cast<uint32_t>(mCode.size()), static_cast<uint32_t>(mCode.size()),
+                                    SymbolId(), -1, false});
+    }
+
+    void byte(uint8_t value) {
+        codePiece();
+        mCode.push_back(value);
+        ++mPieces.back().mEnd;
+    }
+
+    void int32(int32_t value) {
+        uint32_t bits = static_cast<uint32_t>(value);
+        for (int i = 0; i < 4; ++i)
+            byte(static_cast<uint8_t>(bits >> (8 * i)));
+    }
+
+    // A 32 bit field to be relocated, its offset is recorded before it's written
+    void relocatedInt32(RelocationTarget target, SymbolId symbol, int64_t addend) {
+        codePiece();
+        mRelocations.push_back(PendingRelocation{
+            static_cast<uint32_t>(mPieces.size() - 1),
+            Relocation{static_cast<uint32_t>(mCode.size()), target, symbol, addend}
+        });
+        int32(0);
+    }
+
+    // REX prefix, only written when one of its bits is needed or forced for a byte register
+    void rex(bool wide, uint8_t reg, uint8_t index, uint8_t base, bool force = false) {
+        uint8_t bits = (wide ? 8 : 0) | (reg >= 8 ? 4 : 0) | (index >= 8 ? 2 : 0) | (base >= 8 ? 1 : 0);
+        if (bits || force)
+            byte(0x40 | bits);
+    }
+
+    /// @brief Prefix, opcode and ModRM addressing rm, with reg in the ModRM reg field (a register
+    /// number or an opcode digit)
+    void modRM(std::initializer_list<uint8_t> opcode, uint8_t reg, const asmb::Operand& rm,
+               bool wide = false, bool byteRegister = false) {
+        if (auto* regOperand = std::get_if<asmb::Reg>(&rm)) {
+            uint8_t base = register_number(regOperand->mReg);
+            // Without a REX prefix the byte registers 4 to 7 would be ah, ch, dh and bh
+            rex(wide, reg, 0, base, byteRegister && base >= 4 && base < 8);
+            for (uint8_t op : opcode)
+                byte(op);
+            byte(0xC0 | (reg & 7) << 3 | (base & 7));
+        }
+        else if (auto* stack = std::get_if<asmb::Stack>(&rm)) {
+            // disp(%rbp), rbp's number 5 as the base always needs a displacement
+            rex(wide, reg, 0, 5);
+            for (uint8_t op : opcode)
+                byte(op);
+            if (fits_int8(stack->mLocation)) {
+                byte(0x40 | (reg & 7) << 3 | 5);
+                byte(static_cast<uint8_t>(static_cast<int8_t>(stack->mLocation)));
+            }
+            else {
+                byte(0x80 | (reg & 7) << 3 | 5);
+                int32(stack->mLocation);
+            }
+        }
+        else
+            throw std::runtime_error("Operand can't be encoded as a register or memory operand");
+    }
+
+    static uint8_t registerOf(const asmb::Operand& operand) {
+        if (auto* reg = std::get_if<asmb::Reg>(&operand))
+            return register_number(reg->mReg);
+        throw std::runtime_error("Operand must be a register");
+    }
+
+    void arithmetic(const ArithmeticOpcodes& opcodes, const asmb::Operand& src, const asmb::Operand& dst) {
+        if (auto* imm = std::get_if<asmb::Imm>(&src)) {
+            if (fits_int8(imm->mValue)) {
+                modRM({0x83}, opcodes.mDigit, dst);
+                byte(static_cast<uint8_t>(static_cast<int8_t>(imm->mValue)));
+            }
+            else if (auto* reg = std::get_if<asmb::Reg>(&dst); reg && reg->mReg == asmb::RegisterName::AX) {
+                // op $imm32, %eax has its own opcode without a ModRM byte
+                byte(opcodes.mStore + 4);
+                int32(imm->mValue);
+            }
+            else {
+                modRM({0x81}, opcodes.mDigit, dst);
+                int32(imm->mValue);
+            }
+        }
+        else if (std::holds_alternative<asmb::Reg>(src))
+            modRM({opcodes.mStore}, registerOf(src), dst);
+        else
+            modRM({opcodes.mLoad}, registerOf(dst), src);
+    }
+
+    // addq or subq with an immediate on %rsp, which has no RegisterName
+    void stackAdjustment(uint8_t digit, uint32_t value) {
+        int32_t immediate = static_cast<int32_t>(value);
+        byte(0x48);
+        byte(fits_int8(immediate) ? 0x83 : 0x81);
+        byte(0xC0 | digit << 3 | 4);
+        if (fits_int8(immediate))
+            byte(static_cast<uint8_t>(static_cast<int8_t>(immediate)));
+        else
+            int32(immediate);
+    }
+
+    void branch(SymbolId target, int16_t condition) {
+        mPieces.push_back(Piece{Piece::Kind::Branch, 0, 0, target, condition, false});
+    }
+
+    // ------------------------------> Layout <------------------------------
+
+    static uint32_t pieceSize(const Piece& piece) {
+        switch (piece.mKind) {
+            case Piece::Kind::Code:     return piece.mEnd - piece.mBegin;
+            case Piece::Kind::Label:    return 0;
+            case Piece::Kind::Branch:   return !piece.mNear ? 2 : piece.mCondition < 0 ? 5 : 6;
+        }
+        return 0;
+    }
+
+    uint32_t labelOffset(SymbolId label) const {
+        return mPieceOffsets[mLabelPieces.at(label)];
+    }
+
+    /// @brief Gives every piece its offset in mText, growing branches until all reach their targets
+    void layout(uint32_t start) {
+        mPieceOffsets.resize(mPieces.size());
+        bool grown = true;
+        while (grown) {
+            grown = false;
+            uint32_t offset = start;
+            for (size_t i = 0; i < mPieces.size(); ++i) {
+                mPieceOffsets[i] = offset;
+                offset += pieceSize(mPieces[i]);
+            }
+            // Growing a branch only moves later pieces further away, so this always settles
+            for (size_t i = 0; i < mPieces.size(); ++i) {
+                Piece& piece = mPieces[i];
+                if (piece.mKind != Piece::Kind::Branch || piece.mNear)
+                    continue;
+                int64_t displacement = static_cast<int64_t>(labelOffset(piece.mLabel)) - (mPieceOffsets[i] + 2);
+                if (!fits_int8(displacement)) {
+                    piece.mNear = true;
+                    grown = true;
+                }
+            }
+        }
+    }
+
+    void appendText(uint8_t value) {
+        mObject.mText.push_back(value);
+    }
+
+    void appendText32(int32_t value) {
+        uint32_t bits = static_cast<uint32_t>(value);
+        for (int i = 0; i < 4; ++i)
+            appendText(static_cast<uint8_t>(bits >> (8 * i)));
+    }
+
+    void copyPieces() {
+        for (size_t i = 0; i < mPieces.size(); ++i) {
+            const Piece& piece = mPieces[i];
+            if (piece.mKind == Piece::Kind::Code)
+                mObject.mText.insert(mObject.mText.end(), mCode.begin() + piece.mBegin, mCode.begin() + piece.mEnd);
+            else if (piece.mKind == Piece::Kind::Branch) {
+                int64_t end = mPieceOffsets[i] + pieceSize(piece);
+                int64_t displacement = static_cast<int64_t>(labelOffset(piece.mLabel)) - end;
+                if (!piece.mNear) {
+                    appendText(piece.mCondition < 0 ? 0xEB : 0x70 | piece.mCondition);
+                    appendText(static_cast<uint8_t>(static_cast<int8_t>(displacement)));
+                }
+                else {
+                    if (piece.mCondition < 0)
+                        appendText(0xE9);
+                    else {
+                        appendText(0x0F);
+                        appendText(0x80 | piece.mCondition);
+                    }
+                    appendText32(static_cast<int32_t>(displacement));
+                }
+            }
+        }
+
+        for (const auto& pending : mRelocations) {
+            Relocation relocation = pending.mRelocation;
+            relocation.mOffset = mPieceOffsets[pending.mPiece] + (relocation.mOffset - mPieces[pending.mPiece].mBegin);
+            mObject.mTextRelocations.push_back(relocation);
+        }
+
+        // Entry i of a table holds target - table, which is target + 4 * i - (address of entry i)
+        for (const auto& table : mTables) {
+            for (size_t i = 0; i < table.mTargets->size(); ++i) {
+                mObject.mRodataRelocations.push_back(Relocation{
+                    static_cast<uint32_t>(table.mOffset + 4 * i),
+                    RelocationTarget::Text,
+                    SymbolId(),
+                    static_cast<int64_t>(labelOffset((*table.mTargets)[i])) + static_cast<int64_t>(4 * i)
+                });
+            }
+        }
+    }
+
+public:
+    // Instruction visitors
+    void operator()(const asmb::Mov& mov) {
+        if (auto* imm = std::get_if<asmb::Imm>(&mov.mSrc)) {
+            if (auto* reg = std::get_if<asmb::Reg>(&mov.mDst)) {
+                uint8_t number = register_number(reg->mReg);
+                rex(false, 0, 0, number);
+                byte(0xB8 | (number & 7));
+            }
+            else
+                modRM({0xC7}, 0, mov.mDst);
+            int32(imm->mValue);
+        }
+        else if (std::holds_alternative<asmb::Reg>(mov.mSrc))
+            modRM({0x89}, registerOf(mov.mSrc), mov.mDst);
+        else
+            modRM({0x8B}, registerOf(mov.mDst), mov.mSrc);
+    }
+
+    void operator()(const asmb::Unary& unary) {
+        switch (unary.mOp) {
+            case asmb::UnaryOperator::Complement:   modRM({0xF7}, 2, unary.mOperand); break;
+            case asmb::UnaryOperator::Negate:       modRM({0xF7}, 3, unary.mOperand); break;
+            case asmb::UnaryOperator::Increment:    modRM({0xFF}, 0, unary.mOperand); break;
+            case asmb::UnaryOperator::Decrement:    modRM({0xFF}, 1, unary.mOperand); break;
+        }
+    }
+
+    void operator()(const asmb::Binary& binary) {
+        switch (binary.mOp) {
+            case asmb::BinaryOperator::Add:         arithmetic(ADD_OPCODES, binary.mOperand1, binary.mOperand2); break;
+            case asmb::BinaryOperator::Subtract:    arithmetic(SUB_OPCODES, binary.mOperand1, binary.mOperand2); break;
+            case asmb::BinaryOperator::Bitwise_AND: arithmetic(AND_OPCODES, binary.mOperand1, binary.mOperand2); break;
+            case asmb::BinaryOperator::Bitwise_OR:  arithmetic(OR_OPCODES, binary.mOperand1, binary.mOperand2); break;
+            case asmb::BinaryOperator::Bitwise_XOR: arithmetic(XOR_OPCODES, binary.mOperand1, binary.mOperand2); break;
+            case asmb::BinaryOperator::Multiply: {
+                // The destination is always a register after FixUpAsmbInstructions
+                uint8_t dst = registerOf(binary.mOperand2);
+                if (auto* imm = std::get_if<asmb::Imm>(&binary.mOperand1)) {
+                    if (fits_int8(imm->mValue)) {
+                        modRM({0x6B}, dst, binary.mOperand2);
+                        byte(static_cast<uint8_t>(static_cast<int8_t>(imm->mValue)));
+                    }
+                    else {
+                        modRM({0x69}, dst, binary.mOperand2);
+                        int32(imm->mValue);
+                    }
+                }
+                else
+                    modRM({0x0F, 0xAF}, dst, binary.mOperand1);
+                break;
+            }
+            case asmb::BinaryOperator::Left_Shift:
+            case asmb::BinaryOperator::Right_Shift: {
+                uint8_t digit = binary.mOp == asmb::BinaryOperator::Left_Shift ? 4 : 7;
+                auto* count = std::get_if<asmb::Imm>(&binary.mOperand1);
+                if (count && count->mValue == 1)
+                    modRM({0xD1}, digit, binary.mOperand2);
+                else if (count) {
+                    modRM({0xC1}, digit, binary.mOperand2);
+                    byte(static_cast<uint8_t>(count->mValue));
+                }
+                else    // count in %cl
+                    modRM({0xD3}, digit, binary.mOperand2);
+                break;
+            }
+        }
+    }
+
+    void operator()(const asmb::Idiv& idiv) {
+        modRM({0xF7}, 7, idiv.mOperand);
+    }
+
+    void operator()(const asmb::Imul& imul) {
+        modRM({0xF7}, 5, imul.mOperand);
+    }
+
+    void operator()(const asmb::Cdq&) {
+        byte(0x99);
+    }
+
+    void operator()(const asmb::AllocateStack& allocateStack) {
+        // subq $n, %rsp
+        stackAdjustment(5, allocateStack.mValue);
+    }
+
+    void operator()(const asmb::DeallocateStack& deallocateStack) {
+        // addq $n, %rsp
+        stackAdjustment(0, deallocateStack.mValue);
+    }
+
+    void operator()(const asmb::Cmp& cmp) {
+        arithmetic(CMP_OPCODES, cmp.mOperand1, cmp.mOperand2);
+    }
+
+    void operator()(const asmb::Jmp& jmp) {
+        branch(jmp.mIdentifier, -1);
+    }
+
+    void operator()(const asmb::JmpCC& jmpCC) {
+        branch(jmpCC.mIdentifier, condition_code_number(jmpCC.mCondCode));
+    }
+
+    void operator()(const asmb::JmpTable& jmpTable) {
+        uint8_t index = registerOf(jmpTable.mIndex);
+        if (index == 4)
+            throw std::runtime_error("JmpTable index can't be encoded in a SIB byte");
+
+        // The table is placed now and its entries written once the function has been laid out
+        while (mObject.mRodata.size() % 4)
+            mObject.mRodata.push_back(0);
+        uint32_t table = static_cast<uint32_t>(mObject.mRodata.size());
+        mObject.mRodata.resize(table + 4 * jmpTable.mTargets.size(), 0);
+        mTables.push_back(PendingTable{table, &jmpTable.mTargets});
+
+        // leaq table(%rip), %r11
+        byte(0x4C); byte(0x8D); byte(0x1D);
+        relocatedInt32(RelocationTarget::Rodata, SymbolId(), static_cast<int64_t>(table) - 4);
+        // movslq (%r11,index,4), index
+        rex(true, index, index, 11);
+        byte(0x63);
+        byte(0x04 | (index & 7) << 3);
+        byte(0x80 | (index & 7) << 3 | 3);
+        // addq %r11, index
+        rex(true, 11, 0, index);
+        byte(0x01);
+        byte(0xC0 | 3 << 3 | (index & 7));
+        // jmp *index
+        rex(false, 0, 0, index);
+        byte(0xFF);
+        byte(0xC0 | 4 << 3 | (index & 7));
+    }
+
+    void operator()(const asmb::SetCC& setCC) {
+        modRM({0x0F, static_cast<uint8_t>(0x90 | condition_code_number(setCC.mCondCode))}, 0, setCC.mDst, false, true);
+    }
+
+    void operator()(const asmb::Label& label) {
+        mLabelPieces.insert_or_assign(label.mIdentifier, static_cast<uint32_t>(mPieces.size()));
+        mPieces.push_back(Piece{Piece::Kind::Label, 0, 0, label.mIdentifier, -1, false});
+    }
+
+    void operator()(const asmb::Push& push) {
+        if (auto* imm = std::get_if<asmb::Imm>(&push.mOperand)) {
+            byte(0x68);
+            int32(imm->mValue);
+        }
+        else if (auto* reg = std::get_if<asmb::Reg>(&push.mOperand)) {
+            uint8_t number = register_number(reg->mReg);
+            rex(false, 0, 0, number);
+            byte(0x50 | (number & 7));
+        }
+        else
+            modRM({0xFF}, 6, push.mOperand);
+    }
+
+    void operator()(const asmb::Pop& pop) {
+        uint8_t number = register_number(pop.mReg);
+        rex(false, 0, 0, number);
+        byte(0x58 | (number & 7));
+    }
+
+    void operator()(const asmb::Call& call) {
+        byte(0xE8);
+        relocatedInt32(RelocationTarget::Function, call.mFuncName, -4);
+    }
+
+    void operator()(const asmb::Ret&) {
+        // movq %rbp, %rsp; popq %rbp; ret
+        byte(0x48); byte(0x89); byte(0xEC);
+        byte(0x5D);
+        byte(0xC3);
+    }
+
+    // Function visitor
+    void operator()(const asmb::Function& function) {
+        mCode.clear();
+        mPieces.clear();
+        mRelocations.clear();
+        mTables.clear();
+        mLabelPieces.clear();
+
+        // pushq %rbp; movq %rsp, %rbp
+        byte(0x55);
+        byte(0x48); byte(0x89); byte(0xE5);
+        for (const auto& instruction : function.mInstructions)
+            std::visit(*this, instruction);
+
+        uint32_t start = static_cast<uint32_t>(mObject.mText.size());
+        layout(start);
+        copyPieces();
+        mObject.mFunctions.push_back(ObjectFunction{
+            function.mIdentifier, start, static_cast<uint32_t>(mObject.mText.size()) - start
+        });
+    }
+
+    // Program visitor
+    ObjectCode operator()(const asmb::Program& program) {
+        mObject = ObjectCode();
+        for (const auto& function : program.mFunctions)
+            (*this)(function);
+        return std::move(mObject);
+    }
+};
+
+// ------------------------------> ELF Object Writer <------------------------------
+// Writes an x86-64 ELF relocatable object with the sections
+//   .text .rodata .rela.text .rela.rodata .symtab .strtab .shstrtab .note.GNU-stack
+// Calls are R_X86_64_PLT32 relocations against the callee's global symbol, like the GNU assembler
+// emits them, and references into .text or .rodata are R_X86_64_PC32 against the section symbol.
+
+struct ElfObjectWriter {
+    std::string mBuffer;
+
+    template<typename T>
+    void append(const T& value) {
+        mBuffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void appendBytes(const std::vector<uint8_t>& bytes) {
+        mBuffer.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    void align(size_t alignment) {
+        while (mBuffer.size() % alignment)
+            mBuffer.push_back(0);
+    }
+
+    static uint32_t addString(std::string& table, std::string_view string) {
+        uint32_t offset = static_cast<uint32_t>(table.size());
+        table.append(string);
+        table.push_back('\0');
+        return offset;
+    }
+
+    std::string_view operator()(const ObjectCode& object) {
+        enum Section : uint16_t { Null, Text, Rodata, RelaText, RelaRodata, Symtab, Strtab, Shstrtab, NoteStack, Count };
+        // Symbols 1 and 2 are the .text and .rodata section symbols, globals follow
+        constexpr uint32_t TEXT_SYMBOL = 1;
+        constexpr uint32_t RODATA_SYMBOL = 2;
+        constexpr uint32_t FIRST_GLOBAL = 3;
+
+        // Section names
+        std::string sectionNames(1, '\0');
+        std::array<uint32_t, Count> nameOffsets{};
+        nameOffsets[Text] = addString(sectionNames, ".text");
+        nameOffsets[Rodata] = addString(sectionNames, ".rodata");
+        nameOffsets[RelaText] = addString(sectionNames, ".rela.text");
+        nameOffsets[RelaRodata] = addString(sectionNames, ".rela.rodata");
+        nameOffsets[Symtab] = addString(sectionNames, ".symtab");
+        nameOffsets[Strtab] = addString(sectionNames, ".strtab");
+        nameOffsets[Shstrtab] = addString(sectionNames, ".shstrtab");
+        nameOffsets[NoteStack] = addString(sectionNames, ".note.GNU-stack");
+
+        // Symbols, the defined functions then every function only called
+        std::string names(1, '\0');
+        std::vector<Elf64_Sym> symbols(FIRST_GLOBAL);
+        symbols[TEXT_SYMBOL].st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+        symbols[TEXT_SYMBOL].st_shndx = Text;
+        symbols[RODATA_SYMBOL].st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+        symbols[RODATA_SYMBOL].st_shndx = Rodata;
+
+        SymbolIdMap<uint32_t> symbolIndices;
+        for (const auto& function : object.mFunctions) {
+            Elf64_Sym symbol{};
+            symbol.st_name = addString(names, spelling(function.mName));
+            symbol.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+            symbol.st_shndx = Text;
+            symbol.st_value = function.mOffset;
+            symbol.st_size = function.mSize;
+            symbolIndices.insert_or_assign(function.mName, static_cast<uint32_t>(symbols.size()));
+            symbols.push_back(symbol);
+        }
+        for (const auto& relocation : object.mTextRelocations) {
+            if (relocation.mTarget != RelocationTarget::Function || symbolIndices.contains(relocation.mSymbol))
+                continue;
+            Elf64_Sym symbol{};
+            symbol.st_name = addString(names, spelling(relocation.mSymbol));
+            symbol.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+            symbol.st_shndx = SHN_UNDEF;
+            symbolIndices.insert_or_assign(relocation.mSymbol, static_cast<uint32_t>(symbols.size()));
+            symbols.push_back(symbol);
+        }
+
+        auto relocationEntries = [&](const std::vector<Relocation>& relocations) {
+            std::vector<Elf64_Rela> entries;
+            entries.reserve(relocations.size());
+            for (const auto& relocation : relocations) {
+                uint32_t symbol = relocation.mTarget == RelocationTarget::Function ? symbolIndices.at(relocation.mSymbol)
+                                : relocation.mTarget == RelocationTarget::Text ? TEXT_SYMBOL : RODATA_SYMBOL;
+                uint32_t type = relocation.mTarget == RelocationTarget::Function ? R_X86_64_PLT32 : R_X86_64_PC32;
+                entries.push_back(Elf64_Rela{relocation.mOffset, ELF64_R_INFO(symbol, type), relocation.mAddend});
+            }
+            return entries;
+        };
+        auto textRelocations = relocationEntries(object.mTextRelocations);
+        auto rodataRelocations = relocationEntries(object.mRodataRelocations);
+
+        // Contents follow the header, each section starting at its alignment
+        std::array<Elf64_Shdr, Count> headers{};
+        mBuffer.clear();
+        mBuffer.resize(sizeof(Elf64_Ehdr), '\0');
+
+        auto place = [&](Section section, uint32_t type, uint64_t flags, size_t alignment, auto&& writeContents) {
+            align(alignment);
+            size_t begin = mBuffer.size();
+            writeContents();
+            Elf64_Shdr& header = headers[section];
+            header.sh_name = nameOffsets[section];
+            header.sh_type = type;
+            header.sh_flags = flags;
+            header.sh_offset = begin;
+            header.sh_size = mBuffer.size() - begin;
+            header.sh_addralign = alignment;
+        };
+
+        place(Text, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 16, [&] { appendBytes(object.mText); });
+        place(Rodata, SHT_PROGBITS, SHF_ALLOC, 4, [&] { appendBytes(object.mRodata); });
+        place(RelaText, SHT_RELA, SHF_INFO_LINK, 8, [&] { for (auto& entry : textRelocations) append(entry); });
+        place(RelaRodata, SHT_RELA, SHF_INFO_LINK, 8, [&] { for (auto& entry : rodataRelocations) append(entry); });
+        place(Symtab, SHT_SYMTAB, 0, 8, [&] { for (auto& symbol : symbols) append(symbol); });
+        place(Strtab, SHT_STRTAB, 0, 1, [&] { mBuffer.append(names); });
+        place(Shstrtab, SHT_STRTAB, 0, 1, [&] { mBuffer.append(sectionNames); });
+        place(NoteStack, SHT_PROGBITS, 0, 1, [] {});
+
+        headers[RelaText].sh_link = Symtab;
+        headers[RelaText].sh_info = Text;
+        headers[RelaText].sh_entsize = sizeof(Elf64_Rela);
+        headers[RelaRodata].sh_link = Symtab;
+        headers[RelaRodata].sh_info = Rodata;
+        headers[RelaRodata].sh_entsize = sizeof(Elf64_Rela);
+        headers[Symtab].sh_link = Strtab;
+        headers[Symtab].sh_info = FIRST_GLOBAL;     // index of the first non-local symbol
+        headers[Symtab].sh_entsize = sizeof(Elf64_Sym);
+
+        align(8);
+        size_t sectionHeaders = mBuffer.size();
+        for (const auto& header : headers)
+            append(header);
+
+        Elf64_Ehdr elfHeader{};
+        std::memcpy(elfHeader.e_ident, ELFMAG, SELFMAG);
+        elfHeader.e_ident[EI_CLASS] = ELFCLASS64;
+        elfHeader.e_ident[EI_DATA] = ELFDATA2LSB;
+        elfHeader.e_ident[EI_VERSION] = EV_CURRENT;
+        elfHeader.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+        elfHeader.e_type = ET_REL;
+        elfHeader.e_machine = EM_X86_64;
+        elfHeader.e_version = EV_CURRENT;
+        elfHeader.e_shoff = sectionHeaders;
+        elfHeader.e_ehsize = sizeof(Elf64_Ehdr);
+        elfHeader.e_shentsize = sizeof(Elf64_Shdr);
+        elfHeader.e_shnum = Count;
+        elfHeader.e_shstrndx = Shstrtab;
+        std::memcpy(mBuffer.data(), &elfHeader, sizeof(elfHeader));
+
+        return mBuffer;
+    }
+};
+
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include "../../ast/general.hpp"
+#include "asmb_to_object.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <dlfcn.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+
+namespace compiler::codegen {
+
+using namespace ast;
+
+// ------------------------------> Executable Image <------------------------------
+// Loads an ObjectCode into this process so its functions can be called directly. The image is
+//   .text | stubs | .rodata
+// with .rodata starting on its own page. Calls between compiled functions are patched to their
+// targets, calls to anything else go through a stub jumping to the address dlsym finds for the
+// name, as libc is usually mapped too far away for a 32 bit displacement. Everything is written
+// while the pages are read-write, then the code pages become read-execute and .rodata read-only.
+
+class ExecutableImage {
+private:
+    // jmp *0(%rip) followed by the absolute target, padded to 16 bytes
+    static constexpr size_t STUB_SIZE = 16;
+
+    uint8_t* mMemory = nullptr;
+    size_t mSize = 0;
+    SymbolIdMap<uint32_t> mFunctions;   // offsets into the image
+
+    static size_t pageAlign(size_t size, size_t pageSize) {
+        return (size + pageSize - 1) / pageSize * pageSize;
+    }
+
+    static void* resolveExternal(SymbolId name) {
+        std::string symbol(spelling(name));
+        void* address = ::dlsym(RTLD_DEFAULT, symbol.c_str());
+        if (!address)
+            throw std::runtime_error("Undefined reference to " + symbol);
+        return address;
+    }
+
+    static void patch(uint8_t* field, int64_t value) {
+        if (value < INT32_MIN || value > INT32_MAX)
+            throw std::runtime_error("Relocation doesn't fit in 32 bits");
+        int32_t narrowed = static_cast<int32_t>(value);
+        std::memcpy(field, &narrowed, sizeof(narrowed));
+    }
+
+public:
+    explicit ExecutableImage(const ObjectCode& object) {
+        for (const auto& function : object.mFunctions)
+            mFunctions.insert_or_assign(function.mName, function.mOffset);
+
+        // One stub per external callee, in first call order
+        SymbolIdMap<uint32_t> stubs;
+        std::vector<void*> externals;
+        for (const auto& relocation : object.mTextRelocations) {
+            if (relocation.mTarget != RelocationTarget::Function || mFunctions.contains(relocation.mSymbol)
+                || stubs.contains(relocation.mSymbol))
+                continue;
+            stubs.insert_or_assign(relocation.mSymbol, static_cast<uint32_t>(externals.size()));
+            externals.push_back(resolveExternal(relocation.mSymbol));
+        }
+
+        size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        size_t stubsOffset = pageAlign(object.mText.size(), STUB_SIZE);
+        size_t codeSize = pageAlign(stubsOffset + externals.size() * STUB_SIZE, pageSize);
+        size_t rodataSize = pageAlign(object.mRodata.size(), pageSize);
+        mSize = std::max(codeSize + rodataSize, pageSize);
+
+        void* memory = ::mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            throw std::runtime_error("Failed to map memory for the executable image");
+        mMemory = static_cast<uint8_t*>(memory);
+
+        // The destructor doesn't run if the constructor throws
+        try {
+            uint8_t* text = mMemory;
+            uint8_t* rodata = mMemory + codeSize;
+            std::memcpy(text, object.mText.data(), object.mText.size());
+            if (!object.mRodata.empty())
+                std::memcpy(rodata, object.mRodata.data(), object.mRodata.size());
+
+            for (size_t i = 0; i < externals.size(); ++i) {
+                uint8_t* stub = text + stubsOffset + i * STUB_SIZE;
+                const uint8_t jump[] = {0xFF, 0x25, 0x00, 0x00, 0x00, 0x00};
+                std::memcpy(stub, jump, sizeof(jump));
+                std::memcpy(stub + sizeof(jump), &externals[i], sizeof(void*));
+            }
+
+            auto targetAddress = [&](const Relocation& relocation) -> uint8_t* {
+                switch (relocation.mTarget) {
+                    case RelocationTarget::Function:
+                        if (mFunctions.contains(relocation.mSymbol))
+                            return text + mFunctions.at(relocation.mSymbol);
+                        return text + stubsOffset + stubs.at(relocation.mSymbol) * STUB_SIZE;
+                    case RelocationTarget::Text:    return text;
+                    case RelocationTarget::Rodata:  return rodata;
+                }
+                throw std::invalid_argument("Unhandled RelocationTarget in ExecutableImage");
+            };
+            // S + A - P
+            auto relocate = [&](uint8_t* section, const std::vector<Relocation>& relocations) {
+                for (const auto& relocation : relocations) {
+                    uint8_t* field = section + relocation.mOffset;
+                    patch(field, reinterpret_cast<intptr_t>(targetAddress(relocation)) + relocation.mAddend
+                                 - reinterpret_cast<intptr_t>(field));
+                }
+            };
+            relocate(text, object.mTextRelocations);
+            relocate(rodata, object.mRodataRelocations);
+
+            if (::mprotect(text, codeSize, PROT_READ | PROT_EXEC) != 0
+                || (rodataSize && ::mprotect(rodata, rodataSize, PROT_READ) != 0))
+                throw std::runtime_error("Failed to make the executable image executable");
+        } catch (...) {
+            ::munmap(mMemory, mSize);
+            throw;
+        }
+    }
+
+    ~ExecutableImage() {
+        if (mMemory)
+            ::munmap(mMemory, mSize);
+    }
+
+    ExecutableImage(const ExecutableImage&) = delete;
+    ExecutableImage& operator=(const ExecutableImage&) = delete;
+
+    ExecutableImage(ExecutableImage&& other) noexcept
+        : mMemory(std::exchange(other.mMemory, nullptr)), mSize(std::exchange(other.mSize, 0)),
+          mFunctions(std::move(other.mFunctions)) {}
+
+    ExecutableImage& operator=(ExecutableImage&& other) noexcept {
+        if (this != &other) {
+            if (mMemory)
+                ::munmap(mMemory, mSize);
+            mMemory = std::exchange(other.mMemory, nullptr);
+            mSize = std::exchange(other.mSize, 0);
+            mFunctions = std::move(other.mFunctions);
+        }
+        return *this;
+    }
+
+    /// @brief Address of a compiled function, nullptr if the program doesn't define it. The image is
+    /// keyed by SymbolIds, so it must be used within the InternerScope it was compiled in.
+    void* address(SymbolId function) const {
+        if (!mFunctions.contains(function))
+            return nullptr;
+        return mMemory + mFunctions.at(function);
+    }
+
+    /// @brief Calls the program's main and returns its result
+    int runMain() const {
+        void* main = address(intern("main"));
+        if (!main)
+            throw std::runtime_error("Program doesn't define main");
+        return reinterpret_cast<int (*)()>(main)();
+    }
+};
+
+}
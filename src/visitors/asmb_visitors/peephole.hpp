@@ -0,0 +1,354 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+#include "../../ast/ast_asmb.hpp"
+
+namespace compiler::codegen {
+
+using namespace ast;
+
+// ------------------------------> Peephole Optimization <------------------------------
+// Runs after FixUpAsmbInstructions, when every operand is a register, stack slot or immediate. A
+// window slides over each function's instructions and the first enabled rule matching the window
+// replaces it. Sweeps repeat until nothing matches, as one rewrite can set up another.
+//
+// Some rewrites change which flags are set, those look ahead to the flags still read afterwards.
+// Code generation only reads the flags set just before by the same TACKY instruction and never
+// carries them across a label, so a Label or jump ends the look ahead.
+
+// ------------------------------> Operands and Flags <------------------------------
+
+inline bool same_operand(const asmb::Operand& a, const asmb::Operand& b) {
+    if (a.index() != b.index())
+        return false;
+    return std::visit([&](const auto& operand) {
+        using T = std::decay_t<decltype(operand)>;
+        const T& other = std::get<T>(b);
+        if constexpr (std::is_same_v<T, asmb::Imm>)
+            return operand.mValue == other.mValue;
+        else if constexpr (std::is_same_v<T, asmb::Reg>)
+            return operand.mReg == other.mReg;
+        else if constexpr (std::is_same_v<T, asmb::Pseudo>)
+            return operand.mName == other.mName;
+        else
+            return operand.mLocation == other.mLocation;
+    }, a);
+}
+
+inline bool is_imm(const asmb::Operand& operand, int32_t value) {
+    auto* imm = std::get_if<asmb::Imm>(&operand);
+    return imm && imm->mValue == value;
+}
+
+// Groups of flags, by the condition codes reading them
+constexpr uint8_t FLAG_ZERO = 1;            // ZF
+constexpr uint8_t FLAG_SIGN_OVERFLOW = 2;   // SF and OF
+constexpr uint8_t FLAG_CARRY = 4;           // CF
+constexpr uint8_t FLAG_ALL = FLAG_ZERO | FLAG_SIGN_OVERFLOW | FLAG_CARRY;
+
+constexpr uint8_t flags_read_by(asmb::ConditionCode code) {
+    switch (code) {
+        case asmb::ConditionCode::E:
+        case asmb::ConditionCode::NE:   return FLAG_ZERO;
+        case asmb::ConditionCode::G:
+        case asmb::ConditionCode::GE:
+        case asmb::ConditionCode::L:
+        case asmb::ConditionCode::LE:   return FLAG_ZERO | FLAG_SIGN_OVERFLOW;
+        case asmb::ConditionCode::A:    return FLAG_ZERO | FLAG_CARRY;
+    }
+    return FLAG_ALL;
+}
+
+/// @brief Flags an instruction sets, a shift by %cl sets nothing when the count is zero
+inline uint8_t flags_written_by(const asmb::Instruction& instruction) {
+    return std::visit([](const auto& inst) -> uint8_t {
+        using T = std::decay_t<decltype(inst)>;
+        if constexpr (std::is_same_v<T, asmb::Binary>) {
+            if (inst.mOp != asmb::BinaryOperator::Left_Shift && inst.mOp != asmb::BinaryOperator::Right_Shift)
+                return FLAG_ALL;
+            auto* count = std::get_if<asmb::Imm>(&inst.mOperand1);
+            return count && count->mValue % 32 != 0 ? FLAG_ALL : 0;
+        }
+        else if constexpr (std::is_same_v<T, asmb::Unary>) {
+            switch (inst.mOp) {
+                case asmb::UnaryOperator::Complement:   return 0;
+                case asmb::UnaryOperator::Negate:       return FLAG_ALL;
+                case asmb::UnaryOperator::Increment:
+                case asmb::UnaryOperator::Decrement:    return FLAG_ZERO | FLAG_SIGN_OVERFLOW;
+            }
+            return 0;
+        }
+        // Idiv, Imul and Call leave the flags undefined, the stack adjustments are an addq or subq
+        else if constexpr (std::is_same_v<T, asmb::Cmp> || std::is_same_v<T, asmb::Idiv> || std::is_same_v<T, asmb::Imul>
+                        || std::is_same_v<T, asmb::Call>
+                        || std::is_same_v<T, asmb::AllocateStack> || std::is_same_v<T, asmb::DeallocateStack>)
+            return FLAG_ALL;
+        else
+            return 0;
+    }, instruction);
+}
+
+/// @brief Flags read by the instructions in after before they're set again
+inline uint8_t flags_read(std::span<const asmb::Instruction> after) {
+    uint8_t pending = FLAG_ALL;
+    uint8_t read = 0;
+    for (const auto& instruction : after) {
+        if (auto* jmpCC = std::get_if<asmb::JmpCC>(&instruction))
+            read |= flags_read_by(jmpCC->mCondCode) & pending;
+        else if (auto* setCC = std::get_if<asmb::SetCC>(&instruction))
+            read |= flags_read_by(setCC->mCondCode) & pending;
+        else if (std::holds_alternative<asmb::Label>(instruction) || std::holds_alternative<asmb::Jmp>(instruction)
+              || std::holds_alternative<asmb::JmpTable>(instruction) || std::holds_alternative<asmb::Ret>(instruction))
+            break;
+
+        pending &= ~flags_written_by(instruction);
+        if (!pending)
+            break;
+    }
+    return read;
+}
+
+// ------------------------------> Rules <------------------------------
+// Each rule matches a fixed size window, given the instructions after it to look ahead into. On a
+// match it appends the replacement to out and returns true.
+
+using PeepholeRewrite = bool (*)(std::span<const asmb::Instruction> window,
+                                 std::span<const asmb::Instruction> after,
+                                 std::vector<asmb::Instruction>& out);
+
+struct PeepholeRule {
+    std::string_view mName;
+    size_t mWindow;
+    PeepholeRewrite mRewrite;
+};
+
+// movl X, X
+inline bool rewrite_self_move(std::span<const asmb::Instruction> window, std::span<const asmb::Instruction>,
+                              std::vector<asmb::Instruction>&) {
+    auto* mov = std::get_if<asmb::Mov>(&window[0]);
+    return mov && same_operand(mov->mSrc, mov->mDst);
+}
+
+// movl A, B; movl B, A -> movl A, B
+inline bool rewrite_redundant_load(std::span<const asmb::Instruction> window, std::span<const asmb::Instruction>,
+                                   std::vector<asmb::Instruction>& out) {
+    auto* first = std::get_if<asmb::Mov>(&window[0]);
+    auto* second = std::get_if<asmb::Mov>(&window[1]);
+    if (!first || !second || !same_operand(first->mSrc, second->mDst) || !same_operand(first->mDst, second->mSrc))
+        return false;
+    out.push_back(*first);
+    return true;
+}
+
+// movl %r, -8(%rbp); movl -8(%rbp), %s -> movl %r, -8(%rbp); movl %r, %s
+inline bool rewrite_forward_store(std::span<const asmb::Instruction> window, std::span<const asmb::Instruction>,
+                                  std::vector<asmb::Instruction>& out) {
+    auto* store = std::get_if<asmb::Mov>(&window[0]);
+    auto* load = std::get_if<asmb::Mov>(&window[1]);
+    if (!store || !load || !std::holds_alternative<asmb::Stack>(store->mDst)
+        || std::holds_alternative<asmb::Stack>(store->mSrc)
+        || !same_operand(store->mDst, load->mSrc) || !std::holds_alternative<asmb::Reg>(load->mDst))
+        return false;
+    out.push_back(*store);
+    out.push_back(asmb::Mov(store->mSrc, load->mDst));
+    return true;
+}
+
+// movl A, X; movl B, X -> movl B, X
+inline bool rewrite_dead_store(std::span<const asmb::Instruction> window, std::span<const asmb::Instruction>,
+                               std::vector<asmb::Instruction>& out) {
+    auto* first = std::get_if<asmb::Mov>(&window[0]);
+    auto* second = std::get_if<asmb::Mov>(&window[1]);
+    if (!first || !second || !same_operand(first->mDst, second->mDst) || same_operand(second->mSrc, second->mDst))
+        return false;
+    out.push_back(*second);
+    return true;
+}
+
+// addl/subl/andl/orl/xorl/negl/incl/decl X; cmpl $0, X -> the first alone, if only ZF is read
+inline bool rewrite_compare_zero(std::span<const asmb::Instruction> window, std::span<const asmb::Instruction> after,
+                                 std::vector<asmb::Instruction>& out) {
+    auto* cmp = std::get_if<asmb::Cmp>(&window[1]);
+    if (!cmp || !is_imm(cmp->mOperand1, 0))
+        return false;
+
+    const asmb::Operand* result = nullptr;
+    if (auto* binary = std::get_if<asmb::Binary>(&window[0])) {
+        switch (binary->mOp) {
+            case asmb::BinaryOperator::Add:
+            case asmb::BinaryOperator::Subtract:
+            case asmb::BinaryOperator::Bitwise_AND:
+            case asmb::BinaryOperator::Bitwise_OR:
+            case asmb::BinaryOperator::Bitwise_XOR:
+                result = &binary->mOperand2;
+                break;
+            default:
+                break;
+        }
+    }
+    else if (auto* unary = std::get_if<asmb::Unary>(&window[0]))
+        if (unary->mOp != asmb::UnaryOperator::Complement)
+            result = &unary->mOperand;
+
+    if (!result || !same_operand(*result, cmp->mOperand2) || (flags_read(after) & ~FLAG_ZERO))
+        return false;
+    out.push_back(window[0]);
+    return true;
+}
+
+// movl $0, %r -> xorl %r, %r, if the flags are set again before being read
+inline bool rewrite_zero_xor(std::span<const asmb::Instruction> window, std::span<const asmb::Instruction> after,
+                             std::vector<asmb::Instruction>& out) {
+    auto* mov = std::get_if<asmb::Mov>(&window[0]);
+    if (!mov || !is_imm(mov->mSrc, 0) || !std::holds_alternative<asmb::Reg>(mov->mDst) || flags_read(after))
+        return false;
+    out.push_back(asmb::Binary(asmb::BinaryOperator::Bitwise_XOR, mov->mDst, mov->mDst));
+    return true;
+}
+
+// cmpl A, B; movl $0, %r; setcc %r -> xorl %r, %r; cmpl A, B; setcc %r
+inline bool rewrite_setcc_xor(std::span<const asmb::Instruction> window, std::span<const asmb::Instruction>,
+                              std::vector<asmb::Instruction>& out) {
+    auto* cmp = std::get_if<asmb::Cmp>(&window[0]);
+    auto* mov = std::get_if<asmb::Mov>(&window[1]);
+    auto* setCC = std::get_if<asmb::SetCC>(&window[2]);
+    if (!cmp || !mov || !setCC || !is_imm(mov->mSrc, 0) || !std::holds_alternative<asmb::Reg>(mov->mDst)
+        || !same_operand(mov->mDst, setCC->mDst)
+        || same_operand(mov->mDst, cmp->mOperand1) || same_operand(mov->mDst, cmp->mOperand2))
+        return false;
+    out.push_back(asmb::Binary(asmb::BinaryOperator::Bitwise_XOR, mov->mDst, mov->mDst));
+    out.push_back(*cmp);
+    out.push_back(*setCC);
+    return true;
+}
+
+// imull $2^k, X -> sall $k, X. Nothing reads the flags after a multiply.
+inline bool rewrite_multiply_shift(std::span<const asmb::Instruction> window, std::span<const asmb::Instruction>,
+                                   std::vector<asmb::Instruction>& out) {
+    auto* binary = std::get_if<asmb::Binary>(&window[0]);
+    if (!binary || binary->mOp != asmb::BinaryOperator::Multiply)
+        return false;
+    auto* factor = std::get_if<asmb::Imm>(&binary->mOperand1);
+    if (!factor)
+        return false;
+    uint32_t value = static_cast<uint32_t>(factor->mValue);
+    if (value == 0 || (value & (value - 1)) != 0)
+        return false;
+
+    int32_t shift = std::countr_zero(value);
+    if (shift != 0)
+        out.push_back(asmb::Binary(asmb::BinaryOperator::Left_Shift, asmb::Imm(shift), binary->mOperand2));
+    return true;
+}
+
+// addl $1, X -> incl X and subl $1, X -> decl X, if the carry flag isn't read
+inline bool rewrite_add_increment(std::span<const asmb::Instruction> window, std::span<const asmb::Instruction> after,
+                                  std::vector<asmb::Instruction>& out) {
+    auto* binary = std::get_if<asmb::Binary>(&window[0]);
+    if (!binary || (binary->mOp != asmb::BinaryOperator::Add && binary->mOp != asmb::BinaryOperator::Subtract))
+        return false;
+    auto* step = std::get_if<asmb::Imm>(&binary->mOperand1);
+    if (!step || (step->mValue != 1 && step->mValue != -1) || (flags_read(after) & FLAG_CARRY))
+        return false;
+
+    bool increment = (binary->mOp == asmb::BinaryOperator::Add) == (step->mValue == 1);
+    out.push_back(asmb::Unary(increment ? asmb::UnaryOperator::Increment : asmb::UnaryOperator::Decrement,
+                              binary->mOperand2));
+    return true;
+}
+
+// Tried in order at each position, the first to match wins
+inline constexpr std::array<PeepholeRule, 9> PEEPHOLE_RULES = {{
+    {"self-move",       1, rewrite_self_move},
+    {"redundant-load",  2, rewrite_redundant_load},
+    {"forward-store",   2, rewrite_forward_store},
+    {"dead-store",      2, rewrite_dead_store},
+    {"compare-zero",    2, rewrite_compare_zero},
+    {"setcc-xor",       3, rewrite_setcc_xor},
+    {"zero-xor",        1, rewrite_zero_xor},
+    {"multiply-shift",  1, rewrite_multiply_shift},
+    {"add-increment",   1, rewrite_add_increment},
+}};
+
+// ------------------------------> Peephole Pass <------------------------------
+
+struct PeepholeOptions {
+    std::array<bool, PEEPHOLE_RULES.size()> mEnabled = {};
+
+    /// @brief Enables the rule with this name, or every rule for "all", false if there's no such rule
+    bool enable(std::string_view name) {
+        bool found = false;
+        for (size_t rule = 0; rule < PEEPHOLE_RULES.size(); ++rule) {
+            if (name == "all" || PEEPHOLE_RULES[rule].mName == name) {
+                mEnabled[rule] = true;
+                found = true;
+            }
+        }
+        return found;
+    }
+};
+
+struct PeepholeStats {
+    std::array<uint32_t, PEEPHOLE_RULES.size()> mHits = {};
+};
+
+struct PeepholeOptimizer {
+    PeepholeOptions mOptions;
+    PeepholeStats mStats;
+    std::vector<asmb::Instruction> mOutput;
+
+    PeepholeOptimizer(PeepholeOptions options) : mOptions(options) {}
+
+    /// @brief One sweep of the window over the instructions, true if any rule matched
+    bool sweep(std::vector<asmb::Instruction>& instructions) {
+        mOutput.clear();
+        mOutput.reserve(instructions.size());
+        std::span<const asmb::Instruction> input(instructions);
+        bool changed = false;
+
+        size_t i = 0;
+        while (i < input.size()) {
+            bool matched = false;
+            for (size_t rule = 0; rule < PEEPHOLE_RULES.size() && !matched; ++rule) {
+                const PeepholeRule& peepholeRule = PEEPHOLE_RULES[rule];
+                if (!mOptions.mEnabled[rule] || i + peepholeRule.mWindow > input.size())
+                    continue;
+                if (peepholeRule.mRewrite(input.subspan(i, peepholeRule.mWindow),
+                                          input.subspan(i + peepholeRule.mWindow), mOutput)) {
+                    ++mStats.mHits[rule];
+                    i += peepholeRule.mWindow;
+                    matched = true;
+                }
+            }
+            if (!matched) {
+                mOutput.emplace_back(std::move(instructions[i]));
+                ++i;
+            }
+            changed |= matched;
+        }
+
+        instructions.swap(mOutput);
+        return changed;
+    }
+
+    // Function visitor
+    void operator()(asmb::Function& function) {
+        while (sweep(function.mInstructions)) {}
+    }
+
+    // Program visitor
+    PeepholeStats operator()(asmb::Program& program) {
+        mStats = PeepholeStats();
+        for (auto& function : program.mFunctions)
+            (*this)(function);
+        return mStats;
+    }
+};
+
+}
@@ -68,6 +68,12 @@ struct PrintVisitor {
         std::visit(PrintVisitor(depth+2), idiv.mOperand);
     }
 
+    void operator()(const Imul& imul) const {
+        std::cout << indent() << "Imul:\n";
+        std::cout << indent() << "  " << "Operand:\n";
+        std::visit(PrintVisitor(depth+2), imul.mOperand);
+    }
+
     void operator()(const Cdq&) const {
         std::cout << indent() << "Cdq" << std::endl;
     }
@@ -98,6 +104,15 @@ struct PrintVisitor {
             << condition_code_to_string(jmpCC.mCondCode) << std::endl;
     }
 
+    void operator()(const JmpTable& jmpTable) const {
+        std::cout << indent() << "JumpTable: " << jmpTable.mTable << std::endl;
+        std::cout << indent() << "  Index:\n";
+        std::visit(PrintVisitor(depth+2), jmpTable.mIndex);
+        std::cout << indent() << "  Targets:\n";
+        for (auto target : jmpTable.mTargets)
+            std::cout << indent() << "    " << target << std::endl;
+    }
+
     void operator()(const SetCC& setCC) const {
         std::cout << indent() << "SetCC:\n";
         std::cout << indent() << "  Condition Code: "
@@ -122,6 +137,10 @@ struct PrintVisitor {
         std::visit(PrintVisitor(depth+1), push.mOperand);
     }
 
+    void operator()(const Pop& pop) const {
+        std::cout << indent() << "Pop: " << reg_name_to_string(pop.mReg, RegisterSize::QWORD) << std::endl;
+    }
+
     void operator()(const Call& call) const {
         std::cout << indent() << "Call: " << call.mFuncName << std::endl;
     }
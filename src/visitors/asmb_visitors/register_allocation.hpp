@@ -0,0 +1,774 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+#include <vector>
+#include "../../ast/ast_asmb.hpp"
+#include "../../ast/dense_bitset.hpp"
+#include "../../ast/general.hpp"
+
+namespace compiler::codegen {
+
+using namespace ast;
+
+// ------------------------------> Register Allocation <------------------------------
+// Both allocators run on each function's ASMB before ReplacePseudoRegisters and work on the same
+// liveness information, whose nodes are the allocatable hard registers followed by the pseudos. A
+// pseudo left without a register keeps its Pseudo operand so ReplacePseudoRegisters gives it a
+// stack slot as before.
+
+/// @brief Calls f with every operand of the instruction
+template<typename InstructionType, typename F>
+void for_each_operand(InstructionType& instruction, F&& f) {
+    std::visit([&](auto& inst) {
+        using T = std::decay_t<decltype(inst)>;
+        if constexpr (std::is_same_v<T, asmb::Mov>) {
+            f(inst.mSrc);
+            f(inst.mDst);
+        }
+        else if constexpr (std::is_same_v<T, asmb::Binary> || std::is_same_v<T, asmb::Cmp>) {
+            f(inst.mOperand1);
+            f(inst.mOperand2);
+        }
+        else if constexpr (std::is_same_v<T, asmb::Unary> || std::is_same_v<T, asmb::Idiv> || std::is_same_v<T, asmb::Imul>
+                        || std::is_same_v<T, asmb::Push>)
+            f(inst.mOperand);
+        else if constexpr (std::is_same_v<T, asmb::SetCC>)
+            f(inst.mDst);
+        else if constexpr (std::is_same_v<T, asmb::JmpTable>)
+            f(inst.mIndex);
+    }, instruction);
+}
+
+struct AsmbLiveness {
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr uint32_t REGISTER_COUNT = asmb::ALLOCATABLE_REGISTERS.size();
+
+    /// Nodes one instruction reads or writes, a Call writes the most with the caller-saved registers
+    struct NodeList {
+        std::array<uint32_t, 8> mNodes;
+        uint32_t mCount = 0;
+
+        void add(uint32_t node) {
+            if (node != NONE)
+                mNodes[mCount++] = node;
+        }
+        const uint32_t* begin() const { return mNodes.data(); }
+        const uint32_t* end() const { return mNodes.data() + mCount; }
+    };
+
+    /// A range of mInstructions only entered at its first instruction and left at its last
+    struct Block {
+        uint32_t mBegin;
+        uint32_t mEnd;
+        std::vector<uint32_t> mSuccessors;
+    };
+
+    const SymbolMapType* mSymbolMap = nullptr;
+
+    // Hard registers are nodes 0 to REGISTER_COUNT - 1 in ALLOCATABLE_REGISTERS order, pseudos follow
+    SymbolIdMap<uint32_t> mPseudoNodes;
+    std::vector<SymbolId> mPseudos;
+
+    std::vector<Block> mBlocks;
+    std::vector<std::vector<uint32_t>> mPredecessors;
+    std::unordered_map<SymbolId, uint32_t> mLabelBlocks;
+    std::vector<DenseBitset> mLiveIn;
+    std::vector<DenseBitset> mLiveOut;
+
+    uint32_t nodeCount() const { return REGISTER_COUNT + static_cast<uint32_t>(mPseudos.size()); }
+
+    static uint32_t registerNode(asmb::RegisterName reg) {
+        for (uint32_t node = 0; node < REGISTER_COUNT; ++node)
+            if (asmb::ALLOCATABLE_REGISTERS[node] == reg)
+                return node;
+        return NONE;
+    }
+
+    uint32_t node(const asmb::Operand& operand) const {
+        if (auto* reg = std::get_if<asmb::Reg>(&operand))
+            return registerNode(reg->mReg);
+        if (auto* pseudo = std::get_if<asmb::Pseudo>(&operand))
+            return mPseudoNodes.at(pseudo->mName);
+        return NONE;
+    }
+
+    asmb::Operand operand(uint32_t node) const {
+        if (node < REGISTER_COUNT)
+            return asmb::Reg(asmb::ALLOCATABLE_REGISTERS[node]);
+        return asmb::Pseudo(mPseudos[node - REGISTER_COUNT]);
+    }
+
+    // Idiv, Imul, Cdq, Call and Ret read and write fixed registers, besides their operands
+    void usesAndDefs(const asmb::Instruction& instruction, NodeList& uses, NodeList& defs) const {
+        std::visit([&](const auto& inst) {
+            using T = std::decay_t<decltype(inst)>;
+            if constexpr (std::is_same_v<T, asmb::Mov>) {
+                uses.add(node(inst.mSrc));
+                defs.add(node(inst.mDst));
+            }
+            else if constexpr (std::is_same_v<T, asmb::Unary>) {
+                uses.add(node(inst.mOperand));
+                defs.add(node(inst.mOperand));
+            }
+            else if constexpr (std::is_same_v<T, asmb::Binary>) {
+                uses.add(node(inst.mOperand1));
+                uses.add(node(inst.mOperand2));
+                defs.add(node(inst.mOperand2));
+            }
+            else if constexpr (std::is_same_v<T, asmb::Cmp>) {
+                uses.add(node(inst.mOperand1));
+                uses.add(node(inst.mOperand2));
+            }
+            // Only the low byte is written, the rest of the destination is kept
+            else if constexpr (std::is_same_v<T, asmb::SetCC>) {
+                uses.add(node(inst.mDst));
+                defs.add(node(inst.mDst));
+            }
+            else if constexpr (std::is_same_v<T, asmb::Idiv>) {
+                uses.add(node(inst.mOperand));
+                uses.add(registerNode(asmb::RegisterName::AX));
+                uses.add(registerNode(asmb::RegisterName::DX));
+                defs.add(registerNode(asmb::RegisterName::AX));
+                defs.add(registerNode(asmb::RegisterName::DX));
+            }
+            else if constexpr (std::is_same_v<T, asmb::Imul>) {
+                uses.add(node(inst.mOperand));
+                uses.add(registerNode(asmb::RegisterName::AX));
+                defs.add(registerNode(asmb::RegisterName::AX));
+                defs.add(registerNode(asmb::RegisterName::DX));
+            }
+            else if constexpr (std::is_same_v<T, asmb::Cdq>) {
+                uses.add(registerNode(asmb::RegisterName::AX));
+                defs.add(registerNode(asmb::RegisterName::DX));
+            }
+            else if constexpr (std::is_same_v<T, asmb::Push>)
+                uses.add(node(inst.mOperand));
+            else if constexpr (std::is_same_v<T, asmb::JmpTable>)
+                uses.add(node(inst.mIndex));
+            else if constexpr (std::is_same_v<T, asmb::Call>) {
+                uint32_t params = std::get<FuncType>(mSymbolMap->at(inst.mFuncName).mType).mParamCount;
+                for (uint32_t i = 0; i < params && i < asmb::ARG_REGISTERS.size(); ++i)
+                    uses.add(registerNode(asmb::ARG_REGISTERS[i]));
+                for (auto reg : asmb::ALLOCATABLE_REGISTERS)
+                    if (!asmb::is_callee_saved(reg))
+                        defs.add(registerNode(reg));
+            }
+            else if constexpr (std::is_same_v<T, asmb::Ret>)
+                uses.add(registerNode(asmb::RegisterName::AX));
+        }, instruction);
+    }
+
+    void numberPseudos(const std::vector<asmb::Instruction>& instructions) {
+        mPseudoNodes.clear();
+        mPseudos.clear();
+        for (const auto& instruction : instructions) {
+            for_each_operand(instruction, [&](const asmb::Operand& operand) {
+                auto* pseudo = std::get_if<asmb::Pseudo>(&operand);
+                if (pseudo && !mPseudoNodes.contains(pseudo->mName)) {
+                    mPseudoNodes.insert_or_assign(pseudo->mName, nodeCount());
+                    mPseudos.push_back(pseudo->mName);
+                }
+            });
+        }
+    }
+
+    void buildBlocks(const std::vector<asmb::Instruction>& instructions) {
+        mBlocks.clear();
+        mLabelBlocks.clear();
+
+        uint32_t size = static_cast<uint32_t>(instructions.size());
+        uint32_t begin = 0;
+        for (uint32_t i = 0; i < size; ++i) {
+            if (auto* label = std::get_if<asmb::Label>(&instructions[i])) {
+                if (i > begin) {
+                    mBlocks.push_back(Block{begin, i, {}});
+                    begin = i;
+                }
+                mLabelBlocks[label->mIdentifier] = static_cast<uint32_t>(mBlocks.size());
+            }
+            if (std::holds_alternative<asmb::Jmp>(instructions[i])
+                || std::holds_alternative<asmb::JmpCC>(instructions[i])
+                || std::holds_alternative<asmb::JmpTable>(instructions[i])
+                || std::holds_alternative<asmb::Ret>(instructions[i])) {
+                mBlocks.push_back(Block{begin, i + 1, {}});
+                begin = i + 1;
+            }
+        }
+        if (begin < size)
+            mBlocks.push_back(Block{begin, size, {}});
+
+        uint32_t blockCount = static_cast<uint32_t>(mBlocks.size());
+        mPredecessors.assign(blockCount, {});
+        for (uint32_t block = 0; block < blockCount; ++block) {
+            auto& successors = mBlocks[block].mSuccessors;
+            auto addSuccessor = [&](uint32_t successor) {
+                if (std::find(successors.begin(), successors.end(), successor) == successors.end())
+                    successors.push_back(successor);
+            };
+
+            const auto& last = instructions[mBlocks[block].mEnd - 1];
+            if (auto* jmp = std::get_if<asmb::Jmp>(&last))
+                addSuccessor(mLabelBlocks.at(jmp->mIdentifier));
+            else if (auto* jmpTable = std::get_if<asmb::JmpTable>(&last))
+                for (SymbolId target : jmpTable->mTargets)
+                    addSuccessor(mLabelBlocks.at(target));
+            else if (!std::holds_alternative<asmb::Ret>(last)) {
+                if (auto* jmpCC = std::get_if<asmb::JmpCC>(&last))
+                    addSuccessor(mLabelBlocks.at(jmpCC->mIdentifier));
+                if (block + 1 < blockCount)
+                    addSuccessor(block + 1);
+            }
+
+            for (uint32_t successor : successors)
+                mPredecessors[successor].push_back(block);
+        }
+    }
+
+    /// @brief Applies one instruction, walking backwards, to the set of live nodes
+    void transfer(const asmb::Instruction& instruction, DenseBitset& live) const {
+        NodeList uses, defs;
+        usesAndDefs(instruction, uses, defs);
+        for (uint32_t def : defs)
+            live.reset(def);
+        for (uint32_t use : uses)
+            live.set(use);
+    }
+
+    /// @brief Fills mLiveIn and mLiveOut with the live nodes at the start and end of every block
+    void analyze(const std::vector<asmb::Instruction>& instructions) {
+        uint32_t blockCount = static_cast<uint32_t>(mBlocks.size());
+        mLiveIn.assign(blockCount, DenseBitset(nodeCount()));
+        mLiveOut.assign(blockCount, DenseBitset(nodeCount()));
+
+        std::vector<uint32_t> worklist;
+        std::vector<bool> queued(blockCount, true);
+        for (uint32_t block = 0; block < blockCount; ++block)
+            worklist.push_back(block);
+
+        while (!worklist.empty()) {
+            uint32_t block = worklist.back();
+            worklist.pop_back();
+            queued[block] = false;
+
+            mLiveOut[block].resetAll();
+            for (uint32_t successor : mBlocks[block].mSuccessors)
+                mLiveOut[block].unionWith(mLiveIn[successor]);
+
+            DenseBitset live = mLiveOut[block];
+            for (uint32_t i = mBlocks[block].mEnd; i-- > mBlocks[block].mBegin; )
+                transfer(instructions[i], live);
+            if (live == mLiveIn[block])
+                continue;
+            mLiveIn[block] = std::move(live);
+
+            for (uint32_t predecessor : mPredecessors[block]) {
+                if (!queued[predecessor]) {
+                    queued[predecessor] = true;
+                    worklist.push_back(predecessor);
+                }
+            }
+        }
+    }
+
+    void build(const std::vector<asmb::Instruction>& instructions) {
+        numberPseudos(instructions);
+        buildBlocks(instructions);
+        analyze(instructions);
+    }
+};
+
+/// @brief Rewrites pseudos with the register index (into ALLOCATABLE_REGISTERS) given to their
+/// node, drops Movs left copying a register onto itself, and saves the callee-saved registers used
+inline void assign_registers(asmb::Function& function, SymbolInfo& symbolInfo, const AsmbLiveness& liveness,
+                             const std::vector<uint32_t>& registers) {
+    constexpr uint32_t NONE = AsmbLiveness::NONE;
+    uint32_t used = 0;
+    for (uint32_t node = AsmbLiveness::REGISTER_COUNT; node < liveness.nodeCount(); ++node)
+        if (registers[node] != NONE)
+            used |= 1u << registers[node];
+
+    std::vector<asmb::RegisterName> saved;
+    for (uint32_t reg = 0; reg < AsmbLiveness::REGISTER_COUNT; ++reg)
+        if (used & 1u << reg && asmb::is_callee_saved(asmb::ALLOCATABLE_REGISTERS[reg]))
+            saved.push_back(asmb::ALLOCATABLE_REGISTERS[reg]);
+    symbolInfo.mCalleeSavedCount = static_cast<uint32_t>(saved.size());
+
+    std::vector<asmb::Instruction> instructions;
+    instructions.reserve(function.mInstructions.size() + 2 * saved.size());
+    for (auto reg : saved)
+        instructions.emplace_back(asmb::Push(asmb::Reg(reg)));
+
+    for (auto& instruction : function.mInstructions) {
+        for_each_operand(instruction, [&](asmb::Operand& op) {
+            if (!std::holds_alternative<asmb::Pseudo>(op))
+                return;
+            uint32_t reg = registers[liveness.node(op)];
+            if (reg != NONE)
+                op = asmb::Reg(asmb::ALLOCATABLE_REGISTERS[reg]);
+        });
+
+        if (auto* mov = std::get_if<asmb::Mov>(&instruction)) {
+            auto* src = std::get_if<asmb::Reg>(&mov->mSrc);
+            auto* dst = std::get_if<asmb::Reg>(&mov->mDst);
+            if (src && dst && src->mReg == dst->mReg)
+                continue;
+        }
+        if (std::holds_alternative<asmb::Ret>(instruction))
+            for (auto it = saved.rbegin(); it != saved.rend(); ++it)
+                instructions.emplace_back(asmb::Pop(*it));
+        instructions.emplace_back(std::move(instruction));
+    }
+    function.mInstructions = std::move(instructions);
+}
+
+// ------------------------------> Graph Coloring <------------------------------
+// Chaitin-Briggs: liveness gives an interference graph in which the hard registers come
+// precolored. Movs between nodes which don't interfere are coalesced when the Briggs test (or the
+// George test against a hard register) shows the merged node can't make coloring harder, after
+// which the graph is simplified and colored optimistically.
+
+struct GraphColoringAllocation {
+    static constexpr uint32_t NONE = AsmbLiveness::NONE;
+    static constexpr uint32_t REGISTER_COUNT = AsmbLiveness::REGISTER_COUNT;
+
+    AsmbLiveness mLiveness;
+
+    // Interference graph, edges between two hard registers are implied and never stored
+    std::vector<std::vector<uint32_t>> mAdjacency;
+    std::unordered_set<uint64_t> mEdges;
+    std::vector<uint32_t> mSpillCosts;   // number of times a node is read or written
+    std::vector<uint32_t> mAlias;        // coalesced nodes point towards the node they were merged into
+    std::vector<uint32_t> mMarks;
+    uint32_t mMark = 0;
+
+    static uint64_t edgeKey(uint32_t a, uint32_t b) {
+        return a < b ? static_cast<uint64_t>(a) << 32 | b : static_cast<uint64_t>(b) << 32 | a;
+    }
+
+    bool interferes(uint32_t a, uint32_t b) const {
+        if (a < REGISTER_COUNT && b < REGISTER_COUNT)
+            return a != b;
+        return mEdges.contains(edgeKey(a, b));
+    }
+
+    void addEdge(uint32_t a, uint32_t b) {
+        if (a == b || (a < REGISTER_COUNT && b < REGISTER_COUNT))
+            return;
+        if (mEdges.insert(edgeKey(a, b)).second) {
+            mAdjacency[a].push_back(b);
+            mAdjacency[b].push_back(a);
+        }
+    }
+
+    void buildGraph(const std::vector<asmb::Instruction>& instructions) {
+        mLiveness.build(instructions);
+        uint32_t nodeCount = mLiveness.nodeCount();
+        mAdjacency.assign(nodeCount, {});
+        mEdges.clear();
+        mSpillCosts.assign(nodeCount, 0);
+
+        for (uint32_t block = 0; block < mLiveness.mBlocks.size(); ++block) {
+            DenseBitset& live = mLiveness.mLiveOut[block];
+            for (uint32_t i = mLiveness.mBlocks[block].mEnd; i-- > mLiveness.mBlocks[block].mBegin; ) {
+                AsmbLiveness::NodeList uses, defs;
+                mLiveness.usesAndDefs(instructions[i], uses, defs);
+
+                // A Mov's destination may share a register with its source, they hold the same value
+                uint32_t movSrc = NONE;
+                if (auto* mov = std::get_if<asmb::Mov>(&instructions[i]))
+                    movSrc = mLiveness.node(mov->mSrc);
+
+                for (uint32_t def : defs) {
+                    live.forEach([&](uint32_t other) {
+                        if (other != movSrc)
+                            addEdge(def, other);
+                    });
+                    ++mSpillCosts[def];
+                }
+                for (uint32_t def : defs)
+                    live.reset(def);
+                for (uint32_t use : uses) {
+                    live.set(use);
+                    ++mSpillCosts[use];
+                }
+            }
+        }
+    }
+
+    // ------------------------------> Coalescing <------------------------------
+
+    uint32_t find(uint32_t node) {
+        while (mAlias[node] != node)
+            node = mAlias[node] = mAlias[mAlias[node]];
+        return node;
+    }
+
+    bool isSignificant(uint32_t node) const {
+        return node < REGISTER_COUNT || mAdjacency[node].size() >= REGISTER_COUNT;
+    }
+
+    // Briggs: the merged node has fewer than REGISTER_COUNT neighbours of significant degree
+    bool briggsTest(uint32_t a, uint32_t b) {
+        ++mMark;
+        uint32_t significant = 0;
+        for (uint32_t node : {a, b}) {
+            for (uint32_t neighbour : mAdjacency[node]) {
+                if (mMarks[neighbour] == mMark)
+                    continue;
+                mMarks[neighbour] = mMark;
+                if (isSignificant(neighbour) && ++significant >= REGISTER_COUNT)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // George: every neighbour of the pseudo already interferes with the register or is insignificant
+    bool georgeTest(uint32_t reg, uint32_t pseudo) const {
+        for (uint32_t neighbour : mAdjacency[pseudo])
+            if (neighbour >= REGISTER_COUNT && isSignificant(neighbour) && !interferes(neighbour, reg))
+                return false;
+        return true;
+    }
+
+    void merge(uint32_t into, uint32_t node) {
+        mAlias[node] = into;
+        for (uint32_t neighbour : mAdjacency[node]) {
+            auto& adjacency = mAdjacency[neighbour];
+            auto it = std::find(adjacency.begin(), adjacency.end(), node);
+            *it = adjacency.back();
+            adjacency.pop_back();
+            mEdges.erase(edgeKey(node, neighbour));
+            addEdge(into, neighbour);
+        }
+        mAdjacency[node].clear();
+        mSpillCosts[into] += mSpillCosts[node];
+    }
+
+    /// @brief Merges the operands of Movs where that is safe, returns whether any were merged
+    bool coalesce(const std::vector<asmb::Instruction>& instructions) {
+        mAlias.resize(mLiveness.nodeCount());
+        std::iota(mAlias.begin(), mAlias.end(), 0);
+        mMarks.assign(mLiveness.nodeCount(), 0);
+        mMark = 0;
+
+        bool coalesced = false;
+        for (const auto& instruction : instructions) {
+            auto* mov = std::get_if<asmb::Mov>(&instruction);
+            if (!mov)
+                continue;
+            uint32_t src = mLiveness.node(mov->mSrc);
+            uint32_t dst = mLiveness.node(mov->mDst);
+            if (src == NONE || dst == NONE)
+                continue;
+            src = find(src);
+            dst = find(dst);
+            if (src == dst || (src < REGISTER_COUNT && dst < REGISTER_COUNT) || interferes(src, dst))
+                continue;
+
+            // A hard register always stands for the merged node
+            uint32_t into = src < REGISTER_COUNT ? src : dst;
+            uint32_t other = into == src ? dst : src;
+            bool safe = into < REGISTER_COUNT ? georgeTest(into, other) : briggsTest(into, other);
+            if (safe) {
+                merge(into, other);
+                coalesced = true;
+            }
+        }
+        return coalesced;
+    }
+
+    /// @brief Replaces coalesced operands with the node they were merged into
+    void renameCoalesced(std::vector<asmb::Instruction>& instructions) {
+        size_t kept = 0;
+        for (size_t i = 0; i < instructions.size(); ++i) {
+            for_each_operand(instructions[i], [&](asmb::Operand& op) {
+                if (std::holds_alternative<asmb::Pseudo>(op))
+                    op = mLiveness.operand(find(mLiveness.node(op)));
+            });
+            if (auto* mov = std::get_if<asmb::Mov>(&instructions[i])) {
+                uint32_t src = mLiveness.node(mov->mSrc);
+                if (src != NONE && src == mLiveness.node(mov->mDst))
+                    continue;
+            }
+            if (kept != i)
+                instructions[kept] = std::move(instructions[i]);
+            ++kept;
+        }
+        instructions.erase(instructions.begin() + kept, instructions.end());
+    }
+
+    // ------------------------------> Coloring <------------------------------
+
+    /// @brief A register index into ALLOCATABLE_REGISTERS for every node, NONE for spilled pseudos
+    std::vector<uint32_t> color() const {
+        uint32_t count = mLiveness.nodeCount();
+        std::vector<uint32_t> colors(count, NONE);
+        std::vector<uint32_t> degrees(count, 0);
+        std::vector<bool> removed(count, false);
+        std::vector<uint32_t> lowDegree;
+        for (uint32_t node = 0; node < REGISTER_COUNT; ++node)
+            colors[node] = node;
+        for (uint32_t node = REGISTER_COUNT; node < count; ++node) {
+            degrees[node] = static_cast<uint32_t>(mAdjacency[node].size());
+            if (degrees[node] < REGISTER_COUNT)
+                lowDegree.push_back(node);
+        }
+
+        // Simplify, when every node left has significant degree the one cheapest to spill per
+        // neighbour is removed anyway and may still find a color
+        std::vector<uint32_t> stack;
+        while (stack.size() < count - REGISTER_COUNT) {
+            uint32_t next = NONE;
+            if (!lowDegree.empty()) {
+                next = lowDegree.back();
+                lowDegree.pop_back();
+            }
+            else {
+                for (uint32_t node = REGISTER_COUNT; node < count; ++node) {
+                    if (removed[node])
+                        continue;
+                    if (next == NONE || static_cast<uint64_t>(mSpillCosts[node]) * degrees[next]
+                                      < static_cast<uint64_t>(mSpillCosts[next]) * degrees[node])
+                        next = node;
+                }
+            }
+
+            removed[next] = true;
+            stack.push_back(next);
+            for (uint32_t neighbour : mAdjacency[next])
+                if (neighbour >= REGISTER_COUNT && !removed[neighbour] && degrees[neighbour]-- == REGISTER_COUNT)
+                    lowDegree.push_back(neighbour);
+        }
+
+        // Select, caller-saved registers come first so callee-saved ones are only used when needed
+        while (!stack.empty()) {
+            uint32_t node = stack.back();
+            stack.pop_back();
+            uint32_t taken = 0;
+            for (uint32_t neighbour : mAdjacency[node])
+                if (colors[neighbour] != NONE)
+                    taken |= 1u << colors[neighbour];
+            for (uint32_t color = 0; color < REGISTER_COUNT; ++color) {
+                if (!(taken & 1u << color)) {
+                    colors[node] = color;
+                    break;
+                }
+            }
+        }
+        return colors;
+    }
+
+    // Function visitor
+    void operator()(asmb::Function& function, SymbolInfo& symbolInfo) {
+        buildGraph(function.mInstructions);
+        while (coalesce(function.mInstructions)) {
+            renameCoalesced(function.mInstructions);
+            buildGraph(function.mInstructions);
+        }
+        assign_registers(function, symbolInfo, mLiveness, color());
+    }
+
+    // Program visitor
+    void operator()(asmb::Program& program, SymbolMapType& symbolMap) {
+        mLiveness.mSymbolMap = &symbolMap;
+        for (auto& function : program.mFunctions)
+            (*this)(function, symbolMap.at(function.mIdentifier));
+    }
+};
+
+// ------------------------------> Linear Scan <------------------------------
+// Poletto and Sarkar's linear scan, for when compile time matters more than the last few spills.
+// Every instruction reads at position 2i and writes at 2i + 1, a pseudo's live interval runs from
+// the first to the last position it is live at in mInstructions order, holes included. Intervals
+// are handed registers in order of their start, and when none is free the interval ending last
+// is spilled. Hard registers are only live in short ranges around the instructions fixing them,
+// a pseudo can't take a register over one of those. A pseudo first tries the register of the
+// other side of a Mov defining or reading it, which saves most of the copies coalescing would.
+
+struct LinearScanAllocation {
+    static constexpr uint32_t NONE = AsmbLiveness::NONE;
+    static constexpr uint32_t REGISTER_COUNT = AsmbLiveness::REGISTER_COUNT;
+
+    struct Interval {
+        uint32_t mStart = NONE;
+        uint32_t mEnd = 0;
+    };
+
+    /// The positions a hard register is live at, sorted by start with the furthest end seen so far
+    struct FixedRanges {
+        std::vector<Interval> mRanges;
+        std::vector<uint32_t> mFurthestEnd;
+
+        void finish() {
+            std::sort(mRanges.begin(), mRanges.end(), [](const Interval& a, const Interval& b) {
+                return a.mStart < b.mStart;
+            });
+            mFurthestEnd.resize(mRanges.size());
+            uint32_t furthest = 0;
+            for (size_t i = 0; i < mRanges.size(); ++i)
+                mFurthestEnd[i] = furthest = std::max(furthest, mRanges[i].mEnd);
+        }
+
+        bool overlaps(const Interval& interval) const {
+            auto it = std::upper_bound(mRanges.begin(), mRanges.end(), interval.mEnd,
+                [](uint32_t position, const Interval& range) { return position < range.mStart; });
+            return it != mRanges.begin() && mFurthestEnd[it - mRanges.begin() - 1] >= interval.mStart;
+        }
+    };
+
+    AsmbLiveness mLiveness;
+    std::vector<Interval> mIntervals;   // indexed by node, hard registers are left empty
+    std::vector<uint32_t> mHints;       // node on the other side of a Mov, NONE without one
+    std::array<FixedRanges, REGISTER_COUNT> mFixed;
+
+    void cover(uint32_t node, uint32_t position) {
+        Interval& interval = mIntervals[node];
+        interval.mStart = std::min(interval.mStart, position);
+        interval.mEnd = std::max(interval.mEnd, position);
+    }
+
+    void buildIntervals(const std::vector<asmb::Instruction>& instructions) {
+        mIntervals.assign(mLiveness.nodeCount(), Interval());
+        mHints.assign(mLiveness.nodeCount(), NONE);
+        for (auto& fixed : mFixed)
+            fixed.mRanges.clear();
+
+        for (uint32_t block = 0; block < mLiveness.mBlocks.size(); ++block) {
+            uint32_t begin = 2 * mLiveness.mBlocks[block].mBegin;
+            uint32_t end = 2 * mLiveness.mBlocks[block].mEnd;
+
+            // Walking backwards, where the live range of each hard register ends
+            std::array<uint32_t, REGISTER_COUNT> rangeEnd;
+            rangeEnd.fill(NONE);
+            mLiveness.mLiveOut[block].forEach([&](uint32_t node) {
+                if (node < REGISTER_COUNT)
+                    rangeEnd[node] = end;
+                else
+                    cover(node, end);
+            });
+            mLiveness.mLiveIn[block].forEach([&](uint32_t node) {
+                if (node >= REGISTER_COUNT)
+                    cover(node, begin);
+            });
+
+            for (uint32_t i = mLiveness.mBlocks[block].mEnd; i-- > mLiveness.mBlocks[block].mBegin; ) {
+                AsmbLiveness::NodeList uses, defs;
+                mLiveness.usesAndDefs(instructions[i], uses, defs);
+                for (uint32_t def : defs) {
+                    if (def >= REGISTER_COUNT)
+                        cover(def, 2 * i + 1);
+                    else {
+                        // A dead write, like a Call clobbering a register, still takes the register
+                        uint32_t rangeLast = rangeEnd[def] == NONE ? 2 * i + 1 : rangeEnd[def];
+                        mFixed[def].mRanges.push_back(Interval{2 * i + 1, rangeLast});
+                        rangeEnd[def] = NONE;
+                    }
+                }
+                for (uint32_t use : uses) {
+                    if (use >= REGISTER_COUNT)
+                        cover(use, 2 * i);
+                    else if (rangeEnd[use] == NONE)
+                        rangeEnd[use] = 2 * i;
+                }
+
+                if (auto* mov = std::get_if<asmb::Mov>(&instructions[i])) {
+                    uint32_t src = mLiveness.node(mov->mSrc);
+                    uint32_t dst = mLiveness.node(mov->mDst);
+                    if (src != NONE && dst != NONE) {
+                        mHints[src] = dst;
+                        mHints[dst] = src;
+                    }
+                }
+            }
+            for (uint32_t reg = 0; reg < REGISTER_COUNT; ++reg)
+                if (rangeEnd[reg] != NONE)
+                    mFixed[reg].mRanges.push_back(Interval{begin, rangeEnd[reg]});
+        }
+        for (auto& fixed : mFixed)
+            fixed.finish();
+    }
+
+    /// @brief A register index into ALLOCATABLE_REGISTERS for every node, NONE for spilled pseudos
+    std::vector<uint32_t> scan() const {
+        uint32_t count = mLiveness.nodeCount();
+        std::vector<uint32_t> registers(count, NONE);
+        for (uint32_t node = 0; node < REGISTER_COUNT; ++node)
+            registers[node] = node;
+
+        std::vector<uint32_t> order;
+        order.reserve(count - REGISTER_COUNT);
+        for (uint32_t node = REGISTER_COUNT; node < count; ++node)
+            order.push_back(node);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return mIntervals[a].mStart < mIntervals[b].mStart;
+        });
+
+        // At most one active interval per register, so the active set stays small enough to search
+        std::vector<uint32_t> active;
+        uint32_t freeRegisters = (1u << REGISTER_COUNT) - 1;
+        for (uint32_t node : order) {
+            const Interval& interval = mIntervals[node];
+            std::erase_if(active, [&](uint32_t other) {
+                if (mIntervals[other].mEnd >= interval.mStart)
+                    return false;
+                freeRegisters |= 1u << registers[other];
+                return true;
+            });
+
+            auto usable = [&](uint32_t reg) {
+                return reg != NONE && freeRegisters & 1u << reg && !mFixed[reg].overlaps(interval);
+            };
+            uint32_t reg = mHints[node] == NONE ? NONE : registers[mHints[node]];
+            if (!usable(reg)) {
+                reg = NONE;
+                for (uint32_t candidate = 0; candidate < REGISTER_COUNT && reg == NONE; ++candidate)
+                    if (usable(candidate))
+                        reg = candidate;
+            }
+            if (reg != NONE) {
+                registers[node] = reg;
+                freeRegisters &= ~(1u << reg);
+                active.push_back(node);
+                continue;
+            }
+
+            // Spill whichever of this interval and the active ones it could displace ends last
+            uint32_t victim = NONE;
+            for (uint32_t other : active) {
+                if (mFixed[registers[other]].overlaps(interval))
+                    continue;
+                if (victim == NONE || mIntervals[other].mEnd > mIntervals[victim].mEnd)
+                    victim = other;
+            }
+            if (victim != NONE && mIntervals[victim].mEnd > interval.mEnd) {
+                registers[node] = registers[victim];
+                registers[victim] = NONE;
+                *std::find(active.begin(), active.end(), victim) = node;
+            }
+        }
+        return registers;
+    }
+
+    // Function visitor
+    void operator()(asmb::Function& function, SymbolInfo& symbolInfo) {
+        mLiveness.build(function.mInstructions);
+        buildIntervals(function.mInstructions);
+        assign_registers(function, symbolInfo, mLiveness, scan());
+    }
+
+    // Program visitor
+    void operator()(asmb::Program& program, SymbolMapType& symbolMap) {
+        mLiveness.mSymbolMap = &symbolMap;
+        for (auto& function : program.mFunctions)
+            (*this)(function, symbolMap.at(function.mIdentifier));
+    }
+};
+
+}
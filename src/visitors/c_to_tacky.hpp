@@ -1,56 +1,17 @@
 #pragma once
+#include <algorithm>
 #include <memory>
+#include <span>
 #include <sstream>
 #include <format>
 #include <vector>
 #include <stdexcept>
 #include "../ast/ast_c.hpp"
 #include "../ast/ast_tacky.hpp"
+#include "../ast/name_generator.hpp"
 
 namespace compiler::codegen {
 
-// ------------------------------> Helper function for temporary variables <------------------------------
-
-inline ast::tacky::Var makeTemporaryRegister() {
-    static uint32_t tmpRegisterNum = 0;
-    return std::format("tmp.{}", tmpRegisterNum++);;
-}
-
-// ------------------------------> Helper functions for labels <------------------------------
-
-inline std::pair<ast::tacky::Label, ast::tacky::Label> makeAndLabels() {
-    static uint32_t andNum = 0;
-    return {
-        std::format("and_false.{}", andNum),
-        std::format("and_end.{}", andNum++)
-    };
-}
-
-inline std::pair<ast::tacky::Label, ast::tacky::Label> makeOrLabels() {
-    static uint32_t orNum = 0;
-    return {
-        std::format("or_true.{}", orNum),
-        std::format("or_end.{}", orNum++)
-    };
-}
-
-inline std::pair<ast::tacky::Label, ast::tacky::Label> makeConditionalLabels() {
-    static uint32_t conditionalNum = 0;
-    return {
-        std::format("cond_expr2.{}", conditionalNum),
-        std::format("cond_end.{}", conditionalNum++)
-    };
-}
-
-inline std::pair<ast::tacky::Label, ast::tacky::Label> makeIfLabels() {
-    static uint32_t ifNum = 0;
-    return {
-        std::format("if_else.{}", ifNum),
-        std::format("if_end.{}", ifNum++)
-    };
-}
-
-
 // ------------------------------> Map between TACKY unops and C unops <------------------------------
 
 inline constexpr ast::tacky::UnaryOperator c_to_tacky_unop(ast::c::UnaryOperator unop) {
@@ -88,11 +49,53 @@ inline constexpr ast::tacky::BinaryOperator c_to_tacky_binops(ast::c::BinaryOper
     throw std::runtime_error("c_to_tacky_binops received an unknown ast::c::UnaryOperator");
 }
 
+// ------------------------------> Switch lowering strategy <------------------------------
+
+enum class SwitchLowering {
+    Chain,          // one JumpIfEqual per case
+    JumpTable,      // bounds check and an indirect jump through a table
+    BinarySearch    // balanced tree of JumpIfLess splitting the sorted cases
+};
+
+// Below this many cases a chain of compares is as quick as anything else
+constexpr size_t SWITCH_MIN_CASES = 4;
+// Largest table and lowest share of its entries that must be real cases, the rest jump to default
+constexpr int64_t SWITCH_MAX_TABLE_SIZE = 4096;
+constexpr int64_t SWITCH_MIN_DENSITY_PERCENT = 40;
+
+/// @brief Picks how to dispatch over the switch's cases, which must be sorted
+inline SwitchLowering choose_switch_lowering(std::span<const int> sortedCases) {
+    if (sortedCases.size() < SWITCH_MIN_CASES)
+        return SwitchLowering::Chain;
+    int64_t range = static_cast<int64_t>(sortedCases.back()) - sortedCases.front() + 1;
+    if (range <= SWITCH_MAX_TABLE_SIZE
+        && static_cast<int64_t>(sortedCases.size()) * 100 >= range * SWITCH_MIN_DENSITY_PERCENT)
+        return SwitchLowering::JumpTable;
+    return SwitchLowering::BinarySearch;
+}
+
 // ------------------------------> Conversion from C AST to TACKY AST <------------------------------
 
 struct CToTacky {
+    ast::NameGenerator& mNames;
     std::vector<ast::tacky::Instruction> mInstructions;
 
+    CToTacky(ast::NameGenerator& names) : mNames(names) {}
+
+    // Helpers for temporaries and labels
+    ast::tacky::Var makeTemporaryRegister() {
+        return mNames.makeTemporary();
+    }
+
+    std::pair<ast::tacky::Label, ast::tacky::Label> makeLabels(ast::NameKind first, ast::NameKind second) {
+        auto [firstLabel, secondLabel] = mNames.makeLabelPair(first, second);
+        return {firstLabel, secondLabel};
+    }
+
+    ast::SymbolId makeControlFlowLabel(ast::NameKind kind, ast::SymbolId label) {
+        return mNames.derive(kind, label);
+    }
+
     // Expression visitors
     ast::tacky::Val operator()(const ast::c::Expression& expr) {
         return std::visit(*this, expr);
@@ -117,7 +120,7 @@ struct CToTacky {
     ast::tacky::Val operator() (const ast::c::Binary& binary) {
         // Logical operations need to short circuit
         if (binary.mOp == ast::c::BinaryOperator::Logical_AND) {
-            auto [falseLabel, endLabel] = makeAndLabels();
+            auto [falseLabel, endLabel] = makeLabels(ast::NameKind::AndFalse, ast::NameKind::AndEnd);
             ast::tacky::Var result = makeTemporaryRegister();
 
             ast::tacky::Val expressionSrc1 = std::visit(*this, *binary.mLeft);
@@ -135,7 +138,7 @@ struct CToTacky {
             return result;
         }
         else if (binary.mOp == ast::c::BinaryOperator::Logical_OR) {
-            auto [trueLabel, endLabel] = makeOrLabels();
+            auto [trueLabel, endLabel] = makeLabels(ast::NameKind::OrTrue, ast::NameKind::OrEnd);
             ast::tacky::Var result = makeTemporaryRegister();
 
             ast::tacky::Val expressionSrc1 = std::visit(*this, *binary.mLeft);
@@ -204,7 +207,7 @@ struct CToTacky {
     }
 
     ast::tacky::Val operator()(const ast::c::Conditional& conditional) {
-        auto [expr2Label, endLabel] = makeConditionalLabels();
+        auto [expr2Label, endLabel] = makeLabels(ast::NameKind::CondElse, ast::NameKind::CondEnd);
         auto result = makeTemporaryRegister();
 
         // Conditional
@@ -281,7 +284,7 @@ struct CToTacky {
     }
 
     void operator()(const ast::c::If& ifStmt) {
-        auto [elseLabel, endLabel] = makeIfLabels();
+        auto [elseLabel, endLabel] = makeLabels(ast::NameKind::IfElse, ast::NameKind::IfEnd);
 
         ast::tacky::Val conditionResult = std::visit(*this, ifStmt.mCondition);
         if (!ifStmt.mElse.has_value()) {
@@ -313,40 +316,40 @@ struct CToTacky {
     }
 
     void operator()(const ast::c::Break& brk) {
-        mInstructions.emplace_back(ast::tacky::Jump("break_" + brk.mLabel));
+        mInstructions.emplace_back(ast::tacky::Jump(makeControlFlowLabel(ast::NameKind::Break, brk.mLabel)));
     }
 
     void operator()(const ast::c::Continue& cont) {
-        mInstructions.emplace_back(ast::tacky::Jump("continue_" + cont.mLabel));
+        mInstructions.emplace_back(ast::tacky::Jump(makeControlFlowLabel(ast::NameKind::Continue, cont.mLabel)));
     }
 
     void operator()(const ast::c::While& whileStmt) {
         // Continue label (and start) to dilineate start of loop
-        mInstructions.emplace_back(ast::tacky::Label("continue_" + whileStmt.mLabel));
+        mInstructions.emplace_back(ast::tacky::Label(makeControlFlowLabel(ast::NameKind::Continue, whileStmt.mLabel)));
         // Insert condition instructions and get result
         ast::tacky::Val conditionResult = std::visit(*this, whileStmt.mCondition);
         // Jump to break label past the loop if condition is zero
-        mInstructions.emplace_back(ast::tacky::JumpIfZero(conditionResult, "break_" + whileStmt.mLabel));
+        mInstructions.emplace_back(ast::tacky::JumpIfZero(conditionResult, makeControlFlowLabel(ast::NameKind::Break, whileStmt.mLabel)));
         // Execute loop body
         std::visit(*this, *whileStmt.mBody);
         // Unconditionally jump back to start of loop where condition will be evaluated
-        mInstructions.emplace_back(ast::tacky::Jump("continue_" + whileStmt.mLabel));
+        mInstructions.emplace_back(ast::tacky::Jump(makeControlFlowLabel(ast::NameKind::Continue, whileStmt.mLabel)));
         // Break label after the loop
-        mInstructions.emplace_back(ast::tacky::Label("break_" + whileStmt.mLabel));
+        mInstructions.emplace_back(ast::tacky::Label(makeControlFlowLabel(ast::NameKind::Break, whileStmt.mLabel)));
     }
 
     void operator()(const ast::c::DoWhile& doWhile) {
         // start label jump back to
-        mInstructions.emplace_back(ast::tacky::Label("start_" + doWhile.mLabel));
+        mInstructions.emplace_back(ast::tacky::Label(makeControlFlowLabel(ast::NameKind::Start, doWhile.mLabel)));
         // place loop body instructions in vector
         std::visit(*this, *doWhile.mBody);
         // continue label just before condition evaluation
-        mInstructions.emplace_back(ast::tacky::Label("continue_" + doWhile.mLabel));
+        mInstructions.emplace_back(ast::tacky::Label(makeControlFlowLabel(ast::NameKind::Continue, doWhile.mLabel)));
         ast::tacky::Val conditionResult = std::visit(*this, doWhile.mCondition);
         // return to start label if condition expression is not zero
-        mInstructions.emplace_back(ast::tacky::JumpIfNotZero(conditionResult, "start_" + doWhile.mLabel));
+        mInstructions.emplace_back(ast::tacky::JumpIfNotZero(conditionResult, makeControlFlowLabel(ast::NameKind::Start, doWhile.mLabel)));
         // break label for break statements to refer to outside the loop
-        mInstructions.emplace_back(ast::tacky::Label("break_" + doWhile.mLabel));
+        mInstructions.emplace_back(ast::tacky::Label(makeControlFlowLabel(ast::NameKind::Break, doWhile.mLabel)));
     }
 
     void operator()(const ast::c::For& forStmt) {
@@ -356,52 +359,92 @@ struct CToTacky {
         else
             (*this)(std::get<std::optional<ast::c::Expression>>(forStmt.mForInit));
         // start label
-        mInstructions.emplace_back(ast::tacky::Label("start_" + forStmt.mLabel));
+        mInstructions.emplace_back(ast::tacky::Label(makeControlFlowLabel(ast::NameKind::Start, forStmt.mLabel)));
         // condition
         auto conditionResult = (*this)(forStmt.mCondition);
         if (conditionResult.has_value())
-            mInstructions.emplace_back(ast::tacky::JumpIfZero(conditionResult.value(), "break_" + forStmt.mLabel));
+            mInstructions.emplace_back(ast::tacky::JumpIfZero(conditionResult.value(), makeControlFlowLabel(ast::NameKind::Break, forStmt.mLabel)));
         // Body instructions
         std::visit(*this, *forStmt.mBody);
         // continue label
-        mInstructions.emplace_back(ast::tacky::Label("continue_" + forStmt.mLabel));
+        mInstructions.emplace_back(ast::tacky::Label(makeControlFlowLabel(ast::NameKind::Continue, forStmt.mLabel)));
         // post expression
         (*this)(forStmt.mPost);
         // unconditionally jump to start
-        mInstructions.emplace_back(ast::tacky::Jump("start_" + forStmt.mLabel));
+        mInstructions.emplace_back(ast::tacky::Jump(makeControlFlowLabel(ast::NameKind::Start, forStmt.mLabel)));
         // break label outside loop (past unconditional jump)
-        mInstructions.emplace_back(ast::tacky::Label("break_" + forStmt.mLabel));
+        mInstructions.emplace_back(ast::tacky::Label(makeControlFlowLabel(ast::NameKind::Break, forStmt.mLabel)));
+    }
+
+    ast::SymbolId caseLabel(const ast::c::Switch& swtch, int cse) {
+        return mNames.derive(ast::NameKind::Case, swtch.mLabel, cse);
+    }
+
+    void emitCaseChain(const ast::c::Switch& swtch, const ast::tacky::Val& selector,
+                       std::span<const int> cases, ast::SymbolId fallback) {
+        for (int cse : cases)
+            mInstructions.emplace_back(ast::tacky::JumpIfEqual(selector, ast::tacky::Constant(cse), caseLabel(swtch, cse)));
+        mInstructions.emplace_back(ast::tacky::Jump(fallback));
+    }
+
+    void emitCaseTable(const ast::c::Switch& swtch, const ast::tacky::Val& selector,
+                       std::span<const int> cases, ast::SymbolId fallback) {
+        std::vector<ast::SymbolId> targets(static_cast<size_t>(static_cast<int64_t>(cases.back()) - cases.front() + 1), fallback);
+        for (int cse : cases)
+            targets[static_cast<int64_t>(cse) - cases.front()] = caseLabel(swtch, cse);
+        mInstructions.emplace_back(ast::tacky::JumpTable(
+            selector,
+            cases.front(),
+            std::move(targets),
+            fallback,
+            makeControlFlowLabel(ast::NameKind::SwitchTable, swtch.mLabel)
+        ));
+    }
+
+    // Cases below the middle one are handled after the label jumped to when the selector is less
+    // than it, the rest straight after the jump. first is the offset of cases in the whole list,
+    // which numbers the labels.
+    void emitCaseTree(const ast::c::Switch& swtch, const ast::tacky::Val& selector,
+                      std::span<const int> cases, size_t first, ast::SymbolId fallback) {
+        if (cases.size() < SWITCH_MIN_CASES) {
+            emitCaseChain(swtch, selector, cases, fallback);
+            return;
+        }
+        size_t middle = cases.size() / 2;
+        ast::SymbolId lower = mNames.derive(ast::NameKind::SwitchLess, swtch.mLabel, first + middle);
+        mInstructions.emplace_back(ast::tacky::JumpIfLess(selector, ast::tacky::Constant(cases[middle]), lower));
+        emitCaseTree(swtch, selector, cases.subspan(middle), first + middle, fallback);
+        mInstructions.emplace_back(ast::tacky::Label(lower));
+        emitCaseTree(swtch, selector, cases.first(middle), first, fallback);
     }
 
     void operator()(const ast::c::Switch& swtch) {
-        // For now it'll just be a sequence of if statements
         ast::tacky::Val selector = std::visit(*this, swtch.mSelector);
-        for (int cse : swtch.mCases) {
-            mInstructions.emplace_back(ast::tacky::JumpIfEqual(
-                selector,
-                ast::tacky::Constant(cse),
-                std::format("case_{}_{}", cse, swtch.mLabel)
-            ));
+        ast::SymbolId fallback = makeControlFlowLabel(
+            swtch.hasDefault ? ast::NameKind::Default : ast::NameKind::Break, swtch.mLabel);
+
+        std::vector<int> cases = swtch.mCases;
+        std::sort(cases.begin(), cases.end());
+        switch (choose_switch_lowering(cases)) {
+            case SwitchLowering::Chain:         emitCaseChain(swtch, selector, cases, fallback); break;
+            case SwitchLowering::JumpTable:     emitCaseTable(swtch, selector, cases, fallback); break;
+            case SwitchLowering::BinarySearch:  emitCaseTree(swtch, selector, cases, 0, fallback); break;
         }
-        if (swtch.hasDefault)
-            mInstructions.emplace_back(ast::tacky::Jump("default_" + swtch.mLabel));
-        else
-            mInstructions.emplace_back(ast::tacky::Jump("break_" + swtch.mLabel));
 
         std::visit(*this, *swtch.mBody);
 
-        mInstructions.emplace_back(ast::tacky::Label("break_" + swtch.mLabel));
+        mInstructions.emplace_back(ast::tacky::Label(makeControlFlowLabel(ast::NameKind::Break, swtch.mLabel)));
     }
 
     void operator()(const ast::c::Case& caseStmt) {
         mInstructions.emplace_back(ast::tacky::Label(
-            std::format("case_{}_{}", std::get<ast::c::Constant>(caseStmt.mCondition).mValue, caseStmt.mLabel)
+            mNames.derive(ast::NameKind::Case, caseStmt.mLabel, std::get<ast::c::Constant>(caseStmt.mCondition).mValue)
         ));
         std::visit(*this, *caseStmt.mStmt);
     }
 
     void operator()(const ast::c::Default& defaultStmt) {
-        mInstructions.emplace_back(ast::tacky::Label("default_" + defaultStmt.mLabel));
+        mInstructions.emplace_back(ast::tacky::Label(makeControlFlowLabel(ast::NameKind::Default, defaultStmt.mLabel)));
         std::visit(*this, *defaultStmt.mStmt);
     }
 
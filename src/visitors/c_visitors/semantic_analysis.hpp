@@ -6,94 +6,150 @@
 #include <vector>
 #include <optional>
 #include <variant>
-#include <unordered_map>
 #include <unordered_set>
 #include <format>
 #include "../../ast/ast_c.hpp"
 #include "../../ast/general.hpp"
+#include "../../ast/name_generator.hpp"
 
 namespace compiler::ast::c {
 
-// ------------------------------> Helper function for making variable names unique <------------------------------
+// ------------------------------> ScopedSymbolTable <------------------------------
 
-inline std::string makeUniqueVarName(const std::string& varName) {
-    static uint32_t tmpRegisterNum = 0;
-    // cv prefix for custom variable
-    return std::format("{}.cv{}", varName, tmpRegisterNum++);
-}
+/// Symbol table for nested scopes. Every declaration pushes a binding which shadows the previous
+/// binding of the same name, and the bindings themselves double as the undo log: leaving a scope
+/// pops the bindings made since it was entered and restores whatever they shadowed. Entering a
+/// scope is O(1) and leaving it is O(names declared in it).
+template<typename T>
+class ScopedSymbolTable {
+private:
+    static constexpr uint32_t NO_BINDING = UINT32_MAX;
+
+    struct Binding {
+        T mValue;
+        SymbolId mName;
+        uint32_t mScope;
+        uint32_t mShadowed;
+    };
+
+    // Innermost binding for each SymbolId, indexed by the id
+    std::vector<uint32_t> mInnermost;
+    std::vector<Binding> mBindings;
+    // Size of mBindings when each open scope was entered
+    std::vector<uint32_t> mScopeStarts;
+
+    uint32_t innermost(SymbolId name) const {
+        return name.mValue < mInnermost.size() ? mInnermost[name.mValue] : NO_BINDING;
+    }
+
+public:
+    void enterScope() {
+        mScopeStarts.push_back(static_cast<uint32_t>(mBindings.size()));
+    }
+
+    void exitScope() {
+        uint32_t scopeStart = mScopeStarts.back();
+        mScopeStarts.pop_back();
+        while (mBindings.size() > scopeStart) {
+            const Binding& binding = mBindings.back();
+            mInnermost[binding.mName.mValue] = binding.mShadowed;
+            mBindings.pop_back();
+        }
+    }
+
+    size_t depth() const { return mScopeStarts.size(); }
+
+    /// @brief Innermost visible binding of name, or nullptr if it isn't declared
+    T* find(SymbolId name) {
+        uint32_t index = innermost(name);
+        return index == NO_BINDING ? nullptr : &mBindings[index].mValue;
+    }
+
+    bool declaredInCurrentScope(SymbolId name) const {
+        uint32_t index = innermost(name);
+        return index != NO_BINDING && mBindings[index].mScope == depth();
+    }
+
+    /// @brief Bind name in the current scope, a binding already made in this scope is overwritten
+    void declare(SymbolId name, T value) {
+        uint32_t index = innermost(name);
+        if (index != NO_BINDING && mBindings[index].mScope == depth()) {
+            mBindings[index].mValue = std::move(value);
+            return;
+        }
+        if (name.mValue >= mInnermost.size())
+            mInnermost.resize(std::max<size_t>(name.mValue + 1, interner().size()), NO_BINDING);
+        mInnermost[name.mValue] = static_cast<uint32_t>(mBindings.size());
+        mBindings.push_back(Binding{std::move(value), name, static_cast<uint32_t>(depth()), index});
+    }
+};
 
 // ------------------------------> IdentifierResolution <------------------------------
 
 struct IdentifierData {
-    std::string mNewName;
-    bool mFromCurrentScope;
+    SymbolId mNewName;
     bool mHasExternalLinkage;
 
     IdentifierData() = default;
-    IdentifierData(std::string newName, bool fromCurrentScope, bool hasExternalLinkage)
-    :   mNewName(std::move(newName)), mFromCurrentScope(fromCurrentScope), mHasExternalLinkage(hasExternalLinkage) {}
+    IdentifierData(SymbolId newName, bool hasExternalLinkage)
+    :   mNewName(newName), mHasExternalLinkage(hasExternalLinkage) {}
 };
 
 struct IdentifierResolution {
 
 private:
-    std::vector<std::unordered_map<std::string, IdentifierData>> mIdentifierMaps;
+    NameGenerator& mNames;
+    ScopedSymbolTable<IdentifierData> mIdentifiers;
 
     // helper methods
-    auto& getCurrentScope() { return mIdentifierMaps.back(); }
-    const auto& getCurrentScope() const { return mIdentifierMaps.back(); }
-
     void createNewScope() {
-        auto newMap = getCurrentScope();
-        for (auto& [key, identifierData] : newMap) {
-            identifierData.mFromCurrentScope = false;
-        }
-        mIdentifierMaps.push_back(newMap);
+        mIdentifiers.enterScope();
     }
 
     void exitScope() {
-        mIdentifierMaps.pop_back();
+        mIdentifiers.exitScope();
     };
 
-    bool isGlobalScope() { return mIdentifierMaps.size() == 1; }
+    bool isGlobalScope() { return mIdentifiers.depth() == 1; }
 
     // helper function for both variable declarations and declarations within function parameters
-    void resolveVarDeclName(std::string& variableName) {
-        auto& currentScope = getCurrentScope();
+    void resolveVarDeclName(SymbolId& variableName) {
+        if (mIdentifiers.declaredInCurrentScope(variableName))
+            throw std::runtime_error(std::format("Variable {} has already been declared!", spelling(variableName)));
 
-        if (currentScope.contains(variableName) && currentScope[variableName].mFromCurrentScope)
-            throw std::runtime_error(std::format("Variable {} has already been declared!", variableName));
-
-        std::string uniqueName = makeUniqueVarName(variableName);
-        currentScope.insert_or_assign(variableName, IdentifierData(uniqueName, true, false));
+        // cv suffix for custom variable
+        SymbolId uniqueName = mNames.makeUniqueVar(variableName);
+        mIdentifiers.declare(variableName, IdentifierData(uniqueName, false));
 
         // Replace declaration identifier with new name.
         variableName = uniqueName;
     }
 
 public:
+    IdentifierResolution(NameGenerator& names) : mNames(names) {}
+
     // Expression visitors
     void operator()(const Constant& constant) const {}
 
-    void operator()(Variable& variable) const {
-        auto& currentScope = getCurrentScope();
-        if (!currentScope.contains(variable.mIdentifier)) {
-            throw std::runtime_error(std::format("Variable {} is used before it is declared!", variable.mIdentifier));
+    void operator()(Variable& variable) {
+        const IdentifierData* identifierData = mIdentifiers.find(variable.mIdentifier);
+        if (!identifierData) {
+            throw std::runtime_error(std::format("Variable {} is used before it is declared!", spelling(variable.mIdentifier)));
         }
         
-        variable.mIdentifier = currentScope.at(variable.mIdentifier).mNewName;
+        variable.mIdentifier = identifierData->mNewName;
     }
 
-    void operator()(Unary& unary) const {
+    void operator()(Unary& unary) {
         std::visit(*this, *unary.mExpr);
     }
 
-    void operator()(Binary& binary) const {
+    void operator()(Binary& binary) {
         std::visit(*this, *binary.mLeft);
         std::visit(*this, *binary.mRight);
     }
 
-    void operator()(Assignment& assignment) const {
+    void operator()(Assignment& assignment) {
         if (!std::holds_alternative<Variable>(*assignment.mLeft))
             throw std::runtime_error("Assignment contains invalid lvalue!");
 
@@ -101,28 +157,28 @@ public:
         std::visit(*this, *assignment.mRight);
     }
 
-    void operator()(Crement& crement) const {
+    void operator()(Crement& crement) {
         if (!std::holds_alternative<Variable>(*crement.mVar))
             throw std::runtime_error("Assignment contains invalid lvalue!");
         
         std::visit(*this, *crement.mVar);
     }
 
-    void operator()(Conditional& conditional) const {
+    void operator()(Conditional& conditional) {
         std::visit(*this, *conditional.mCondition);
         std::visit(*this, *conditional.mThen);
         std::visit(*this, *conditional.mElse);
     }
 
-    void operator()(std::optional<Expression>& optionalExpression) const {
+    void operator()(std::optional<Expression>& optionalExpression) {
         if (optionalExpression.has_value())
             std::visit(*this, optionalExpression.value());
     }
 
-    void operator()(FunctionCall& functionCall) const {
-        auto& currentScope = getCurrentScope();
-        if (currentScope.contains(functionCall.mIdentifier)) {
-            functionCall.mIdentifier = currentScope.at(functionCall.mIdentifier).mNewName;
+    void operator()(FunctionCall& functionCall) {
+        const IdentifierData* identifierData = mIdentifiers.find(functionCall.mIdentifier);
+        if (identifierData) {
+            functionCall.mIdentifier = identifierData->mNewName;
             for (auto& arg : functionCall.mArgs)
                 std::visit(*this, *arg);
         }
@@ -144,18 +200,16 @@ public:
     }
 
     void operator()(FuncDecl& funcDecl) {
-        auto& currentScope = getCurrentScope();
         bool declInGlobalScope = isGlobalScope();
 
         // Check that another identifier with internal linkage does not exist else throw an error
-        if (currentScope.contains(funcDecl.mIdentifier)) {
-            auto prevEntry = currentScope[funcDecl.mIdentifier];
-            if (prevEntry.mFromCurrentScope && !prevEntry.mHasExternalLinkage)
+        if (mIdentifiers.declaredInCurrentScope(funcDecl.mIdentifier)) {
+            if (!mIdentifiers.find(funcDecl.mIdentifier)->mHasExternalLinkage)
                 throw std::runtime_error("Function without external linkage declared more than once!");
         }
 
         // Add function declaration to current scope if not already
-        currentScope.insert_or_assign(funcDecl.mIdentifier, IdentifierData(funcDecl.mIdentifier, true, true));
+        mIdentifiers.declare(funcDecl.mIdentifier, IdentifierData(funcDecl.mIdentifier, true));
 
         // Enter function scope
         createNewScope();
@@ -179,11 +233,11 @@ public:
         std::visit(*this, statement);
     }
 
-    void operator()(Return& rs) const {
+    void operator()(Return& rs) {
         std::visit(*this, rs.mExpr);
     }
 
-    void operator()(ExpressionStatement& es) const {
+    void operator()(ExpressionStatement& es) {
         std::visit(*this, es.mExpr);
     }
 
@@ -269,7 +323,7 @@ public:
     // Program visitor
     void operator()(Program& program) {
         // Create global scope
-        mIdentifierMaps.push_back(std::unordered_map<std::string, IdentifierData>());
+        createNewScope();
         for (FuncDecl& funcDecl : program.mDeclarations)
             (*this)(funcDecl);
     }
@@ -289,7 +343,7 @@ public:
 
     void operator()(const Variable& variable) {
         if (!std::holds_alternative<Int>(mSymbolMap.at(variable.mIdentifier).mType))
-            throw std::runtime_error("Function " + variable.mIdentifier + " used as a variable!");
+            throw std::runtime_error(std::format("Function {} used as a variable!", spelling(variable.mIdentifier)));
     }
 
     void operator()(const Unary& unary) {
@@ -320,9 +374,9 @@ public:
         // guaranteed to be in symbol map as no errors were thrown during identifier resolution, i.e. a declaration is in scope
         auto symbolInfo = mSymbolMap.at(functionCall.mIdentifier);
         if (std::holds_alternative<Int>(symbolInfo.mType))
-            throw std::runtime_error("Variable " + functionCall.mIdentifier + " used as a function name!");
+            throw std::runtime_error(std::format("Variable {} used as a function name!", spelling(functionCall.mIdentifier)));
         if (std::get<FuncType>(symbolInfo.mType).mParamCount != functionCall.mArgs.size())
-            throw std::runtime_error("Function " + functionCall.mIdentifier + " with the wrong number of arguments!");
+            throw std::runtime_error(std::format("Function {} with the wrong number of arguments!", spelling(functionCall.mIdentifier)));
         for (auto& arg : functionCall.mArgs)
             std::visit(*this, *arg);
     }
@@ -353,7 +407,7 @@ public:
                 throw std::runtime_error("Incompatible function declarations!");
             alreadyDefined = symbolInfo.mDefined;
             if (alreadyDefined && hasBody)
-                throw std::runtime_error("Function " + funcDecl.mIdentifier + " is defined more than once!");
+                throw std::runtime_error(std::format("Function {} is defined more than once!", spelling(funcDecl.mIdentifier)));
         }
 
         mSymbolMap.insert_or_assign(funcDecl.mIdentifier, SymbolInfo(funcType, hasBody || alreadyDefined, true));
@@ -451,27 +505,18 @@ public:
 
 // ------------------------------> ControlFlow Labelling <------------------------------
 
-// ------------------------------> Helper functions <------------------------------
-
-inline std::string makeUniqueLoopID() {
-    static uint32_t currentLoopID = 0;
-    return std::format("loop.{}", currentLoopID++);
-}
-
-inline std::string makeUniqueSwitchID() {
-    static uint32_t currentSwitchID = 0;
-    return std::format("switch.{}", currentSwitchID++);
-}
-
 struct ControlFlowLabelling {
 
-    std::vector<std::string> loopIDs;
-    std::vector<std::string> switchIDs;
+    NameGenerator& mNames;
+    std::vector<SymbolId> loopIDs;
+    std::vector<SymbolId> switchIDs;
     std::vector<Switch*> switchPtrs;
-    std::vector<std::string> switchAndLoopIDs;
+    std::vector<SymbolId> switchAndLoopIDs;
+
+    ControlFlowLabelling(NameGenerator& names) : mNames(names) {}
 
     void newLoop() {
-        loopIDs.push_back(makeUniqueLoopID());
+        loopIDs.push_back(mNames.makeLoopID());
         switchAndLoopIDs.push_back(loopIDs.back());
     }
 
@@ -481,7 +526,7 @@ struct ControlFlowLabelling {
     }
 
     void newSwitch(Switch* swtchPtr) {
-        switchIDs.push_back(makeUniqueSwitchID());
+        switchIDs.push_back(mNames.makeSwitchID());
         switchAndLoopIDs.push_back(switchIDs.back());
         switchPtrs.push_back(swtchPtr);
     }
@@ -639,15 +684,18 @@ struct ControlFlowLabelling {
 // make sure all labels exist within a function if they're used
 struct LabelResolution {
 
-    std::unordered_set<std::string> mPresentLabels;
-    std::unordered_set<std::string> mNeededLabels;
+    NameGenerator& mNames;
+    std::unordered_set<SymbolId> mPresentLabels;
+    std::unordered_set<SymbolId> mNeededLabels;
 
     int32_t functionCounter = 0;
 
+    LabelResolution(NameGenerator& names) : mNames(names) {}
+
     void checkNeededLabelsInPresentLabels() const {
         for (auto& label : mNeededLabels) {
             if (!mPresentLabels.contains(label))
-                throw std::runtime_error(std::format("Label {} used but not defined", label));
+                throw std::runtime_error(std::format("Label {} used but not defined", spelling(label)));
         }
     }
 
@@ -704,16 +752,16 @@ struct LabelResolution {
     }
 
     void operator()(GoTo& gotoStmt) {
-        std::string newLabel = std::format("{}.fl{}", gotoStmt.mTarget, functionCounter);
+        SymbolId newLabel = mNames.derive(NameKind::FunctionLabel, gotoStmt.mTarget, functionCounter);
         gotoStmt.mTarget = newLabel;
         if (!mNeededLabels.contains(gotoStmt.mTarget))
             mNeededLabels.insert(gotoStmt.mTarget);
     }
 
     void operator()(LabelledStatement& labelledStmt) {
-        std::string newLabel = std::format("{}.fl{}", labelledStmt.mIdentifier, functionCounter);
+        SymbolId newLabel = mNames.derive(NameKind::FunctionLabel, labelledStmt.mIdentifier, functionCounter);
         if (mPresentLabels.contains(newLabel))
-            throw std::runtime_error(std::format("Label: {} already declared!", labelledStmt.mIdentifier));
+            throw std::runtime_error(std::format("Label: {} already declared!", spelling(labelledStmt.mIdentifier)));
         
         mPresentLabels.insert(newLabel);
         labelledStmt.mIdentifier = newLabel;
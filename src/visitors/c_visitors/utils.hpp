@@ -258,8 +258,10 @@ struct PrintVisitor {
 
 // ------------------------------> Copy Utils <------------------------------
 
-// Print Visitor
+// Copy Visitor, copied expressions are allocated in mArena
 struct CopyVisitor {
+    Arena& mArena;
+
     void operator()(const Expression& expr) const {
         std::visit(*this, expr);
     }
@@ -275,27 +277,27 @@ struct CopyVisitor {
     Expression operator()(const Unary& unary) const {
         return Unary(
             unary.mOp,
-            std::make_unique<Expression>(std::visit(*this, *unary.mExpr)));
+            mArena.make<Expression>(std::visit(*this, *unary.mExpr)));
     }
 
     Expression operator()(const Binary& binary) const {
         return Binary(
             binary.mOp,
-            std::make_unique<Expression>(std::visit(*this, *binary.mLeft)),
-            std::make_unique<Expression>(std::visit(*this, *binary.mRight))
+            mArena.make<Expression>(std::visit(*this, *binary.mLeft)),
+            mArena.make<Expression>(std::visit(*this, *binary.mRight))
         );
     }
 
     Expression operator()(const Assignment& assignment) const {
         return Assignment(
-            std::make_unique<Expression>(std::visit(*this, *assignment.mLeft)),
-            std::make_unique<Expression>(std::visit(*this, *assignment.mRight))
+            mArena.make<Expression>(std::visit(*this, *assignment.mLeft)),
+            mArena.make<Expression>(std::visit(*this, *assignment.mRight))
         );
     }
 
     Expression operator()(const Crement& crement) const {
         return Crement(
-            std::make_unique<Expression>(std::visit(*this, *crement.mVar)),
+            mArena.make<Expression>(std::visit(*this, *crement.mVar)),
             crement.mIncrement,
             crement.mPost
         );
@@ -303,17 +305,17 @@ struct CopyVisitor {
 
     Expression operator()(const Conditional& conditional) const {
         return Conditional(
-            std::make_unique<Expression>(std::visit(*this, *conditional.mCondition)),
-            std::make_unique<Expression>(std::visit(*this, *conditional.mThen)),
-            std::make_unique<Expression>(std::visit(*this, *conditional.mElse))
+            mArena.make<Expression>(std::visit(*this, *conditional.mCondition)),
+            mArena.make<Expression>(std::visit(*this, *conditional.mThen)),
+            mArena.make<Expression>(std::visit(*this, *conditional.mElse))
         );
     }
 
     Expression operator()(const FunctionCall& functionCall) const {
-        std::vector<std::unique_ptr<Expression>> args;
+        std::vector<Expression*> args;
         for (const auto& arg : functionCall.mArgs)
-            args.emplace_back(std::make_unique<Expression>(std::visit(*this, *arg)));
-        return FunctionCall(functionCall.mIdentifier, std::move(args));
+            args.emplace_back(mArena.make<Expression>(std::visit(*this, *arg)));
+        return FunctionCall(functionCall.mIdentifier, mArena.makeArray(args));
     }
 
     // Declaration
@@ -452,13 +454,14 @@ struct CopyVisitor {
         return Block(std::move(blockItems));
     }
 
-    // Program visitor
+    // Program visitor, the copy gets its own arena so it doesn't depend on the lifetime of mArena
     Program operator()(const Program& program) const {
-        std::vector<FuncDecl> funcDecls;
+        Program copiedProgram;
+        CopyVisitor programCopier{*copiedProgram.mArena};
         for (const auto& funcDecl : program.mDeclarations) {
-            funcDecls.push_back(std::get<FuncDecl>((*this)(funcDecl)));
+            copiedProgram.addFuncDeclaration(std::get<FuncDecl>(programCopier(funcDecl)));
         }
-        return Program(std::move(funcDecls));
+        return copiedProgram;
     }
 };
 
@@ -7,6 +7,8 @@
 #include <vector>
 #include <unordered_map>
 #include <array>
+#include <bit>
+#include <cstdint>
 
 
 namespace compiler::codegen {
@@ -54,6 +56,34 @@ inline constexpr asmb::ConditionCode tacky_binop_to_condition_code(tacky::Binary
     throw std::invalid_argument("Invalid tacky::BinaryOperator in tacky_binop_to_condition_code");
 }
 
+// ------------------------------> Division by constants <------------------------------
+// Granlund-Montgomery: n / d for a constant d is the high half of n * mMultiplier shifted right by
+// mShift, plus one when n is negative so the quotient rounds towards zero (Hacker's Delight 10-1).
+
+struct DivisionMagic {
+    int32_t mMultiplier;
+    int32_t mShift;
+};
+
+/// @brief Multiplier and shift for signed division by divisor, which must be at least 2
+constexpr DivisionMagic signed_division_magic(uint32_t divisor) {
+    constexpr uint32_t two31 = 0x80000000u;
+    uint32_t anc = two31 - 1 - two31 % divisor;     // largest n with n % divisor == divisor - 1
+    uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc;
+    uint32_t q2 = two31 / divisor, r2 = two31 - q2 * divisor;
+    int32_t p = 31;
+    uint32_t delta = 0;
+    do {
+        ++p;
+        q1 *= 2; r1 *= 2;
+        if (r1 >= anc) { ++q1; r1 -= anc; }
+        q2 *= 2; r2 *= 2;
+        if (r2 >= divisor) { ++q2; r2 -= divisor; }
+        delta = divisor - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    return DivisionMagic{static_cast<int32_t>(q2 + 1), p - 32};
+}
+
 // ------------------------------> TackyToAsmb (0th pass) <------------------------------
 
 struct TackyToAsmb {
@@ -94,11 +124,84 @@ struct TackyToAsmb {
         mInstructions.emplace_back(asmb::Unary(unop, std::move(dst)));
     }
 
+    /// @brief n / divisor or n % divisor without idiv, false if the divisor is 0 or INT_MIN
+    bool divideByConstant(bool remainder, const asmb::Operand& n, int32_t divisor, const asmb::Operand& dst) {
+        if (divisor == 0 || divisor == INT32_MIN)
+            return false;
+        auto ax = asmb::Reg(asmb::RegisterName::AX);
+        auto dx = asmb::Reg(asmb::RegisterName::DX);
+        uint32_t magnitude = divisor < 0 ? 0u - static_cast<uint32_t>(divisor) : static_cast<uint32_t>(divisor);
+
+        if (magnitude == 1) {
+            if (remainder)
+                mInstructions.emplace_back(asmb::Mov(asmb::Imm(0), dst));
+            else {
+                mInstructions.emplace_back(asmb::Mov(n, dst));
+                if (divisor < 0)
+                    mInstructions.emplace_back(asmb::Unary(asmb::UnaryOperator::Negate, dst));
+            }
+            return true;
+        }
+
+        // Powers of two shift right after adding 2^k - 1 to negative n, which rounds towards zero
+        if (std::has_single_bit(magnitude)) {
+            int32_t shift = std::countr_zero(magnitude);
+            mInstructions.emplace_back(asmb::Mov(n, ax));
+            mInstructions.emplace_back(asmb::Binary(asmb::BinaryOperator::Right_Shift, asmb::Imm(31), ax));
+            mInstructions.emplace_back(asmb::Binary(asmb::BinaryOperator::Bitwise_AND, asmb::Imm(static_cast<int32_t>(magnitude - 1)), ax));
+            mInstructions.emplace_back(asmb::Binary(asmb::BinaryOperator::Add, n, ax));
+            if (remainder) {
+                // n - (n rounded towards zero to a multiple of 2^k)
+                mInstructions.emplace_back(asmb::Binary(asmb::BinaryOperator::Bitwise_AND, asmb::Imm(-static_cast<int32_t>(magnitude)), ax));
+                mInstructions.emplace_back(asmb::Mov(n, dx));
+                mInstructions.emplace_back(asmb::Binary(asmb::BinaryOperator::Subtract, ax, dx));
+                mInstructions.emplace_back(asmb::Mov(dx, dst));
+                return true;
+            }
+            mInstructions.emplace_back(asmb::Binary(asmb::BinaryOperator::Right_Shift, asmb::Imm(shift), ax));
+            if (divisor < 0)
+                mInstructions.emplace_back(asmb::Unary(asmb::UnaryOperator::Negate, ax));
+            mInstructions.emplace_back(asmb::Mov(ax, dst));
+            return true;
+        }
+
+        // The quotient by the magnitude ends up in DX, n / -d is -(n / d)
+        DivisionMagic magic = signed_division_magic(magnitude);
+        mInstructions.emplace_back(asmb::Mov(asmb::Imm(magic.mMultiplier), ax));
+        mInstructions.emplace_back(asmb::Imul(n));
+        if (magic.mMultiplier < 0)
+            mInstructions.emplace_back(asmb::Binary(asmb::BinaryOperator::Add, n, dx));
+        if (magic.mShift > 0)
+            mInstructions.emplace_back(asmb::Binary(asmb::BinaryOperator::Right_Shift, asmb::Imm(magic.mShift), dx));
+        mInstructions.emplace_back(asmb::Mov(n, ax));
+        mInstructions.emplace_back(asmb::Binary(asmb::BinaryOperator::Right_Shift, asmb::Imm(31), ax));
+        mInstructions.emplace_back(asmb::Binary(asmb::BinaryOperator::Subtract, ax, dx));
+        if (divisor < 0)
+            mInstructions.emplace_back(asmb::Unary(asmb::UnaryOperator::Negate, dx));
+
+        if (remainder) {
+            // n - quotient * divisor
+            mInstructions.emplace_back(asmb::Binary(asmb::BinaryOperator::Multiply, asmb::Imm(divisor), dx));
+            mInstructions.emplace_back(asmb::Mov(n, ax));
+            mInstructions.emplace_back(asmb::Binary(asmb::BinaryOperator::Subtract, dx, ax));
+            mInstructions.emplace_back(asmb::Mov(ax, dst));
+        }
+        else
+            mInstructions.emplace_back(asmb::Mov(dx, dst));
+        return true;
+    }
+
     void operator()(const tacky::Binary& binary) {
         asmb::Operand src1 = std::visit(*this, binary.mSrc1);
         asmb::Operand src2 = std::visit(*this, binary.mSrc2);
         asmb::Operand dst = std::visit(*this, binary.mDst);
 
+        auto* divisor = std::get_if<tacky::Constant>(&binary.mSrc2);
+        if ((binary.mOp == tacky::BinaryOperator::Divide || binary.mOp == tacky::BinaryOperator::Modulo)
+            && divisor && divideByConstant(binary.mOp == tacky::BinaryOperator::Modulo, src1,
+                                           static_cast<int32_t>(divisor->mValue), dst))
+            return;
+
         if (binary.mOp == tacky::BinaryOperator::Divide) {
             mInstructions.emplace_back(asmb::Mov(std::move(src1), asmb::Reg(asmb::RegisterName::AX)));
             mInstructions.emplace_back(asmb::Cdq());
@@ -118,6 +221,14 @@ struct TackyToAsmb {
             mInstructions.emplace_back(asmb::Mov(asmb::Imm(0), dst));
             mInstructions.emplace_back(asmb::SetCC(cc, std::move(dst)));
         }
+        // Shift count has to be in CX
+        else if (binary.mOp == tacky::BinaryOperator::Left_Shift
+              || binary.mOp == tacky::BinaryOperator::Right_Shift) {
+            asmb::BinaryOperator asmbOp = tacky_to_asmb_binop(binary.mOp);
+            mInstructions.emplace_back(asmb::Mov(std::move(src1), dst));
+            mInstructions.emplace_back(asmb::Mov(std::move(src2), asmb::Reg(asmb::RegisterName::CX)));
+            mInstructions.emplace_back(asmb::Binary(asmbOp, asmb::Reg(asmb::RegisterName::CX), std::move(dst)));
+        }
         else {
             asmb::BinaryOperator asmbOp = tacky_to_asmb_binop(binary.mOp);
             mInstructions.emplace_back(asmb::Mov(std::move(src1), dst));
@@ -151,6 +262,23 @@ struct TackyToAsmb {
         mInstructions.emplace_back(asmb::JmpCC(asmb::ConditionCode::E, jmpIfEqual.mTarget));
     }
 
+    void operator()(const tacky::JumpIfLess& jmpIfLess) {
+        mInstructions.emplace_back(asmb::Cmp(std::visit(*this, jmpIfLess.mSrc2), std::visit(*this, jmpIfLess.mSrc1)));
+        mInstructions.emplace_back(asmb::JmpCC(asmb::ConditionCode::L, jmpIfLess.mTarget));
+    }
+
+    void operator()(const tacky::JumpTable& jumpTable) {
+        // Rebase the index to zero, then one unsigned compare catches both ends of the range
+        auto index = asmb::Reg(asmb::RegisterName::R10);
+        mInstructions.emplace_back(asmb::Mov(std::visit(*this, jumpTable.mIndex), index));
+        if (jumpTable.mLow != 0)
+            mInstructions.emplace_back(asmb::Binary(asmb::BinaryOperator::Subtract, asmb::Imm(jumpTable.mLow), index));
+        int32_t last = static_cast<int32_t>(jumpTable.mTargets.size()) - 1;
+        mInstructions.emplace_back(asmb::Cmp(asmb::Imm(last), index));
+        mInstructions.emplace_back(asmb::JmpCC(asmb::ConditionCode::A, jumpTable.mDefault));
+        mInstructions.emplace_back(asmb::JmpTable(index, jumpTable.mTable, jumpTable.mTargets));
+    }
+
     void operator()(const tacky::Label& label) {
         mInstructions.emplace_back(asmb::Label(label.mIdentifier));
     }
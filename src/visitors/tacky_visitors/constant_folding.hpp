@@ -0,0 +1,208 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <variant>
+#include "../../ast/ast_tacky.hpp"
+
+namespace compiler::ast::tacky {
+
+// ------------------------------> Constant evaluation <------------------------------
+// Values are evaluated as 32 bit two's complement ints, which is what the generated code computes.
+// Anything that would trap or is undefined for the target (division by zero, INT_MIN / -1,
+// out of range shift counts) is not folded and is left for the program to execute.
+
+inline constexpr std::optional<uint32_t> fold_unary(UnaryOperator op, uint32_t src) {
+    switch (op) {
+        case UnaryOperator::Complement:     return ~src;
+        case UnaryOperator::Negate:         return 0u - src;
+        case UnaryOperator::Logical_NOT:    return src == 0 ? 1u : 0u;
+    }
+    return std::nullopt;
+}
+
+inline constexpr std::optional<uint32_t> fold_binary(BinaryOperator op, uint32_t src1, uint32_t src2) {
+    int32_t lhs = static_cast<int32_t>(src1);
+    int32_t rhs = static_cast<int32_t>(src2);
+
+    switch (op) {
+        // Wrap around instead of overflowing, done on the unsigned representation
+        case BinaryOperator::Add:               return src1 + src2;
+        case BinaryOperator::Subtract:          return src1 - src2;
+        case BinaryOperator::Multiply:          return src1 * src2;
+
+        case BinaryOperator::Divide:
+            if (rhs == 0 || (lhs == INT32_MIN && rhs == -1)) return std::nullopt;
+            return static_cast<uint32_t>(lhs / rhs);
+        case BinaryOperator::Modulo:
+            if (rhs == 0 || (lhs == INT32_MIN && rhs == -1)) return std::nullopt;
+            return static_cast<uint32_t>(lhs % rhs);
+
+        // Shift counts must be within the width of an int, left shifts behave like sall and
+        // right shifts are arithmetic like sarl
+        case BinaryOperator::Left_Shift:
+            if (rhs < 0 || rhs >= 32) return std::nullopt;
+            return src1 << rhs;
+        case BinaryOperator::Right_Shift:
+            if (rhs < 0 || rhs >= 32) return std::nullopt;
+            return static_cast<uint32_t>(lhs >> rhs);
+
+        case BinaryOperator::Bitwise_AND:       return src1 & src2;
+        case BinaryOperator::Bitwise_OR:        return src1 | src2;
+        case BinaryOperator::Bitwise_XOR:       return src1 ^ src2;
+
+        case BinaryOperator::Is_Equal:          return lhs == rhs ? 1u : 0u;
+        case BinaryOperator::Not_Equal:         return lhs != rhs ? 1u : 0u;
+        case BinaryOperator::Less_Than:         return lhs < rhs ? 1u : 0u;
+        case BinaryOperator::Greater_Than:      return lhs > rhs ? 1u : 0u;
+        case BinaryOperator::Less_Or_Equal:     return lhs <= rhs ? 1u : 0u;
+        case BinaryOperator::Greater_Or_Equal:  return lhs >= rhs ? 1u : 0u;
+    }
+    return std::nullopt;
+}
+
+// ------------------------------> Constant Folding <------------------------------
+
+struct FoldingStats {
+    uint32_t mFolded = 0;       // instructions replaced by a simpler one
+    uint32_t mEliminated = 0;   // instructions removed outright
+
+    FoldingStats& operator+=(const FoldingStats& other) {
+        mFolded += other.mFolded;
+        mEliminated += other.mEliminated;
+        return *this;
+    }
+
+    bool changed() const { return mFolded || mEliminated; }
+};
+
+struct ConstantFolding {
+    std::vector<Instruction> mInstructions;
+    FoldingStats mStats;
+
+    static const Constant* asConstant(const Val& val) {
+        return std::get_if<Constant>(&val);
+    }
+
+    // Instruction visitors, each one moves its (possibly folded) instruction into mInstructions
+    void operator()(Unary& unary) {
+        if (auto* src = asConstant(unary.mSrc)) {
+            if (auto result = fold_unary(unary.mOp, src->mValue)) {
+                mInstructions.emplace_back(Copy(Constant(*result), std::move(unary.mDst)));
+                ++mStats.mFolded;
+                return;
+            }
+        }
+        mInstructions.emplace_back(std::move(unary));
+    }
+
+    void operator()(Binary& binary) {
+        auto* src1 = asConstant(binary.mSrc1);
+        auto* src2 = asConstant(binary.mSrc2);
+        if (src1 && src2) {
+            if (auto result = fold_binary(binary.mOp, src1->mValue, src2->mValue)) {
+                mInstructions.emplace_back(Copy(Constant(*result), std::move(binary.mDst)));
+                ++mStats.mFolded;
+                return;
+            }
+        }
+        mInstructions.emplace_back(std::move(binary));
+    }
+
+    void operator()(JumpIfZero& jumpIfZero) {
+        if (auto* condition = asConstant(jumpIfZero.mCondition)) {
+            if (condition->mValue == 0) {
+                mInstructions.emplace_back(Jump(jumpIfZero.mTarget));
+                ++mStats.mFolded;
+            }
+            else
+                ++mStats.mEliminated;
+            return;
+        }
+        mInstructions.emplace_back(std::move(jumpIfZero));
+    }
+
+    void operator()(JumpIfNotZero& jumpIfNotZero) {
+        if (auto* condition = asConstant(jumpIfNotZero.mCondition)) {
+            if (condition->mValue != 0) {
+                mInstructions.emplace_back(Jump(jumpIfNotZero.mTarget));
+                ++mStats.mFolded;
+            }
+            else
+                ++mStats.mEliminated;
+            return;
+        }
+        mInstructions.emplace_back(std::move(jumpIfNotZero));
+    }
+
+    void operator()(JumpIfEqual& jumpIfEqual) {
+        auto* src1 = asConstant(jumpIfEqual.mSrc1);
+        auto* src2 = asConstant(jumpIfEqual.mSrc2);
+        if (src1 && src2) {
+            if (src1->mValue == src2->mValue) {
+                mInstructions.emplace_back(Jump(jumpIfEqual.mTarget));
+                ++mStats.mFolded;
+            }
+            else
+                ++mStats.mEliminated;
+            return;
+        }
+        mInstructions.emplace_back(std::move(jumpIfEqual));
+    }
+
+    void operator()(JumpIfLess& jumpIfLess) {
+        auto* src1 = asConstant(jumpIfLess.mSrc1);
+        auto* src2 = asConstant(jumpIfLess.mSrc2);
+        if (src1 && src2) {
+            if (static_cast<int32_t>(src1->mValue) < static_cast<int32_t>(src2->mValue)) {
+                mInstructions.emplace_back(Jump(jumpIfLess.mTarget));
+                ++mStats.mFolded;
+            }
+            else
+                ++mStats.mEliminated;
+            return;
+        }
+        mInstructions.emplace_back(std::move(jumpIfLess));
+    }
+
+    void operator()(JumpTable& jumpTable) {
+        if (auto* index = asConstant(jumpTable.mIndex)) {
+            int64_t offset = static_cast<int64_t>(static_cast<int32_t>(index->mValue)) - jumpTable.mLow;
+            bool inRange = offset >= 0 && offset < static_cast<int64_t>(jumpTable.mTargets.size());
+            mInstructions.emplace_back(Jump(inRange ? jumpTable.mTargets[offset] : jumpTable.mDefault));
+            ++mStats.mFolded;
+            return;
+        }
+        mInstructions.emplace_back(std::move(jumpTable));
+    }
+
+    // Nothing to fold in the remaining instructions
+    template<typename T>
+    void operator()(T& instruction) {
+        mInstructions.emplace_back(std::move(instruction));
+    }
+
+    // Function visitor
+    FoldingStats operator()(Function& function) {
+        mInstructions.clear();
+        mInstructions.reserve(function.mBody.size());
+        mStats = FoldingStats();
+
+        for (auto& instruction : function.mBody)
+            std::visit(*this, instruction);
+
+        function.mBody = std::move(mInstructions);
+        mInstructions = std::vector<Instruction>();
+        return mStats;
+    }
+
+    // Program visitor
+    FoldingStats operator()(Program& program) {
+        FoldingStats total;
+        for (auto& function : program.mFunctions)
+            total += (*this)(function);
+        return total;
+    }
+};
+
+}
@@ -0,0 +1,317 @@
+#pragma once
+#include <cstdint>
+#include <format>
+#include <ostream>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+#include "../../ast/ast_tacky.hpp"
+#include "../../ast/interner.hpp"
+
+namespace compiler::ast::tacky {
+
+// ------------------------------> Jump Targets <------------------------------
+
+/// @brief Calls f with every label the instruction may jump to
+template<typename InstructionType, typename F>
+void for_each_jump_target(InstructionType& instruction, F&& f) {
+    std::visit([&](auto& inst) {
+        using T = std::decay_t<decltype(inst)>;
+        if constexpr (std::is_same_v<T, Jump> || std::is_same_v<T, JumpIfZero> || std::is_same_v<T, JumpIfNotZero>
+                   || std::is_same_v<T, JumpIfEqual> || std::is_same_v<T, JumpIfLess>)
+            f(inst.mTarget);
+        else if constexpr (std::is_same_v<T, JumpTable>) {
+            for (auto& target : inst.mTargets)
+                f(target);
+            f(inst.mDefault);
+        }
+    }, instruction);
+}
+
+// ------------------------------> Basic Block <------------------------------
+
+struct BasicBlock {
+    // A block starts with at most one Label and only its last instruction may transfer control
+    std::vector<Instruction> mInstructions;
+
+    // Ranges into ControlFlowGraph::mPredecessors and ControlFlowGraph::mSuccessors
+    uint32_t mPredecessorsBegin = 0;
+    uint32_t mPredecessorsEnd = 0;
+    uint32_t mSuccessorsBegin = 0;
+    uint32_t mSuccessorsEnd = 0;
+};
+
+// ------------------------------> Control Flow Graph <------------------------------
+
+/// Basic blocks of one TACKY function in their original order, block 0 is the entry. Edges are
+/// kept as two flat index arrays which each block refers into, a successor of EXIT means control
+/// leaves the function. Passes that rewrite terminators call rebuildEdges() afterwards.
+struct ControlFlowGraph {
+    static constexpr uint32_t EXIT = UINT32_MAX;
+
+    std::vector<BasicBlock> mBlocks;
+    std::vector<uint32_t> mPredecessors;
+    std::vector<uint32_t> mSuccessors;
+
+    std::span<const uint32_t> predecessors(uint32_t block) const {
+        const BasicBlock& basicBlock = mBlocks[block];
+        return std::span<const uint32_t>(mPredecessors).subspan(
+            basicBlock.mPredecessorsBegin, basicBlock.mPredecessorsEnd - basicBlock.mPredecessorsBegin);
+    }
+
+    std::span<const uint32_t> successors(uint32_t block) const {
+        const BasicBlock& basicBlock = mBlocks[block];
+        return std::span<const uint32_t>(mSuccessors).subspan(
+            basicBlock.mSuccessorsBegin, basicBlock.mSuccessorsEnd - basicBlock.mSuccessorsBegin);
+    }
+
+    // ------------------------------> Construction <------------------------------
+
+    static bool isTerminator(const Instruction& instruction) {
+        return std::holds_alternative<Jump>(instruction)
+            || std::holds_alternative<JumpIfZero>(instruction)
+            || std::holds_alternative<JumpIfNotZero>(instruction)
+            || std::holds_alternative<JumpIfEqual>(instruction)
+            || std::holds_alternative<JumpIfLess>(instruction)
+            || std::holds_alternative<JumpTable>(instruction)
+            || std::holds_alternative<Return>(instruction);
+    }
+
+    /// @brief Whether control may continue to the next block after this instruction
+    static bool fallsThrough(const Instruction& instruction) {
+        return !std::holds_alternative<Jump>(instruction)
+            && !std::holds_alternative<JumpTable>(instruction)
+            && !std::holds_alternative<Return>(instruction);
+    }
+
+    /// @brief Split a function body into basic blocks, the instructions are moved into the graph
+    static ControlFlowGraph fromInstructions(std::vector<Instruction>&& instructions) {
+        ControlFlowGraph graph;
+        BasicBlock current;
+
+        auto finishBlock = [&]() {
+            if (!current.mInstructions.empty())
+                graph.mBlocks.emplace_back(std::move(current));
+            current = BasicBlock();
+        };
+
+        for (auto& instruction : instructions) {
+            if (std::holds_alternative<Label>(instruction))
+                finishBlock();
+            bool terminator = isTerminator(instruction);
+            current.mInstructions.emplace_back(std::move(instruction));
+            if (terminator)
+                finishBlock();
+        }
+        finishBlock();
+
+        graph.rebuildEdges();
+        return graph;
+    }
+
+    /// @brief Concatenate the blocks back into a flat body, leaves the graph empty
+    std::vector<Instruction> toInstructions() {
+        size_t count = 0;
+        for (const auto& block : mBlocks)
+            count += block.mInstructions.size();
+
+        std::vector<Instruction> instructions;
+        instructions.reserve(count);
+        for (auto& block : mBlocks)
+            for (auto& instruction : block.mInstructions)
+                instructions.emplace_back(std::move(instruction));
+
+        mBlocks.clear();
+        mPredecessors.clear();
+        mSuccessors.clear();
+        return instructions;
+    }
+
+    /// @brief Recompute every edge from the blocks' labels and last instructions
+    void rebuildEdges() {
+        uint32_t blockCount = static_cast<uint32_t>(mBlocks.size());
+
+        // Few labels per function, a hash map avoids sizing anything by the whole interner
+        std::unordered_map<SymbolId, uint32_t> labelBlocks;
+        for (uint32_t block = 0; block < blockCount; ++block) {
+            auto& instructions = mBlocks[block].mInstructions;
+            if (!instructions.empty())
+                if (auto* label = std::get_if<Label>(&instructions.front()))
+                    labelBlocks.insert_or_assign(label->mIdentifier, block);
+        }
+
+        // Successors, jump targets first and then the next block if control can fall through
+        mSuccessors.clear();
+        std::vector<uint32_t> predecessorCounts(blockCount, 0);
+        for (uint32_t block = 0; block < blockCount; ++block) {
+            BasicBlock& basicBlock = mBlocks[block];
+            uint32_t fallthrough = block + 1 < blockCount ? block + 1 : EXIT;
+            basicBlock.mSuccessorsBegin = static_cast<uint32_t>(mSuccessors.size());
+
+            auto addSuccessor = [&](uint32_t successor) {
+                for (uint32_t i = basicBlock.mSuccessorsBegin; i < mSuccessors.size(); ++i)
+                    if (mSuccessors[i] == successor) return;
+                mSuccessors.push_back(successor);
+                if (successor != EXIT)
+                    ++predecessorCounts[successor];
+            };
+
+            const Instruction* last = basicBlock.mInstructions.empty() ? nullptr : &basicBlock.mInstructions.back();
+            if (last)
+                for_each_jump_target(*last, [&](SymbolId target) { addSuccessor(labelBlocks.at(target)); });
+            if (last && std::holds_alternative<Return>(*last))
+                addSuccessor(EXIT);
+            else if (!last || fallsThrough(*last))
+                addSuccessor(fallthrough);
+
+            basicBlock.mSuccessorsEnd = static_cast<uint32_t>(mSuccessors.size());
+        }
+
+        // Predecessors, laid out with a prefix sum over the counts
+        mPredecessors.assign(mSuccessors.size(), 0);
+        uint32_t offset = 0;
+        for (uint32_t block = 0; block < blockCount; ++block) {
+            mBlocks[block].mPredecessorsBegin = offset;
+            mBlocks[block].mPredecessorsEnd = offset;
+            offset += predecessorCounts[block];
+        }
+        mPredecessors.resize(offset);
+        for (uint32_t block = 0; block < blockCount; ++block)
+            for (uint32_t successor : successors(block))
+                if (successor != EXIT)
+                    mPredecessors[mBlocks[successor].mPredecessorsEnd++] = block;
+    }
+};
+
+// ------------------------------> Graphviz dump <------------------------------
+
+/// One line rendering of each instruction for the graph nodes
+struct InstructionToString {
+    std::string operator()(const Val& val) const {
+        return std::visit(*this, val);
+    }
+
+    std::string operator()(const Constant& constant) const {
+        return std::to_string(static_cast<int32_t>(constant.mValue));
+    }
+
+    std::string operator()(const Var& var) const {
+        return std::string(spelling(var.mIdentifier));
+    }
+
+    std::string operator()(const Return& ret) const {
+        return "return " + (*this)(ret.mVal);
+    }
+
+    std::string operator()(const Unary& unary) const {
+        return std::format("{} = {} {}", (*this)(unary.mDst), unary_op_to_string(unary.mOp), (*this)(unary.mSrc));
+    }
+
+    std::string operator()(const Binary& binary) const {
+        return std::format("{} = {} {} {}", (*this)(binary.mDst), (*this)(binary.mSrc1),
+                           binary_op_to_string(binary.mOp), (*this)(binary.mSrc2));
+    }
+
+    std::string operator()(const Copy& copy) const {
+        return std::format("{} = {}", (*this)(copy.mDst), (*this)(copy.mSrc));
+    }
+
+    std::string operator()(const Jump& jump) const {
+        return std::format("jump {}", spelling(jump.mTarget));
+    }
+
+    std::string operator()(const JumpIfZero& jump) const {
+        return std::format("jump {} if {} == 0", spelling(jump.mTarget), (*this)(jump.mCondition));
+    }
+
+    std::string operator()(const JumpIfNotZero& jump) const {
+        return std::format("jump {} if {} != 0", spelling(jump.mTarget), (*this)(jump.mCondition));
+    }
+
+    std::string operator()(const JumpIfEqual& jump) const {
+        return std::format("jump {} if {} == {}", spelling(jump.mTarget), (*this)(jump.mSrc1), (*this)(jump.mSrc2));
+    }
+
+    std::string operator()(const JumpIfLess& jump) const {
+        return std::format("jump {} if {} < {}", spelling(jump.mTarget), (*this)(jump.mSrc1), (*this)(jump.mSrc2));
+    }
+
+    std::string operator()(const JumpTable& jump) const {
+        std::string targets;
+        for (SymbolId target : jump.mTargets) {
+            if (!targets.empty()) targets += ", ";
+            targets += spelling(target);
+        }
+        return std::format("jump [{}][{} - {}] else {}", targets, (*this)(jump.mIndex), jump.mLow, spelling(jump.mDefault));
+    }
+
+    std::string operator()(const Label& label) const {
+        return std::format("{}:", spelling(label.mIdentifier));
+    }
+
+    std::string operator()(const FuncCall& funcCall) const {
+        std::string args;
+        for (const auto& arg : funcCall.mArgs) {
+            if (!args.empty()) args += ", ";
+            args += (*this)(arg);
+        }
+        return std::format("{} = {}({})", (*this)(funcCall.mDst), spelling(funcCall.mIdentifier), args);
+    }
+};
+
+inline std::string escape_graphviz(std::string_view text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+/// @brief Write one Graphviz cluster for a function's graph
+inline void print_graphviz(std::ostream& os, SymbolId function, const ControlFlowGraph& graph) {
+    std::string_view name = spelling(function);
+    os << "  subgraph \"cluster_" << escape_graphviz(name) << "\" {\n";
+    os << "    label=\"" << escape_graphviz(name) << "\";\n";
+    os << "    \"" << escape_graphviz(name) << ".exit\" [label=\"exit\", shape=oval];\n";
+
+    for (uint32_t block = 0; block < graph.mBlocks.size(); ++block) {
+        os << "    \"" << escape_graphviz(name) << '.' << block << "\" [label=\"B" << block;
+        if (block == 0)
+            os << " (entry)";
+        os << "\\l";
+        for (const auto& instruction : graph.mBlocks[block].mInstructions)
+            os << escape_graphviz(std::visit(InstructionToString(), instruction)) << "\\l";
+        os << "\"];\n";
+    }
+
+    for (uint32_t block = 0; block < graph.mBlocks.size(); ++block) {
+        for (uint32_t successor : graph.successors(block)) {
+            os << "    \"" << escape_graphviz(name) << '.' << block << "\" -> \"" << escape_graphviz(name) << '.';
+            if (successor == ControlFlowGraph::EXIT)
+                os << "exit";
+            else
+                os << successor;
+            os << "\";\n";
+        }
+    }
+    os << "  }\n";
+}
+
+inline void print_graphviz(std::ostream& os, Program& program) {
+    os << "digraph tacky {\n";
+    os << "  node [shape=box, fontname=\"monospace\"];\n";
+    for (auto& function : program.mFunctions) {
+        auto graph = ControlFlowGraph::fromInstructions(std::move(function.mBody));
+        print_graphviz(os, function.mIdentifier, graph);
+        function.mBody = graph.toInstructions();
+    }
+    os << "}\n";
+}
+
+}
@@ -0,0 +1,227 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+#include "../../ast/ast_tacky.hpp"
+#include "control_flow_graph.hpp"
+#include "dataflow.hpp"
+
+namespace compiler::ast::tacky {
+
+// ------------------------------> Copy Propagation <------------------------------
+// Forward "reaching copies" analysis: a copy dst = src reaches an instruction if it runs on every
+// path there and neither dst nor src is written in between. Uses of dst are then replaced by src,
+// and a copy which is already known to hold (x = y after x = y or y = x) is removed. Variables are
+// all function locals whose address is never taken, so only direct writes kill a copy.
+
+struct CopyPropagationStats {
+    uint32_t mPropagated = 0;   // operands replaced by the source of a copy
+    uint32_t mEliminated = 0;   // redundant copies removed
+
+    CopyPropagationStats& operator+=(const CopyPropagationStats& other) {
+        mPropagated += other.mPropagated;
+        mEliminated += other.mEliminated;
+        return *this;
+    }
+
+    bool changed() const { return mPropagated || mEliminated; }
+};
+
+struct CopyPropagation {
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    /// A distinct dst = src pair, identical copies anywhere in the function share one fact
+    struct CopyFact {
+        Val mSrc;
+        uint32_t mSrcVariable;  // NONE when the source is a constant
+        uint32_t mDstVariable;
+    };
+
+    CopyPropagationStats mStats;
+    VariableIndex mVariables;
+    std::vector<CopyFact> mFacts;
+    std::unordered_map<uint64_t, uint32_t> mVariableFacts;   // src << 32 | dst
+    std::unordered_map<uint64_t, uint32_t> mConstantFacts;   // value << 32 | dst
+    std::vector<std::vector<uint32_t>> mFactsByDst;          // indexed by variable
+    std::vector<std::vector<uint32_t>> mFactsMentioning;     // facts killed by writing a variable
+
+    static uint64_t key(uint32_t src, uint32_t dst) {
+        return static_cast<uint64_t>(src) << 32 | dst;
+    }
+
+    uint32_t findFact(const Val& src, uint32_t dst) const {
+        const auto& facts = std::holds_alternative<Var>(src) ? mVariableFacts : mConstantFacts;
+        uint32_t srcKey = std::holds_alternative<Var>(src)
+            ? mVariables[std::get<Var>(src).mIdentifier]
+            : std::get<Constant>(src).mValue;
+        auto it = facts.find(key(srcKey, dst));
+        return it == facts.end() ? NONE : it->second;
+    }
+
+    void addFact(const Copy& copy) {
+        uint32_t dst = mVariables[std::get<Var>(copy.mDst).mIdentifier];
+        if (findFact(copy.mSrc, dst) != NONE)
+            return;
+
+        uint32_t fact = static_cast<uint32_t>(mFacts.size());
+        uint32_t src = NONE;
+        if (auto* var = std::get_if<Var>(&copy.mSrc)) {
+            src = mVariables[var->mIdentifier];
+            mVariableFacts.emplace(key(src, dst), fact);
+            mFactsMentioning[src].push_back(fact);
+        }
+        else
+            mConstantFacts.emplace(key(std::get<Constant>(copy.mSrc).mValue, dst), fact);
+        mFactsByDst[dst].push_back(fact);
+        mFactsMentioning[dst].push_back(fact);
+        mFacts.push_back(CopyFact{copy.mSrc, src, dst});
+    }
+
+    void collectFacts(const Function& function) {
+        mVariables.build(function);
+        mFacts.clear();
+        mVariableFacts.clear();
+        mConstantFacts.clear();
+        mFactsByDst.assign(mVariables.size(), {});
+        mFactsMentioning.assign(mVariables.size(), {});
+        for (const auto& instruction : function.mBody)
+            if (auto* copy = std::get_if<Copy>(&instruction))
+                addFact(*copy);
+    }
+
+    /// @brief The fact of a copy instruction, NONE for any other instruction
+    uint32_t copyFact(const Instruction& instruction) const {
+        if (auto* copy = std::get_if<Copy>(&instruction))
+            return findFact(copy->mSrc, mVariables[std::get<Var>(copy->mDst).mIdentifier]);
+        return NONE;
+    }
+
+    // A copy is redundant if it, or the same copy in the other direction, already holds
+    bool isRedundant(uint32_t fact, const DenseBitset& reaching) const {
+        const CopyFact& copy = mFacts[fact];
+        if (copy.mSrcVariable == copy.mDstVariable || reaching.test(fact))
+            return true;
+        if (copy.mSrcVariable != NONE) {
+            auto reverse = mVariableFacts.find(key(copy.mDstVariable, copy.mSrcVariable));
+            return reverse != mVariableFacts.end() && reaching.test(reverse->second);
+        }
+        return false;
+    }
+
+    void kill(uint32_t variable, DenseBitset& reaching) const {
+        for (uint32_t fact : mFactsMentioning[variable])
+            reaching.reset(fact);
+    }
+
+    /// @brief Applies one instruction to the set of reaching copies, fact is its copyFact()
+    void transfer(const Instruction& instruction, uint32_t fact, DenseBitset& reaching) const {
+        if (fact != NONE) {
+            if (isRedundant(fact, reaching))
+                return;
+            kill(mFacts[fact].mDstVariable, reaching);
+            reaching.set(fact);
+        }
+        else if (const Var* dst = destination(instruction))
+            kill(mVariables[dst->mIdentifier], reaching);
+    }
+
+    /// @brief Reaching copies at the start of every block
+    std::vector<DenseBitset> analyze(const ControlFlowGraph& graph) const {
+        uint32_t blockCount = static_cast<uint32_t>(graph.mBlocks.size());
+        std::vector<DenseBitset> in(blockCount, DenseBitset(mFacts.size()));
+        std::vector<DenseBitset> out(blockCount, DenseBitset(mFacts.size(), true));
+
+        std::vector<uint32_t> worklist;
+        std::vector<bool> queued(blockCount, true);
+        for (uint32_t block = blockCount; block-- > 0; )
+            worklist.push_back(block);
+
+        while (!worklist.empty()) {
+            uint32_t block = worklist.back();
+            worklist.pop_back();
+            queued[block] = false;
+
+            // Nothing reaches the entry, and a block without predecessors never runs
+            auto predecessors = graph.predecessors(block);
+            if (block == 0 || predecessors.empty())
+                in[block].resetAll();
+            else {
+                in[block].setAll();
+                for (uint32_t predecessor : predecessors)
+                    in[block].intersectWith(out[predecessor]);
+            }
+
+            DenseBitset reaching = in[block];
+            for (const auto& instruction : graph.mBlocks[block].mInstructions)
+                transfer(instruction, copyFact(instruction), reaching);
+            if (reaching == out[block])
+                continue;
+            out[block] = std::move(reaching);
+
+            for (uint32_t successor : graph.successors(block)) {
+                if (successor != ControlFlowGraph::EXIT && !queued[successor]) {
+                    queued[successor] = true;
+                    worklist.push_back(successor);
+                }
+            }
+        }
+        return in;
+    }
+
+    void rewrite(BasicBlock& block, DenseBitset reaching) {
+        std::vector<Instruction> instructions;
+        instructions.reserve(block.mInstructions.size());
+
+        for (auto& instruction : block.mInstructions) {
+            // The effect on the reaching copies is taken from the instruction as analyzed,
+            // before its operands are rewritten
+            uint32_t fact = copyFact(instruction);
+            if (fact != NONE && isRedundant(fact, reaching)) {
+                ++mStats.mEliminated;
+                continue;
+            }
+
+            for_each_use(instruction, [&](Val& val) {
+                auto* var = std::get_if<Var>(&val);
+                if (!var)
+                    return;
+                for (uint32_t fact : mFactsByDst[mVariables[var->mIdentifier]]) {
+                    if (reaching.test(fact)) {
+                        val = mFacts[fact].mSrc;
+                        ++mStats.mPropagated;
+                        return;
+                    }
+                }
+            });
+            transfer(instruction, fact, reaching);
+            instructions.emplace_back(std::move(instruction));
+        }
+        block.mInstructions = std::move(instructions);
+    }
+
+    // Function visitor
+    CopyPropagationStats operator()(Function& function) {
+        mStats = CopyPropagationStats();
+        collectFacts(function);
+        if (mFacts.empty())
+            return mStats;
+
+        auto graph = ControlFlowGraph::fromInstructions(std::move(function.mBody));
+        auto in = analyze(graph);
+        for (uint32_t block = 0; block < graph.mBlocks.size(); ++block)
+            rewrite(graph.mBlocks[block], std::move(in[block]));
+        function.mBody = graph.toInstructions();
+        return mStats;
+    }
+
+    // Program visitor
+    CopyPropagationStats operator()(Program& program) {
+        CopyPropagationStats total;
+        for (auto& function : program.mFunctions)
+            total += (*this)(function);
+        return total;
+    }
+};
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <type_traits>
+#include <variant>
+#include <vector>
+#include "../../ast/ast_tacky.hpp"
+#include "../../ast/dense_bitset.hpp"
+#include "../../ast/interner.hpp"
+
+namespace compiler::ast::tacky {
+
+// ------------------------------> Instruction Operands <------------------------------
+
+/// @brief Calls f with every Val the instruction reads
+template<typename InstructionType, typename F>
+void for_each_use(InstructionType& instruction, F&& f) {
+    std::visit([&](auto& inst) {
+        using T = std::decay_t<decltype(inst)>;
+        if constexpr (std::is_same_v<T, Return>)
+            f(inst.mVal);
+        else if constexpr (std::is_same_v<T, Unary> || std::is_same_v<T, Copy>)
+            f(inst.mSrc);
+        else if constexpr (std::is_same_v<T, Binary> || std::is_same_v<T, JumpIfEqual>
+                        || std::is_same_v<T, JumpIfLess>) {
+            f(inst.mSrc1);
+            f(inst.mSrc2);
+        }
+        else if constexpr (std::is_same_v<T, JumpIfZero> || std::is_same_v<T, JumpIfNotZero>)
+            f(inst.mCondition);
+        else if constexpr (std::is_same_v<T, JumpTable>)
+            f(inst.mIndex);
+        else if constexpr (std::is_same_v<T, FuncCall>)
+            for (auto& arg : inst.mArgs)
+                f(arg);
+    }, instruction);
+}
+
+/// @brief The variable an instruction writes, or nullptr
+inline const Var* destination(const Instruction& instruction) {
+    return std::visit([](const auto& inst) -> const Var* {
+        using T = std::decay_t<decltype(inst)>;
+        if constexpr (std::is_same_v<T, Unary> || std::is_same_v<T, Binary>
+                   || std::is_same_v<T, Copy> || std::is_same_v<T, FuncCall>)
+            return std::get_if<Var>(&inst.mDst);
+        else
+            return nullptr;
+    }, instruction);
+}
+
+// ------------------------------> Variable Index <------------------------------
+
+/// Numbers the variables of one function densely from zero so analyses can keep their facts in
+/// DenseBitsets and plain vectors instead of maps keyed by SymbolId.
+class VariableIndex {
+private:
+    SymbolIdMap<uint32_t> mIndices;
+    std::vector<SymbolId> mVariables;
+
+    void add(SymbolId variable) {
+        if (!mIndices.contains(variable)) {
+            mIndices.insert_or_assign(variable, static_cast<uint32_t>(mVariables.size()));
+            mVariables.push_back(variable);
+        }
+    }
+
+public:
+    void build(const Function& function) {
+        mIndices.clear();
+        mVariables.clear();
+        for (SymbolId param : function.mParams)
+            add(param);
+        for (const auto& instruction : function.mBody) {
+            for_each_use(instruction, [&](const Val& val) {
+                if (auto* var = std::get_if<Var>(&val))
+                    add(var->mIdentifier);
+            });
+            if (const Var* dst = destination(instruction))
+                add(dst->mIdentifier);
+        }
+    }
+
+    uint32_t size() const { return static_cast<uint32_t>(mVariables.size()); }
+    uint32_t operator[](SymbolId variable) const { return mIndices.at(variable); }
+    SymbolId variable(uint32_t index) const { return mVariables[index]; }
+};
+
+}
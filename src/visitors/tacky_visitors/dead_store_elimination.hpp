@@ -0,0 +1,146 @@
+#pragma once
+#include <cstdint>
+#include <variant>
+#include <vector>
+#include "../../ast/ast_tacky.hpp"
+#include "control_flow_graph.hpp"
+#include "dataflow.hpp"
+
+namespace compiler::ast::tacky {
+
+// ------------------------------> Dead Store Elimination <------------------------------
+// Backward liveness analysis: a variable is live at a point if some path from there reads it
+// before writing it. Every variable is a function local, so nothing is live once the function
+// returns. Unary, Binary and Copy instructions writing a variable which isn't live afterwards are
+// removed, a FuncCall always stays for the call's side effects even if its result is unused.
+
+struct DeadStoreStats {
+    uint32_t mEliminated = 0;   // instructions removed
+
+    DeadStoreStats& operator+=(const DeadStoreStats& other) {
+        mEliminated += other.mEliminated;
+        return *this;
+    }
+
+    bool changed() const { return mEliminated; }
+};
+
+struct DeadStoreElimination {
+    DeadStoreStats mStats;
+    VariableIndex mVariables;
+
+    static bool isPure(const Instruction& instruction) {
+        return std::holds_alternative<Unary>(instruction)
+            || std::holds_alternative<Binary>(instruction)
+            || std::holds_alternative<Copy>(instruction);
+    }
+
+    /// @brief Applies one instruction, walking backwards, to the set of live variables
+    void transfer(const Instruction& instruction, DenseBitset& live) const {
+        if (const Var* dst = destination(instruction))
+            live.reset(mVariables[dst->mIdentifier]);
+        for_each_use(instruction, [&](const Val& val) {
+            if (auto* var = std::get_if<Var>(&val))
+                live.set(mVariables[var->mIdentifier]);
+        });
+    }
+
+    /// @brief Live variables at the end of every block
+    std::vector<DenseBitset> analyze(const ControlFlowGraph& graph) const {
+        uint32_t blockCount = static_cast<uint32_t>(graph.mBlocks.size());
+        std::vector<DenseBitset> in(blockCount, DenseBitset(mVariables.size()));
+        std::vector<DenseBitset> out(blockCount, DenseBitset(mVariables.size()));
+
+        // Blocks are visited last to first, which is close to the order information flows in
+        std::vector<uint32_t> worklist;
+        std::vector<bool> queued(blockCount, true);
+        for (uint32_t block = 0; block < blockCount; ++block)
+            worklist.push_back(block);
+
+        while (!worklist.empty()) {
+            uint32_t block = worklist.back();
+            worklist.pop_back();
+            queued[block] = false;
+
+            out[block].resetAll();
+            for (uint32_t successor : graph.successors(block))
+                if (successor != ControlFlowGraph::EXIT)
+                    out[block].unionWith(in[successor]);
+
+            DenseBitset live = out[block];
+            const auto& instructions = graph.mBlocks[block].mInstructions;
+            for (auto it = instructions.rbegin(); it != instructions.rend(); ++it)
+                transfer(*it, live);
+            if (live == in[block])
+                continue;
+            in[block] = std::move(live);
+
+            for (uint32_t predecessor : graph.predecessors(block)) {
+                if (!queued[predecessor]) {
+                    queued[predecessor] = true;
+                    worklist.push_back(predecessor);
+                }
+            }
+        }
+        return out;
+    }
+
+    void removeDeadStores(BasicBlock& block, DenseBitset live) {
+        auto& instructions = block.mInstructions;
+        std::vector<bool> dead(instructions.size(), false);
+        bool anyDead = false;
+
+        for (size_t i = instructions.size(); i-- > 0; ) {
+            const Instruction& instruction = instructions[i];
+            if (isPure(instruction)) {
+                const Var* dst = destination(instruction);
+                if (dst && !live.test(mVariables[dst->mIdentifier])) {
+                    dead[i] = true;
+                    anyDead = true;
+                    continue;
+                }
+            }
+            transfer(instruction, live);
+        }
+
+        if (!anyDead)
+            return;
+        size_t kept = 0;
+        for (size_t i = 0; i < instructions.size(); ++i) {
+            if (dead[i]) {
+                ++mStats.mEliminated;
+                continue;
+            }
+            // Moving an instruction onto itself would leave a FuncCall without its arguments
+            if (kept != i)
+                instructions[kept] = std::move(instructions[i]);
+            ++kept;
+        }
+        instructions.erase(instructions.begin() + kept, instructions.end());
+    }
+
+    // Function visitor
+    DeadStoreStats operator()(Function& function) {
+        mStats = DeadStoreStats();
+        mVariables.build(function);
+        if (mVariables.size() == 0)
+            return mStats;
+
+        auto graph = ControlFlowGraph::fromInstructions(std::move(function.mBody));
+        auto out = analyze(graph);
+        for (uint32_t block = 0; block < graph.mBlocks.size(); ++block)
+            removeDeadStores(graph.mBlocks[block], std::move(out[block]));
+        function.mBody = graph.toInstructions();
+        return mStats;
+    }
+
+    // Program visitor
+    DeadStoreStats operator()(Program& program) {
+        DeadStoreStats total;
+        for (auto& function : program.mFunctions)
+            total += (*this)(function);
+        return total;
+    }
+};
+
+}
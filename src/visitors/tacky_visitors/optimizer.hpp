@@ -0,0 +1,95 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include "../../ast/ast_tacky.hpp"
+#include "constant_folding.hpp"
+#include "copy_propagation.hpp"
+#include "dead_store_elimination.hpp"
+#include "unreachable_code.hpp"
+
+namespace compiler::ast::tacky {
+
+// ------------------------------> Optimization Pipeline <------------------------------
+// Each pass opens up work for the others: propagated constants fold, folded branches leave
+// unreachable code, propagated copies leave dead stores behind, and removing code leaves fewer
+// writes to kill a copy. The enabled passes are therefore run in turn on each function until a
+// whole round changes nothing.
+
+struct OptimizationOptions {
+    bool mFold = false;
+    bool mUnreachable = false;
+    bool mCopies = false;
+    bool mDeadStores = false;
+};
+
+struct OptimizationStats {
+    FoldingStats mFolding;
+    UnreachableCodeStats mUnreachable;
+    CopyPropagationStats mCopies;
+    DeadStoreStats mDeadStores;
+    uint32_t mRounds = 0;   // most rounds any one function needed
+
+    OptimizationStats& operator+=(const OptimizationStats& other) {
+        mFolding += other.mFolding;
+        mUnreachable += other.mUnreachable;
+        mCopies += other.mCopies;
+        mDeadStores += other.mDeadStores;
+        mRounds = std::max(mRounds, other.mRounds);
+        return *this;
+    }
+};
+
+struct OptimizationPipeline {
+    OptimizationOptions mOptions;
+
+    // Kept across functions so the per-function tables inside are reused rather than reallocated
+    ConstantFolding mFolding;
+    UnreachableCodeElimination mUnreachable;
+    CopyPropagation mCopies;
+    DeadStoreElimination mDeadStores;
+
+    OptimizationPipeline(OptimizationOptions options) : mOptions(options) {}
+
+    // Function visitor
+    OptimizationStats operator()(Function& function) {
+        OptimizationStats stats;
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            ++stats.mRounds;
+
+            if (mOptions.mFold) {
+                auto round = mFolding(function);
+                changed |= round.changed();
+                stats.mFolding += round;
+            }
+            if (mOptions.mUnreachable) {
+                auto round = mUnreachable(function);
+                changed |= round.changed();
+                stats.mUnreachable += round;
+            }
+            if (mOptions.mCopies) {
+                auto round = mCopies(function);
+                changed |= round.changed();
+                stats.mCopies += round;
+            }
+            if (mOptions.mDeadStores) {
+                auto round = mDeadStores(function);
+                changed |= round.changed();
+                stats.mDeadStores += round;
+            }
+        }
+        return stats;
+    }
+
+    // Program visitor
+    OptimizationStats operator()(Program& program) {
+        OptimizationStats total;
+        for (auto& function : program.mFunctions)
+            total += (*this)(function);
+        return total;
+    }
+};
+
+}
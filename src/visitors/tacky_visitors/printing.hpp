@@ -91,6 +91,25 @@ struct PrintVisitor {
         std::visit(PrintVisitor(depth+2), JumpIfEqual.mSrc2);
     }
 
+    void operator()(const JumpIfLess& jumpIfLess) const {
+        std::cout << indent() << "Jump If Less: " << jumpIfLess.mTarget << std::endl;
+        std::cout << indent() << "  " << "Source 1:\n";
+        std::visit(PrintVisitor(depth+2), jumpIfLess.mSrc1);
+        std::cout << indent() << "  " << "Source 2:\n";
+        std::visit(PrintVisitor(depth+2), jumpIfLess.mSrc2);
+    }
+
+    void operator()(const JumpTable& jumpTable) const {
+        std::cout << indent() << "Jump Table: " << jumpTable.mTable << std::endl;
+        std::cout << indent() << "  " << "Index:\n";
+        std::visit(PrintVisitor(depth+2), jumpTable.mIndex);
+        std::cout << indent() << "  " << "Low: " << jumpTable.mLow << std::endl;
+        std::cout << indent() << "  " << "Targets:\n";
+        for (auto target : jumpTable.mTargets)
+            std::cout << indent() << "    " << target << std::endl;
+        std::cout << indent() << "  " << "Default: " << jumpTable.mDefault << std::endl;
+    }
+
     void operator()(const Label& label) const {
         std::cout << indent() << "Label: " << label.mIdentifier << std::endl;
     }
@@ -0,0 +1,207 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <variant>
+#include "../../ast/ast_tacky.hpp"
+#include "../../ast/interner.hpp"
+#include "control_flow_graph.hpp"
+
+namespace compiler::ast::tacky {
+
+// ------------------------------> Unreachable Code Elimination <------------------------------
+// Works on the control flow graph of each function:
+//   1. jumps to a block which only jumps on (or only holds a label) are threaded to the final target
+//   2. blocks which can't be reached from the entry are removed
+//   3. jumps to the block that directly follows are removed
+//   4. labels nothing jumps to are removed, along with blocks left empty
+// and repeats until nothing changes.
+
+struct UnreachableCodeStats {
+    uint32_t mThreaded = 0;     // jumps retargeted past a chain of jumps
+    uint32_t mEliminated = 0;   // instructions removed
+
+    UnreachableCodeStats& operator+=(const UnreachableCodeStats& other) {
+        mThreaded += other.mThreaded;
+        mEliminated += other.mEliminated;
+        return *this;
+    }
+
+    bool changed() const { return mThreaded || mEliminated; }
+};
+
+struct UnreachableCodeElimination {
+    UnreachableCodeStats mStats;
+
+    // The target of a jump going to one label, a JumpTable goes to many
+    static SymbolId* mutableJumpTarget(Instruction& instruction) {
+        if (auto* jump = std::get_if<Jump>(&instruction)) return &jump->mTarget;
+        if (auto* jump = std::get_if<JumpIfZero>(&instruction)) return &jump->mTarget;
+        if (auto* jump = std::get_if<JumpIfNotZero>(&instruction)) return &jump->mTarget;
+        if (auto* jump = std::get_if<JumpIfEqual>(&instruction)) return &jump->mTarget;
+        if (auto* jump = std::get_if<JumpIfLess>(&instruction)) return &jump->mTarget;
+        return nullptr;
+    }
+
+    static SymbolId blockLabel(const BasicBlock& block) {
+        if (!block.mInstructions.empty())
+            if (auto* label = std::get_if<Label>(&block.mInstructions.front()))
+                return label->mIdentifier;
+        return SymbolId();
+    }
+
+    bool threadJumps(ControlFlowGraph& graph) {
+        uint32_t blockCount = static_cast<uint32_t>(graph.mBlocks.size());
+        std::unordered_map<SymbolId, uint32_t> labelBlocks;
+        for (uint32_t block = 0; block < blockCount; ++block) {
+            SymbolId label = blockLabel(graph.mBlocks[block]);
+            if (!label.empty())
+                labelBlocks.insert_or_assign(label, block);
+        }
+
+        // Where control really ends up after jumping to label. Chains that loop back on themselves
+        // are left alone, otherwise every pass would pick a different label in the cycle.
+        auto finalTarget = [&](SymbolId start) {
+            SymbolId label = start;
+            for (uint32_t step = 0; step <= blockCount; ++step) {
+                uint32_t block = labelBlocks.at(label);
+                const auto& instructions = graph.mBlocks[block].mInstructions;
+                SymbolId next;
+                if (instructions.size() == 2 && std::holds_alternative<Jump>(instructions[1]))
+                    next = std::get<Jump>(instructions[1]).mTarget;
+                else if (instructions.size() == 1 && block + 1 < blockCount)
+                    next = blockLabel(graph.mBlocks[block + 1]);
+
+                if (next.empty())
+                    return label;
+                if (next == start || next == label)
+                    return start;
+                label = next;
+            }
+            return start;
+        };
+
+        bool changed = false;
+        for (auto& block : graph.mBlocks) {
+            if (block.mInstructions.empty())
+                continue;
+            for_each_jump_target(block.mInstructions.back(), [&](SymbolId& target) {
+                SymbolId threaded = finalTarget(target);
+                if (threaded != target) {
+                    target = threaded;
+                    ++mStats.mThreaded;
+                    changed = true;
+                }
+            });
+        }
+        return changed;
+    }
+
+    bool removeUnreachableBlocks(ControlFlowGraph& graph) {
+        if (graph.mBlocks.empty())
+            return false;
+
+        std::vector<bool> reachable(graph.mBlocks.size(), false);
+        std::vector<uint32_t> worklist = {0};
+        reachable[0] = true;
+        while (!worklist.empty()) {
+            uint32_t block = worklist.back();
+            worklist.pop_back();
+            for (uint32_t successor : graph.successors(block)) {
+                if (successor == ControlFlowGraph::EXIT || reachable[successor])
+                    continue;
+                reachable[successor] = true;
+                worklist.push_back(successor);
+            }
+        }
+
+        bool changed = false;
+        for (uint32_t block = 0; block < graph.mBlocks.size(); ++block) {
+            if (reachable[block])
+                continue;
+            mStats.mEliminated += graph.mBlocks[block].mInstructions.size();
+            graph.mBlocks[block].mInstructions.clear();
+            changed = true;
+        }
+        return changed;
+    }
+
+    bool removeJumpsToNextBlock(ControlFlowGraph& graph) {
+        bool changed = false;
+        for (size_t block = 0; block < graph.mBlocks.size(); ++block) {
+            auto& instructions = graph.mBlocks[block].mInstructions;
+            if (instructions.empty())
+                continue;
+            SymbolId* target = mutableJumpTarget(instructions.back());
+            if (!target)
+                continue;
+
+            // Skip over blocks already emptied, they'll be dropped
+            size_t next = block + 1;
+            while (next < graph.mBlocks.size() && graph.mBlocks[next].mInstructions.empty())
+                ++next;
+            if (next < graph.mBlocks.size() && blockLabel(graph.mBlocks[next]) == *target) {
+                // Conditions are plain values, dropping a conditional jump has no side effects
+                instructions.pop_back();
+                ++mStats.mEliminated;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    bool removeUnusedLabels(ControlFlowGraph& graph) {
+        std::unordered_set<SymbolId> usedLabels;
+        for (auto& block : graph.mBlocks)
+            if (!block.mInstructions.empty())
+                for_each_jump_target(block.mInstructions.back(), [&](SymbolId target) { usedLabels.insert(target); });
+
+        bool changed = false;
+        for (auto& block : graph.mBlocks) {
+            SymbolId label = blockLabel(block);
+            if (label.empty() || usedLabels.contains(label))
+                continue;
+            block.mInstructions.erase(block.mInstructions.begin());
+            ++mStats.mEliminated;
+            changed = true;
+        }
+        return changed;
+    }
+
+    static void dropEmptyBlocks(ControlFlowGraph& graph) {
+        std::erase_if(graph.mBlocks, [](const BasicBlock& block) { return block.mInstructions.empty(); });
+    }
+
+    // Graph visitor
+    void operator()(ControlFlowGraph& graph) {
+        bool changed = true;
+        while (changed) {
+            changed = threadJumps(graph);
+            changed |= removeUnreachableBlocks(graph);
+            changed |= removeJumpsToNextBlock(graph);
+            changed |= removeUnusedLabels(graph);
+            dropEmptyBlocks(graph);
+            graph.rebuildEdges();
+        }
+    }
+
+    // Function visitor
+    UnreachableCodeStats operator()(Function& function) {
+        mStats = UnreachableCodeStats();
+        auto graph = ControlFlowGraph::fromInstructions(std::move(function.mBody));
+        (*this)(graph);
+        function.mBody = graph.toInstructions();
+        return mStats;
+    }
+
+    // Program visitor
+    UnreachableCodeStats operator()(Program& program) {
+        UnreachableCodeStats total;
+        for (auto& function : program.mFunctions)
+            total += (*this)(function);
+        return total;
+    }
+};
+
+}
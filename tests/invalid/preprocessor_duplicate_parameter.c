@@ -0,0 +1,5 @@
+#define ADD(a, a) ((a) + (a))
+
+int main(void) {
+    return ADD(1, 2);
+}
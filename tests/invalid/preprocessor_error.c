@@ -0,0 +1,9 @@
+#define VERSION 2
+
+#if VERSION > 1u
+#error "VERSION 2 is not supported"
+#endif
+
+int main(void) {
+    return 0;
+}
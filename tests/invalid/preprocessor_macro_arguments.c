@@ -0,0 +1,5 @@
+#define ADD(a, b) ((a) + (b))
+
+int main(void) {
+    return ADD(1, 2, 3);
+}
@@ -0,0 +1,12 @@
+#if defined(FEATURE)
+int feature(void) {
+    return 1;
+}
+#else
+int feature(void) {
+    return 0;
+}
+
+int main(void) {
+    return feature();
+}
@@ -0,0 +1,74 @@
+// Division and remainder by constants are lowered without idiv, compare them against
+// the same operations through a variable divisor, which still uses idiv.
+int quotient(int n, int d) {
+    return n / d;
+}
+
+int modulo(int n, int d) {
+    return n % d;
+}
+
+int check(int n) {
+    if (n / 1 != quotient(n, 1) || n % 1 != modulo(n, 1)) return 1;
+    if (n / -1 != quotient(n, -1) || n % -1 != modulo(n, -1)) return 2;
+    if (n / 2 != quotient(n, 2) || n % 2 != modulo(n, 2)) return 3;
+    if (n / -2 != quotient(n, -2) || n % -2 != modulo(n, -2)) return 4;
+    if (n / 16 != quotient(n, 16) || n % 16 != modulo(n, 16)) return 5;
+    if (n / -16 != quotient(n, -16) || n % -16 != modulo(n, -16)) return 6;
+    if (n / 1073741824 != quotient(n, 1073741824) || n % 1073741824 != modulo(n, 1073741824)) return 7;
+    if (n / 7 != quotient(n, 7) || n % 7 != modulo(n, 7)) return 8;
+    if (n / -7 != quotient(n, -7) || n % -7 != modulo(n, -7)) return 9;
+    if (n / 10 != quotient(n, 10) || n % 10 != modulo(n, 10)) return 10;
+    if (n / -10 != quotient(n, -10) || n % -10 != modulo(n, -10)) return 11;
+    if (n / 1000 != quotient(n, 1000) || n % 1000 != modulo(n, 1000)) return 12;
+    if (n / -1000 != quotient(n, -1000) || n % -1000 != modulo(n, -1000)) return 13;
+    return 0;
+}
+
+// Dense enough to be lowered to a jump table
+int dense(int x) {
+    switch (x) {
+        case 0: return 10;
+        case 1: return 11;
+        case 2: return 12;
+        case 3: return 13;
+        case 5: return 15;
+        case 6: return 16;
+        case 7: return 17;
+        default: return 99;
+    }
+}
+
+int main(void) {
+    int int_min = -2147483647 - 1;
+    int result;
+
+    // INT_MIN / -1 overflows, so INT_MIN is only divided by the other divisors
+    if (int_min / 1 != int_min || int_min % 1 != 0) return 20;
+    if (int_min / 2 != -1073741824 || int_min % 2 != 0) return 21;
+    if (int_min / 7 != -306783378 || int_min % 7 != -2) return 22;
+    if (int_min / 10 != -214748364 || int_min % 10 != -8) return 23;
+    if (int_min / -1000 != 2147483 || int_min % -1000 != -648) return 24;
+    if (-7 / 2 != -3 || -7 % 2 != -1) return 25;
+    if (-1 / 1000 != 0 || -1 % 1000 != -1) return 26;
+
+    for (int n = -2100; n <= 2100; n = n + 1) {
+        result = check(n);
+        if (result) return result + 30;
+    }
+    result = check(2147483647);
+    if (result) return result + 60;
+    result = check(-2147483647);
+    if (result) return result + 80;
+
+    for (int x = 0; x < 8; x = x + 1) {
+        if (dense(x) != (x == 4 ? 99 : x + 10)) return 100 + x;
+    }
+    // Out of range on both sides, including an index that only wraps when compared unsigned
+    if (dense(-1) != 99) return 110;
+    if (dense(8) != 99) return 111;
+    if (dense(1000) != 99) return 112;
+    if (dense(int_min) != 99) return 113;
+
+    return 0;
+}
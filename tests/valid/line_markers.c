@@ -0,0 +1,16 @@
+// #line and line markers only renumber lines, the tokens on either side of them must stay apart
+int main(void) {
+    int a = 1;
+    int b = 2;
+    return
+#line 1 "line_markers.c"
+    a
+# 1 "line_markers.h" 1
+    +
+# 3 "line_markers.c" 2
+    b
+#line 100
+    + (__LINE__ == 100 ? 0 : 50)
+# 7 "line_markers.c"
+    + (__LINE__ == 7 ? 0 : 60);
+}
@@ -0,0 +1,60 @@
+// Both headers are included twice, the include guard and #pragma once keep their functions from being redefined
+#include "preprocessor_guard.h"
+#include "preprocessor_once.h"
+#include "preprocessor_guard.h"
+#include "preprocessor_once.h"
+
+#define ANSWER 42
+#define EMPTY
+#define CAT(a, b) a ## b
+#define XCAT(a, b) CAT(a, b)
+#define FIRST(first, ...) first
+// The stringized argument is dropped again, strings don't get past the lexer
+#define KEEP_FIRST(x) FIRST(x, #x)
+#define ADD(...) add(__VA_ARGS__)
+#define COUNT(...) COUNT_(__VA_ARGS__, 4, 3, 2, 1, 0)
+#define COUNT_(a, b, c, d, n, ...) n
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+// Unsigned operands make the whole comparison unsigned
+#if -1 < 0u
+#define UNSIGNED_CHECK 1
+#elif ~0u > 0 && 1u - 2 > 0 && (0 ? 1u : -1) > 0
+#define UNSIGNED_CHECK 0
+#else
+#define UNSIGNED_CHECK 2
+#endif
+
+#if 0xFFFFFFFFFFFFFFFF / 2 > 0x7FFFFFFFFFFFFFFE && (-1 >> 1) < 0
+#define LARGE_CHECK 0
+#else
+#define LARGE_CHECK 1
+#endif
+
+#if defined(ANSWER) && !defined(UNDEFINED) && ANSWER == 42
+#define DEFINED_CHECK 0
+#elif 1
+#define DEFINED_CHECK 1
+#endif
+
+int add(int a, int b, int c) {
+    return a + b + c;
+}
+
+int main(void) {
+    int value = 5;
+    int CAT(val, ue2) = CAT(12, 34);
+    EMPTY
+
+    if (guarded() != 3 || once() != 4) return 1;
+    if (SQUARE(value + 1) != 36) return 2;
+    if (value2 != 1234 || XCAT(ANS, WER) != 42) return 3;
+    if (KEEP_FIRST(7) != 7) return 4;
+    if (ADD(1, 2, 3) != 6) return 5;
+    if (COUNT(a) != 1 || COUNT(a, b, c) != 3) return 6;
+    if (MAX(value, ANSWER) != 42 || MAX(MAX(1, 2), 0) != 2) return 7;
+    if (UNSIGNED_CHECK) return 8;
+    if (LARGE_CHECK) return 9;
+    if (DEFINED_CHECK) return 10;
+    return 0;
+}
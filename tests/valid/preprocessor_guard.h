@@ -0,0 +1,10 @@
+#ifndef PREPROCESSOR_GUARD_H
+#define PREPROCESSOR_GUARD_H
+
+#define GUARDED 3
+
+int guarded(void) {
+    return GUARDED;
+}
+
+#endif
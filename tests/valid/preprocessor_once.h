@@ -0,0 +1,7 @@
+#pragma once
+
+#define SQUARE(x) ((x) * (x))
+
+int once(void) {
+    return SQUARE(2);
+}